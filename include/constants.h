@@ -13,6 +13,7 @@ namespace Constants {
     constexpr int MAX_MESSAGE_LENGTH = 1000;
     constexpr int MIN_MESSAGE_LENGTH = 1;
     constexpr int MAX_HISTORY_SIZE = 100;
+    constexpr int HISTORY_PAGE_SIZE = 50;   // Messages loaded per scrollback step
     
     // Network settings
     constexpr int DEFAULT_PORT = 8443;
@@ -27,6 +28,8 @@ namespace Constants {
     // Image and link handling
     constexpr int MAX_IMAGE_SIZE_MB = 10;
     constexpr int MAX_IMAGE_DIMENSION = 4096;
+    constexpr int MEDIA_CACHE_DISK_MB = 512;
+    constexpr int MEDIA_CACHE_MEMORY_MB = 32;
     
     // Moderation settings
     constexpr float MALICIOUS_LINK_THRESHOLD = 0.8f;
@@ -35,6 +38,12 @@ namespace Constants {
     // File paths
     const QString CONFIG_PATH = "RoChatPlus.ini";
     const QString BLACKLIST_PATH = "data/blacklist.txt";
+    const QString BLACKLIST_INDEX_PATH = "data/blacklist.bin";  // Compiled with blacklistc
+    const QString COMPRESSION_DICTIONARY_PATH = "data/chat.dict";  // Trained with framebench
+    const QString OUTBOX_PATH = "data/outbox.db";
+    const QString HISTORY_PATH = "data/history.db";
+    const QString MEDIA_INCOMING_PATH = "data/media/incoming/";  // Partial transfers
+    const QString MEDIA_CACHE_PATH = "data/media/cache/";
     const QString LOG_PATH = "logs/";
 }
 
@@ -13,10 +13,11 @@ struct Message {
     QString content;
     QDateTime timestamp;
     QString serverId;
+    quint64 sequence = 0;   // Per-channel, assigned by the server; 0 if unsequenced
     bool containsImage = false;
     bool containsLink = false;
     QStringList linkUrls;
-    QString imageData;  // Base64 encoded or URL
+    QString imageData;  // MediaCache key (hex SHA-256) of the image
 
     Message() = default;
     Message(const QString &senderId, const QString &msg)
@@ -37,6 +38,8 @@ struct Server {
     QString id;
     QString name;
     QString description;
+    QString host;               // Servers on the same host:port share one connection
+    int port = 8443;
     std::vector<User> members;
     QDateTime createdAt;
     bool isConnected = false;
@@ -60,8 +63,17 @@ struct NetworkConfig {
     int port = 8443;
     bool useSSL = true;
     QString authToken;
-    int reconnectAttempts = 5;
-    int reconnectDelayMs = 3000;
+    int reconnectAttempts = 0;         // 0 keeps retrying indefinitely
+    int reconnectDelayMs = 3000;       // Backoff base, doubled per attempt
+    int reconnectMaxDelayMs = 60000;
+    bool preferBinaryProtocol = true;  // Offer the binary wire protocol at connect
+    bool enableCompression = true;     // Offer deflate on binary frames
+    int sendBatchWindowMs = 5;         // How long outbound messages may wait to share a frame
+    int maxBatchMessages = 64;
+    qint64 sendHighWaterBytes = 256 * 1024;  // Stop flushing while this much is unwritten
+    int outboxMaxMessages = 10000;     // Unsent messages kept on disk while offline
+    int outboxMaxAgeHours = 24;
+    int outboxDrainPerSecond = 200;    // Replay rate after reconnecting
 };
 
 #endif // TYPES_H
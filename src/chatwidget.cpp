@@ -4,15 +4,46 @@
 #include <QLabel>
 #include <QDateTime>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QDebug>
 #include <QMessageBox>
+#include <QScrollBar>
+#include <QSet>
+#include <QTimer>
+#include "transcriptmodel.h"
+#include "messagedelegate.h"
+#include "renderbatcher.h"
+#include "storage/historystore.h"
+#include "storage/outbox.h"
+#include "media/thumbnailpool.h"
+#include "diagnostics/metrics.h"
 #include "include/constants.h"
 
+namespace {
+
+// Summed over all tabs
+struct RenderMetrics {
+    Counter *commits = MetricsRegistry::instance().counter("chat.render_commits");
+    Histogram *messagesPerCommit = MetricsRegistry::instance().histogram("chat.messages_per_commit");
+    Histogram *commitTime = MetricsRegistry::instance().histogram("chat.render_commit_ns");
+};
+
+const RenderMetrics &metrics()
+{
+    static const RenderMetrics instance;
+    return instance;
+}
+
+} // namespace
+
 ChatWidget::ChatWidget(const Server &server, QWidget *parent)
     : QWidget(parent)
     , m_server(server)
     , m_splitter(new QSplitter(Qt::Horizontal, this))
-    , m_chatDisplay(new QTextEdit(this))
+    , m_chatDisplay(new QListView(this))
+    , m_transcript(new TranscriptModel(Constants::MAX_HISTORY_SIZE, this))
+    , m_messageDelegate(new MessageDelegate(this))
+    , m_renderBatcher(new RenderBatcher(this))
     , m_messageInput(new QLineEdit(this))
     , m_sendButton(new QPushButton(tr("Send"), this))
     , m_imageButton(new QPushButton(tr("📷 Image"), this))
@@ -30,8 +61,14 @@ void ChatWidget::setupUI()
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
     
     // Splitter for chat display and user list
-    m_chatDisplay->setReadOnly(true);
-    m_chatDisplay->setStyleSheet("QTextEdit { background-color: #2b2b2b; color: #ffffff; }");
+    // Virtualized transcript: only visible rows are painted
+    m_chatDisplay->setModel(m_transcript);
+    m_chatDisplay->setItemDelegate(m_messageDelegate);
+    m_chatDisplay->setSelectionMode(QAbstractItemView::NoSelection);
+    m_chatDisplay->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_chatDisplay->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_chatDisplay->setResizeMode(QListView::Adjust);
+    m_chatDisplay->setStyleSheet("QListView { background-color: #2b2b2b; color: #ffffff; }");
     
     m_userList->setMaximumWidth(200);
     m_userList->setStyleSheet("QListWidget { background-color: #3b3b3b; color: #ffffff; }");
@@ -71,18 +108,170 @@ void ChatWidget::connectSignals()
     connect(m_messageInput, &QLineEdit::returnPressed, this, &ChatWidget::onMessageInputReturnPressed);
     connect(m_imageButton, &QPushButton::clicked, this, &ChatWidget::onImageButtonClicked);
     connect(m_linkButton, &QPushButton::clicked, this, &ChatWidget::onLinkButtonClicked);
+    
+    connect(m_renderBatcher, &RenderBatcher::commitReady, this, [this](const QVector<Message> &messages) {
+        metrics().commits->increment();
+        metrics().messagesPerCommit->record(messages.size());
+        ScopedTimer timer(metrics().commitTime);
+        appendMessagesToDisplay(messages, false);
+    });
+    
+    // Reaching either end of the window may page in more history
+    QScrollBar *scrollBar = m_chatDisplay->verticalScrollBar();
+    connect(scrollBar, &QScrollBar::valueChanged, this, &ChatWidget::loadMoreHistory);
+    connect(scrollBar, &QScrollBar::rangeChanged, this, &ChatWidget::loadMoreHistory);
 }
 
 void ChatWidget::displayMessage(const Message &message)
 {
-    formatMessageDisplay(message);
+    // Committed to the view once per refresh tick
+    m_renderBatcher->enqueue(message);
 }
 
 void ChatWidget::setServer(const Server &server)
 {
     m_server = server;
-    m_chatDisplay->clear();
+    m_transcript->clear();
     m_userList->clear();
+    resetHistory();
+}
+
+void ChatWidget::setHistorySize(int maxMessages)
+{
+    m_transcript->setCapacity(maxMessages);
+}
+
+void ChatWidget::setRefreshInterval(int intervalMs)
+{
+    m_renderBatcher->setInterval(intervalMs);
+}
+
+void ChatWidget::setHistoryStore(HistoryStore *store)
+{
+    if (m_historyStore) {
+        QObject::disconnect(m_historyStore, nullptr, this, nullptr);
+    }
+    
+    m_historyStore = store;
+    if (m_historyStore) {
+        connect(m_historyStore, &HistoryStore::pageLoaded, this, &ChatWidget::onHistoryPageLoaded);
+    }
+    resetHistory();
+}
+
+void ChatWidget::setThumbnailPool(ThumbnailPool *pool)
+{
+    if (m_thumbnailPool) {
+        QObject::disconnect(m_thumbnailPool, nullptr, this, nullptr);
+    }
+    
+    m_thumbnailPool = pool;
+    m_messageDelegate->setThumbnailPool(pool);
+    if (m_thumbnailPool) {
+        // Placeholders have the thumbnail's size, so a repaint is enough
+        auto repaint = [this]() { m_chatDisplay->viewport()->update(); };
+        connect(m_thumbnailPool, &ThumbnailPool::thumbnailReady, this, repaint);
+        connect(m_thumbnailPool, &ThumbnailPool::thumbnailFailed, this, repaint);
+    }
+}
+
+void ChatWidget::resetHistory()
+{
+    m_pendingPage = 0;
+    m_olderExhausted = false;
+    m_detached = false;
+    m_heldLive.clear();
+    
+    if (m_historyStore) {
+        m_initialLoad = true;
+        m_pendingPage = m_historyStore->requestOlder(m_server.id, HistoryCursor(), historyPageSize());
+    }
+}
+
+int ChatWidget::historyPageSize() const
+{
+    // Two pages must fit in the window, or paging one in would evict the other
+    return qBound(1, m_transcript->capacity() / 2, Constants::HISTORY_PAGE_SIZE);
+}
+
+void ChatWidget::loadMoreHistory()
+{
+    if (!m_historyStore || m_pendingPage != 0) {
+        return;
+    }
+    
+    const QScrollBar *scrollBar = m_chatDisplay->verticalScrollBar();
+    const int rows = m_transcript->rowCount();
+    
+    if (scrollBar->value() <= scrollBar->minimum() && !m_olderExhausted) {
+        const HistoryCursor before = rows > 0 ? HistoryCursor::of(m_transcript->messageAt(0)) : HistoryCursor();
+        m_pendingPage = m_historyStore->requestOlder(m_server.id, before, historyPageSize());
+    } else if (m_detached && rows > 0 && scrollBar->value() >= scrollBar->maximum()) {
+        const HistoryCursor after = HistoryCursor::of(m_transcript->messageAt(rows - 1));
+        m_pendingPage = m_historyStore->requestNewer(m_server.id, after, historyPageSize());
+    }
+}
+
+void ChatWidget::onHistoryPageLoaded(const HistoryPage &page)
+{
+    if (page.requestId != m_pendingPage) {
+        return;  // Another tab's page, or superseded by a reset
+    }
+    m_pendingPage = 0;
+    
+    if (page.older) {
+        // Live messages may have landed before the first page did
+        const QVector<Message> messages = m_initialLoad ? withoutDisplayed(page.messages) : page.messages;
+        m_olderExhausted = page.complete;
+        
+        if (m_transcript->prepend(messages) > 0) {
+            m_detached = true;
+        }
+        
+        if (m_initialLoad) {
+            m_chatDisplay->scrollToBottom();
+        } else if (!messages.isEmpty()) {
+            // Keep the row the user was reading where it was
+            m_chatDisplay->scrollTo(m_transcript->index(messages.size()), QAbstractItemView::PositionAtTop);
+        }
+        m_initialLoad = false;
+    } else {
+        if (m_transcript->rowCount() + page.messages.size() > m_transcript->capacity()) {
+            m_olderExhausted = false;
+        }
+        m_transcript->append(page.messages);
+        
+        if (page.complete) {
+            // Caught up with the store; anything newer is in the held batch
+            m_detached = false;
+            m_transcript->append(withoutDisplayed(m_heldLive));
+            m_heldLive.clear();
+        }
+    }
+    
+    // The viewport may still have room, or the user may still be at an end
+    QTimer::singleShot(0, this, &ChatWidget::loadMoreHistory);
+}
+
+QVector<Message> ChatWidget::withoutDisplayed(const QVector<Message> &messages) const
+{
+    QSet<QString> displayed;
+    displayed.reserve(m_transcript->rowCount());
+    for (int row = 0; row < m_transcript->rowCount(); ++row) {
+        const QString id = m_transcript->idAt(row);
+        if (!id.isEmpty()) {
+            displayed.insert(id);
+        }
+    }
+    
+    QVector<Message> result;
+    result.reserve(messages.size());
+    for (const Message &message : messages) {
+        if (message.id.isEmpty() || !displayed.contains(message.id)) {
+            result.append(message);
+        }
+    }
+    return result;
 }
 
 void ChatWidget::onSendButtonClicked()
@@ -100,6 +289,7 @@ void ChatWidget::onSendButtonClicked()
     }
     
     Message message;
+    message.id = Outbox::createMessageId();
     message.sender = "CurrentUser";  // TODO: Get actual username
     message.content = messageText;
     message.serverId = m_server.id;
@@ -107,7 +297,15 @@ void ChatWidget::onSendButtonClicked()
     
     emit messageSent(message);
     
-    formatMessageDisplay(message);
+    // Commit anything still pending first so the transcript stays in order
+    m_renderBatcher->flush();
+    if (m_detached) {
+        // Jump back to the present; the reloaded page includes this message
+        m_transcript->clear();
+        resetHistory();
+    } else {
+        appendMessagesToDisplay({message}, true);
+    }
     m_messageInput->clear();
     m_messageInput->setFocus();
 }
@@ -122,10 +320,18 @@ void ChatWidget::onImageButtonClicked()
     QString fileName = QFileDialog::getOpenFileName(this, tr("Select Image"),
         "", tr("Images (*.png *.jpg *.jpeg *.bmp);;All Files (*)"));
     
-    if (!fileName.isEmpty()) {
-        qDebug() << "Image selected:" << fileName;
-        // TODO: Handle image upload and encoding
+    if (fileName.isEmpty()) {
+        return;
+    }
+    
+    if (QFileInfo(fileName).size() > qint64(Constants::MAX_IMAGE_SIZE_MB) * 1024 * 1024) {
+        QMessageBox::warning(this, tr("Image Too Large"),
+            tr("Images must be smaller than %1 MB").arg(Constants::MAX_IMAGE_SIZE_MB));
+        return;
     }
+    
+    // Read from disk in chunks by the connection, never loaded here
+    emit imageSelected(fileName);
 }
 
 void ChatWidget::onLinkButtonClicked()
@@ -134,22 +340,32 @@ void ChatWidget::onLinkButtonClicked()
     qDebug() << "Link button clicked";
 }
 
-void ChatWidget::formatMessageDisplay(const Message &message)
+void ChatWidget::appendMessagesToDisplay(const QVector<Message> &messages, bool forceScroll)
 {
-    QString formattedMessage = QString("<b>%1</b> <span style='color: #888;'>%2</span><br/>%3<br/>")
-        .arg(message.sender)
-        .arg(message.timestamp.toString("hh:mm:ss"))
-        .arg(message.content.replace("<", "&lt;").replace(">", "&gt;"));
+    if (m_detached) {
+        // Already in the store; shown once scrolling catches up to them
+        m_heldLive += messages;
+        if (m_heldLive.size() > m_transcript->capacity()) {
+            m_heldLive.remove(0, m_heldLive.size() - m_transcript->capacity());
+        }
+        return;
+    }
+    
+    // Only follow new messages if the user hasn't scrolled up to read history
+    const bool followTail = forceScroll || isScrolledToBottom();
     
-    appendMessageToDisplay(formattedMessage);
+    if (m_transcript->rowCount() + messages.size() > m_transcript->capacity()) {
+        m_olderExhausted = false;
+    }
+    m_transcript->append(messages);
+    
+    if (followTail) {
+        m_chatDisplay->scrollToBottom();
+    }
 }
 
-void ChatWidget::appendMessageToDisplay(const QString &formattedMessage)
+bool ChatWidget::isScrolledToBottom() const
 {
-    m_chatDisplay->append(formattedMessage);
-    
-    // Scroll to bottom
-    QTextCursor cursor = m_chatDisplay->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_chatDisplay->setTextCursor(cursor);
+    const QScrollBar *scrollBar = m_chatDisplay->verticalScrollBar();
+    return scrollBar->value() >= scrollBar->maximum();
 }
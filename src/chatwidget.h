@@ -2,13 +2,20 @@
 #define CHATWIDGET_H
 
 #include <QWidget>
-#include <QTextEdit>
+#include <QListView>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QListWidget>
 #include <QSplitter>
 #include "include/types.h"
 
+class TranscriptModel;
+class MessageDelegate;
+class RenderBatcher;
+class HistoryStore;
+class ThumbnailPool;
+struct HistoryPage;
+
 class ChatWidget : public QWidget
 {
     Q_OBJECT
@@ -19,10 +26,16 @@ public:
 
     void displayMessage(const Message &message);
     void setServer(const Server &server);
+    void setHistorySize(int maxMessages);
+    void setRefreshInterval(int intervalMs);
+    void setHistoryStore(HistoryStore *store);
+    void setThumbnailPool(ThumbnailPool *pool);
+    const RenderBatcher *renderBatcher() const { return m_renderBatcher; }
     const Server &getServer() const { return m_server; }
 
 signals:
     void messageSent(const Message &message);
+    void imageSelected(const QString &filePath);
     void connectionStatusChanged(bool connected);
 
 private slots:
@@ -34,19 +47,38 @@ private slots:
 private:
     void setupUI();
     void connectSignals();
-    void formatMessageDisplay(const Message &message);
-    void appendMessageToDisplay(const QString &formattedMessage);
+    void appendMessagesToDisplay(const QVector<Message> &messages, bool forceScroll);
+    bool isScrolledToBottom() const;
+    void resetHistory();
+    int historyPageSize() const;
+    void loadMoreHistory();
+    void onHistoryPageLoaded(const HistoryPage &page);
+    QVector<Message> withoutDisplayed(const QVector<Message> &messages) const;
 
     Server m_server;
     
     // UI Components
     QSplitter *m_splitter;
-    QTextEdit *m_chatDisplay;
+    QListView *m_chatDisplay;
+    TranscriptModel *m_transcript;
+    MessageDelegate *m_messageDelegate;
+    RenderBatcher *m_renderBatcher;
     QLineEdit *m_messageInput;
     QPushButton *m_sendButton;
     QPushButton *m_imageButton;
     QPushButton *m_linkButton;
     QListWidget *m_userList;
+    
+    // The view shows a window of at most the history size; older and newer
+    // pages come from the store as the user scrolls. While the newest rows
+    // have been paged out (m_detached), live messages wait in m_heldLive.
+    HistoryStore *m_historyStore = nullptr;
+    ThumbnailPool *m_thumbnailPool = nullptr;
+    quint64 m_pendingPage = 0;
+    bool m_initialLoad = false;
+    bool m_olderExhausted = false;
+    bool m_detached = false;
+    QVector<Message> m_heldLive;
 };
 
 #endif // CHATWIDGET_H
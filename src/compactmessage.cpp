@@ -0,0 +1,243 @@
+#include "compactmessage.h"
+#include <cstring>
+
+namespace {
+
+// Link spans are two quint32s, stored after the text in char16_t units
+constexpr int SpanChars = 4;
+
+} // namespace
+
+StringInterner::StringInterner()
+{
+    m_entries.append(Entry());
+}
+
+quint32 StringInterner::intern(const QString &value)
+{
+    if (value.isEmpty()) {
+        return 0;
+    }
+    auto it = m_handles.constFind(value);
+    if (it != m_handles.constEnd()) {
+        ++m_entries[int(it.value())].references;
+        return it.value();
+    }
+
+    quint32 handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    } else {
+        handle = quint32(m_entries.size());
+        m_entries.append(Entry());
+    }
+    m_entries[int(handle)] = {value, 1};
+    m_handles.insert(value, handle);
+    return handle;
+}
+
+void StringInterner::release(quint32 handle)
+{
+    if (handle == 0 || handle >= quint32(m_entries.size())) {
+        return;
+    }
+    Entry &entry = m_entries[int(handle)];
+    if (entry.references == 0 || --entry.references > 0) {
+        return;
+    }
+    m_handles.remove(entry.value);
+    entry.value = QString();
+    m_freeHandles.push_back(handle);
+}
+
+MessageArena::MessageArena() = default;
+
+MessageArena::~MessageArena() = default;
+
+CompactMessage MessageArena::pack(const Message &message)
+{
+    CompactMessage compact;
+    compact.timestampMs = message.timestamp.isValid() ? message.timestamp.toMSecsSinceEpoch() : 0;
+    compact.sequence = message.sequence;
+    compact.sender = m_interner.intern(message.sender);
+    compact.channel = m_interner.intern(message.serverId);
+    compact.flags = (message.containsImage ? CompactMessage::ContainsImage : 0)
+                    | (message.containsLink ? CompactMessage::ContainsLink : 0)
+                    | (message.timestamp.isValid() ? CompactMessage::HasTimestamp : 0);
+
+    const QString id = message.id.left(0xFFFF);
+    compact.idLength = quint16(id.size());
+    // Image keys are unique per image, so they live with the message rather
+    // than in the interner
+    const QString image = message.imageData.left(0xFFFF);
+    compact.imageLength = quint16(image.size());
+    compact.contentLength = quint32(message.content.size());
+
+    // Links are usually substrings of the content and cost just a span;
+    // ones that aren't (e.g. redacted) are spilled after the spans. Offsets
+    // are relative to the start of the content either way.
+    const int linkCount = qMin<int>(message.linkUrls.size(), 0xFFFF);
+    compact.linkCount = quint16(linkCount);
+    QVector<quint32> spans;
+    spans.reserve(2 * linkCount);
+    QString spilled;
+    const quint32 spillStart = compact.contentLength + quint32(linkCount * SpanChars);
+    for (int i = 0; i < linkCount; ++i) {
+        const QString &url = message.linkUrls.at(i);
+        const qsizetype offset = message.content.indexOf(url);
+        if (offset >= 0) {
+            spans << quint32(offset) << quint32(url.size());
+        } else {
+            spans << spillStart + quint32(spilled.size()) << quint32(url.size());
+            spilled += url;
+        }
+    }
+
+    const int chars = int(id.size() + image.size() + message.content.size()) + linkCount * SpanChars
+                      + int(spilled.size());
+    char16_t *out = nullptr;
+    compact.slab = allocate(chars, &out);
+    compact.text = out;
+
+    // [id][image key][content][spans][spilled link text]
+    memcpy(out, id.utf16(), size_t(id.size()) * sizeof(char16_t));
+    out += id.size();
+    memcpy(out, image.utf16(), size_t(image.size()) * sizeof(char16_t));
+    out += image.size();
+    memcpy(out, message.content.utf16(), size_t(message.content.size()) * sizeof(char16_t));
+    out += message.content.size();
+    memcpy(out, spans.constData(), size_t(spans.size()) * sizeof(quint32));
+    out += linkCount * SpanChars;
+    memcpy(out, spilled.utf16(), size_t(spilled.size()) * sizeof(char16_t));
+    return compact;
+}
+
+Message MessageArena::unpack(const CompactMessage &message) const
+{
+    Message result;
+    result.id = id(message);
+    const char16_t *content = message.text + message.idLength + message.imageLength;
+    result.content = QString(reinterpret_cast<const QChar *>(content), qsizetype(message.contentLength));
+    result.sender = m_interner.string(message.sender);
+    result.serverId = m_interner.string(message.channel);
+    result.imageData = imageKey(message).toString();
+    result.sequence = message.sequence;
+    if (message.flags & CompactMessage::HasTimestamp) {
+        result.timestamp = QDateTime::fromMSecsSinceEpoch(message.timestampMs);
+    }
+    result.containsImage = message.flags & CompactMessage::ContainsImage;
+    result.containsLink = message.flags & CompactMessage::ContainsLink;
+
+    if (message.linkCount > 0) {
+        QVector<quint32> spans(2 * message.linkCount);
+        memcpy(spans.data(), content + message.contentLength, size_t(spans.size()) * sizeof(quint32));
+        result.linkUrls.reserve(message.linkCount);
+        for (int i = 0; i < message.linkCount; ++i) {
+            result.linkUrls.append(QString(reinterpret_cast<const QChar *>(content + spans[2 * i]),
+                                           qsizetype(spans[2 * i + 1])));
+        }
+    }
+    return result;
+}
+
+QString MessageArena::id(const CompactMessage &message) const
+{
+    return QString(reinterpret_cast<const QChar *>(message.text), qsizetype(message.idLength));
+}
+
+QStringView MessageArena::content(const CompactMessage &message) const
+{
+    if (!message.text) {
+        return QStringView();
+    }
+    return QStringView(message.text + message.idLength + message.imageLength, qsizetype(message.contentLength));
+}
+
+QStringView MessageArena::imageKey(const CompactMessage &message) const
+{
+    if (!message.text) {
+        return QStringView();
+    }
+    return QStringView(message.text + message.idLength, qsizetype(message.imageLength));
+}
+
+void MessageArena::release(const CompactMessage &message)
+{
+    if (!message.text) {
+        return;
+    }
+    m_interner.release(message.sender);
+    m_interner.release(message.channel);
+    if (message.slab >= m_slabs.size()) {
+        return;
+    }
+    Slab &slab = m_slabs[message.slab];
+    if (--slab.live > 0) {
+        return;
+    }
+    if (m_hasCurrent && message.slab == m_current) {
+        slab.used = 0;  // Still the slab being filled; start it over
+        return;
+    }
+    m_bytesReserved -= qint64(slab.capacity) * qint64(sizeof(char16_t));
+    slab = Slab();
+    m_freeSlots.push_back(message.slab);
+}
+
+void MessageArena::clear()
+{
+    m_interner = StringInterner();
+    m_slabs.clear();
+    m_freeSlots.clear();
+    m_hasCurrent = false;
+    m_bytesReserved = 0;
+}
+
+int MessageArena::slabCount() const
+{
+    return int(m_slabs.size() - m_freeSlots.size());
+}
+
+quint32 MessageArena::allocate(int chars, char16_t **out)
+{
+    chars = qMax(chars, 1);
+    const bool fits = m_hasCurrent && m_slabs[m_current].used + chars <= m_slabs[m_current].capacity;
+    const bool oversized = chars > SlabChars;
+
+    quint32 index = m_current;
+    if (!fits || oversized) {
+        Slab slab;
+        slab.capacity = oversized ? chars : SlabChars;
+        slab.data.reset(new char16_t[size_t(slab.capacity)]);
+        m_bytesReserved += qint64(slab.capacity) * qint64(sizeof(char16_t));
+
+        if (!m_freeSlots.empty()) {
+            index = m_freeSlots.back();
+            m_freeSlots.pop_back();
+            m_slabs[index] = std::move(slab);
+        } else {
+            index = quint32(m_slabs.size());
+            m_slabs.push_back(std::move(slab));
+        }
+
+        // An oversized record gets a slab to itself; filling continues in
+        // the current one. Otherwise the new slab becomes current, and the
+        // old one goes if nothing in it is still alive.
+        if (!oversized) {
+            if (m_hasCurrent && m_slabs[m_current].live == 0) {
+                m_bytesReserved -= qint64(m_slabs[m_current].capacity) * qint64(sizeof(char16_t));
+                m_slabs[m_current] = Slab();
+                m_freeSlots.push_back(m_current);
+            }
+            m_current = index;
+            m_hasCurrent = true;
+        }
+    }
+
+    Slab &slab = m_slabs[index];
+    *out = slab.data.get() + slab.used;
+    slab.used += chars;
+    ++slab.live;
+    return index;
+}
@@ -0,0 +1,117 @@
+#ifndef COMPACTMESSAGE_H
+#define COMPACTMESSAGE_H
+
+#include <QHash>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <memory>
+#include <vector>
+#include "include/types.h"
+
+// Retained-history form of Message. A Message owns five QStrings, a
+// QStringList and a QDateTime, each its own allocation; across 100k
+// messages most of that is repeated sender and channel names and small
+// heap blocks. CompactMessage keeps the same information in one flat
+// record:
+//  - sender and channel as handles into the arena's StringInterner;
+//  - the timestamp as milliseconds since the epoch;
+//  - id, image key, content and link spans packed into a MessageArena slab.
+// Single fields can be read in place; unpack() rebuilds a whole Message.
+
+// Maps repeated strings to small integer handles. Handle 0 is the empty
+// string. Each intern() takes a reference and each release() drops one;
+// a string is freed, and its handle reused, once nothing refers to it, so
+// the table only ever holds the names of retained messages. Not
+// thread-safe.
+class StringInterner
+{
+public:
+    StringInterner();
+
+    quint32 intern(const QString &value);
+    void release(quint32 handle);
+    const QString &string(quint32 handle) const { return m_entries.at(int(handle)).value; }
+    int size() const { return m_handles.size(); }
+
+private:
+    struct Entry {
+        QString value;
+        quint32 references = 0;
+    };
+
+    QVector<Entry> m_entries;
+    QHash<QString, quint32> m_handles;
+    std::vector<quint32> m_freeHandles;
+};
+
+struct CompactMessage {
+    qint64 timestampMs = 0;
+    quint64 sequence = 0;
+    const char16_t *text = nullptr;     // id, image key, content, then spilled link text
+    quint32 contentLength = 0;
+    quint32 slab = 0;
+    quint32 sender = 0;                 // StringInterner handles
+    quint32 channel = 0;
+    quint16 idLength = 0;
+    quint16 imageLength = 0;
+    quint16 linkCount = 0;              // (offset, length) pairs after the text
+    quint8 flags = 0;
+
+    enum Flag : quint8 {
+        ContainsImage = 0x01,
+        ContainsLink = 0x02,
+        HasTimestamp = 0x04
+    };
+};
+
+// Bump allocator for message text. Records are packed into fixed-size
+// slabs, and a slab is freed once every message in it has been released.
+// History is dropped roughly oldest-first, so slabs empty in order. Text is
+// stored as UTF-16, so unpacking copies it straight into a QString.
+class MessageArena
+{
+public:
+    static constexpr int SlabChars = 32 * 1024;     // 64 KB
+
+    MessageArena();
+    ~MessageArena();
+
+    MessageArena(const MessageArena &) = delete;
+    MessageArena &operator=(const MessageArena &) = delete;
+
+    CompactMessage pack(const Message &message);
+    Message unpack(const CompactMessage &message) const;
+    void release(const CompactMessage &message);
+    void clear();
+
+    // Views stay valid until the message is released
+    QString id(const CompactMessage &message) const;
+    QStringView content(const CompactMessage &message) const;
+    QStringView imageKey(const CompactMessage &message) const;
+    const QString &sender(const CompactMessage &message) const { return m_interner.string(message.sender); }
+    const QString &channel(const CompactMessage &message) const { return m_interner.string(message.channel); }
+
+    qint64 bytesReserved() const { return m_bytesReserved; }
+    int slabCount() const;
+    int internedCount() const { return m_interner.size(); }
+
+private:
+    struct Slab {
+        std::unique_ptr<char16_t[]> data;
+        int capacity = 0;
+        int used = 0;
+        int live = 0;
+    };
+
+    quint32 allocate(int chars, char16_t **out);
+
+    StringInterner m_interner;
+    std::vector<Slab> m_slabs;
+    std::vector<quint32> m_freeSlots;
+    quint32 m_current = 0;
+    bool m_hasCurrent = false;
+    qint64 m_bytesReserved = 0;
+};
+
+#endif // COMPACTMESSAGE_H
@@ -0,0 +1,145 @@
+#include "connectionmanager.h"
+#include "diagnostics/logger.h"
+
+ConnectionManager::ConnectionManager(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ConnectionManager::~ConnectionManager()
+{
+    disconnectAll();
+}
+
+void ConnectionManager::setConfig(const NetworkConfig &config)
+{
+    m_config = config;
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
+        NetworkConfig clientConfig = config;
+        clientConfig.serverAddress = it.value()->getConfig().serverAddress;
+        clientConfig.port = it.value()->getConfig().port;
+        it.value()->setConfig(clientConfig);
+    }
+}
+
+void ConnectionManager::setMediaCache(MediaCache *cache)
+{
+    m_mediaCache = cache;
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
+        it.value()->setMediaCache(cache);
+    }
+}
+
+void ConnectionManager::addServer(const Server &server)
+{
+    const QString host = server.host.isEmpty() ? m_config.serverAddress : server.host;
+    const int port = server.host.isEmpty() ? m_config.port : server.port;
+    if (host.isEmpty()) {
+        LOG_WARNING(LogCategory::Network, "No host configured for server %1", server.id);
+        return;
+    }
+
+    const QString endpoint = NetworkClient::endpointKey(host, port);
+    const QString previous = m_endpointByServer.value(server.id);
+    if (previous == endpoint) {
+        return;
+    }
+    if (!previous.isEmpty()) {
+        removeServer(server.id);
+    }
+
+    NetworkClient *client = nullptr;
+    auto it = m_clients.find(endpoint);
+    if (it != m_clients.end()) {
+        client = it.value().get();
+    } else {
+        client = createClient(endpoint, host, port);
+        client->connectToServer(host, port);
+    }
+
+    m_endpointByServer.insert(server.id, endpoint);
+    client->joinChannel(server.id);
+}
+
+void ConnectionManager::removeServer(const QString &serverId)
+{
+    const QString endpoint = m_endpointByServer.take(serverId);
+    auto it = m_clients.find(endpoint);
+    if (it == m_clients.end()) {
+        return;
+    }
+
+    NetworkClient *client = it.value().get();
+    client->leaveChannel(serverId);
+    if (client->channels().isEmpty()) {
+        LOG_INFO(LogCategory::Network, "Closing idle connection %1", endpoint);
+        client->disconnect();
+        // Outlives this call stack in case we are inside one of its signals
+        it.value().release()->deleteLater();
+        m_clients.erase(it);
+    }
+}
+
+void ConnectionManager::sendMessage(const Message &message)
+{
+    NetworkClient *client = clientFor(message.serverId);
+    if (!client) {
+        LOG_WARNING(LogCategory::Network, "No connection for server %1", message.serverId);
+        return;
+    }
+    client->sendMessage(message);
+}
+
+bool ConnectionManager::sendImage(const QString &serverId, const QString &sender, const QString &filePath,
+                                  QString *error)
+{
+    NetworkClient *client = clientFor(serverId);
+    if (!client) {
+        if (error) {
+            *error = tr("Not connected to this server");
+        }
+        return false;
+    }
+    return !client->sendImage(serverId, sender, filePath, error).isEmpty();
+}
+
+void ConnectionManager::disconnectAll()
+{
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
+        it.value()->disconnect();
+    }
+}
+
+NetworkClient *ConnectionManager::clientFor(const QString &serverId) const
+{
+    auto it = m_clients.find(m_endpointByServer.value(serverId));
+    return it != m_clients.end() ? it.value().get() : nullptr;
+}
+
+NetworkClient *ConnectionManager::createClient(const QString &endpoint, const QString &host, int port)
+{
+    auto client = std::make_unique<NetworkClient>();
+    NetworkConfig config = m_config;
+    config.serverAddress = host;
+    config.port = port;
+    client->setConfig(config);
+    client->setMediaCache(m_mediaCache);
+
+    NetworkClient *raw = client.get();
+    connect(raw, &NetworkClient::connected, this, &ConnectionManager::connected);
+    connect(raw, &NetworkClient::disconnected, this, &ConnectionManager::disconnected);
+    connect(raw, &NetworkClient::messageReceived, this, &ConnectionManager::messageReceived);
+    connect(raw, &NetworkClient::linkValidationResult, this, &ConnectionManager::linkValidationResult);
+    connect(raw, &NetworkClient::imageReceived, this, &ConnectionManager::imageReceived);
+    connect(raw, &NetworkClient::imageUploadProgress, this, &ConnectionManager::imageUploadProgress);
+    connect(raw, &NetworkClient::imageTransferFailed, this, &ConnectionManager::imageTransferFailed);
+    connect(raw, &NetworkClient::connectionError, this, [this, raw](const QString &error) {
+        for (const QString &channel : raw->channels()) {
+            emit connectionError(channel, error);
+        }
+    });
+
+    LOG_INFO(LogCategory::Network, "Opening connection %1", endpoint);
+    m_clients[endpoint] = std::move(client);
+    return raw;
+}
@@ -0,0 +1,59 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <memory>
+#include "networkclient.h"
+#include "include/types.h"
+
+// Keeps one NetworkClient per host:port and multiplexes every open server
+// tab on that endpoint over it. Each connection has its own reconnect
+// state, send queue and outbox. Everything runs on the caller's event loop,
+// so fifty tabs cost fifty channel entries, not fifty threads or sockets.
+class ConnectionManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ConnectionManager(QObject *parent = nullptr);
+    ~ConnectionManager() override;
+
+    void setConfig(const NetworkConfig &config);
+    // Received images are stored here, and images it already has are not fetched again
+    void setMediaCache(MediaCache *cache);
+
+    // Joins the server's channel, opening the endpoint's connection if needed
+    void addServer(const Server &server);
+    // Leaves the channel; the connection closes with its last channel
+    void removeServer(const QString &serverId);
+
+    void sendMessage(const Message &message);
+    bool sendImage(const QString &serverId, const QString &sender, const QString &filePath, QString *error = nullptr);
+    void disconnectAll();
+
+    NetworkClient *clientFor(const QString &serverId) const;
+    int connectionCount() const { return static_cast<int>(m_clients.size()); }
+    int serverCount() const { return m_endpointByServer.size(); }
+
+signals:
+    void connected(const QString &serverId);
+    void disconnected(const QString &serverId);
+    void messageReceived(const Message &message);
+    void connectionError(const QString &serverId, const QString &error);
+    void linkValidationResult(const QString &url, bool isMalicious);
+    void imageReceived(const QString &serverId, const QString &sender, const QString &mediaKey);
+    void imageUploadProgress(const QString &serverId, qint64 bytesAcked, qint64 totalBytes);
+    void imageTransferFailed(const QString &serverId, const QString &error);
+
+private:
+    NetworkClient *createClient(const QString &endpoint, const QString &host, int port);
+
+    NetworkConfig m_config;
+    MediaCache *m_mediaCache = nullptr;
+    QMap<QString, std::unique_ptr<NetworkClient>> m_clients;    // By endpoint
+    QHash<QString, QString> m_endpointByServer;
+};
+
+#endif // CONNECTIONMANAGER_H
@@ -0,0 +1,563 @@
+#include "logger.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#ifdef ROCHAT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static_assert(sizeof(LogRecord) == 256, "log records should stay one fixed 256-byte slot");
+
+namespace {
+
+// Single-producer, single-consumer: only the owning thread advances head,
+// only the writer advances tail
+struct Ring {
+    std::unique_ptr<LogRecord[]> records{new LogRecord[Logger::RingCapacity]};
+    alignas(64) std::atomic<quint64> head{0};
+    alignas(64) std::atomic<quint64> tail{0};
+    std::atomic<quint64> dropped{0};
+    std::atomic<bool> closed{false};
+    quint64 droppedReported = 0;    // Writer only
+    int thread = 0;
+};
+
+// A message too long for a record, formatted by the caller
+struct Line {
+    qint64 timeNs;
+    LogLevel level;
+    LogCategory category;
+    QString message;
+};
+
+struct Writer {
+    QMutex mutex;                   // Guards rings, overflow and the running state
+    QWaitCondition wake;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::vector<Line> overflow;
+    quint64 overflowDropped = 0;
+    int nextThread = 1;
+    QThread *thread = nullptr;
+    bool stopping = false;
+    std::atomic<quint8> echoLevel{quint8(LogLevel::Warning)};
+};
+
+Writer &writer()
+{
+    static Writer instance;
+    return instance;
+}
+
+// Closes the thread's ring when the thread exits; the writer drains what is
+// left and then forgets it
+struct RingHandle {
+    std::shared_ptr<Ring> ring;
+
+    ~RingHandle()
+    {
+        if (ring) {
+            ring->closed.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local RingHandle t_ring;
+
+Ring *threadRing()
+{
+    if (!t_ring.ring) {
+        auto ring = std::make_shared<Ring>();
+        Writer &w = writer();
+        QMutexLocker locker(&w.mutex);
+        ring->thread = w.nextThread++;
+        w.rings.push_back(ring);
+        t_ring.ring = std::move(ring);
+    }
+    return t_ring.ring.get();
+}
+
+qint64 nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+QString argText(const LogRecord &record, const LogRecord::Arg &arg)
+{
+    switch (arg.type) {
+    case LogRecord::Arg::Int:
+        return QString::number(arg.i);
+    case LogRecord::Arg::UInt:
+        return QString::number(arg.u);
+    case LogRecord::Arg::Double:
+        return QString::number(arg.d);
+    case LogRecord::Arg::Bool:
+        return arg.u ? QStringLiteral("true") : QStringLiteral("false");
+    case LogRecord::Arg::String: {
+        QString text(reinterpret_cast<const QChar *>(record.text + arg.offset), arg.length);
+        if (arg.truncated) {
+            text += QStringLiteral("...");
+        }
+        return text;
+    }
+    }
+    return QString();
+}
+
+// Substitutes %1..%9 in one pass
+QString formatRecord(const LogRecord &record)
+{
+    QString out;
+    for (const char *c = record.format; *c; ++c) {
+        if (c[0] == '%' && c[1] >= '1' && c[1] <= '9') {
+            const int index = c[1] - '1';
+            if (index < record.argCount) {
+                out += argText(record, record.args[index]);
+                ++c;
+                continue;
+            }
+        }
+        out += QLatin1Char(*c);
+    }
+    return out;
+}
+
+// rochat.log, rotated to rochat-<time>.log(.gz) past MaxFileBytes
+class LogFile
+{
+public:
+    explicit LogFile(const QString &directory)
+        : m_directory(directory)
+        , m_file(QDir(directory).filePath(QStringLiteral("rochat.log")))
+    {
+        QDir().mkpath(directory);
+        open();
+    }
+
+    void write(const QByteArray &data)
+    {
+        if (!m_file.isOpen()) {
+            return;
+        }
+        m_file.write(data);
+        if (m_file.size() >= Logger::MaxFileBytes) {
+            rotate();
+        }
+    }
+
+    void flush() { m_file.flush(); }
+
+private:
+    void open()
+    {
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            std::fprintf(stderr, "Could not open log file %s\n", qPrintable(m_file.fileName()));
+        }
+    }
+
+    void rotate()
+    {
+        m_file.close();
+        const QString stamp = QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMdd-HHmmss"));
+        const QString archive = QDir(m_directory).filePath(QStringLiteral("rochat-%1.log").arg(stamp));
+        QFile::remove(archive);
+        if (QFile::rename(m_file.fileName(), archive)) {
+            compress(archive);
+        }
+        prune();
+        open();
+    }
+
+    static void compress(const QString &path)
+    {
+#ifdef ROCHAT_HAVE_ZLIB
+        QFile input(path);
+        if (!input.open(QIODevice::ReadOnly)) {
+            return;
+        }
+        const QString target = path + QStringLiteral(".gz");
+        gzFile output = gzopen(QFile::encodeName(target).constData(), "wb6");
+        if (!output) {
+            return;
+        }
+        bool ok = true;
+        while (ok && !input.atEnd()) {
+            const QByteArray chunk = input.read(256 * 1024);
+            ok = gzwrite(output, chunk.constData(), unsigned(chunk.size())) == chunk.size();
+        }
+        ok = gzclose(output) == Z_OK && ok;
+        input.close();
+        if (ok) {
+            QFile::remove(path);
+        } else {
+            QFile::remove(target);
+        }
+#else
+        Q_UNUSED(path);
+#endif
+    }
+
+    void prune()
+    {
+        // Timestamped names sort oldest first
+        QDir dir(m_directory);
+        const QStringList archives = dir.entryList({QStringLiteral("rochat-*.log"), QStringLiteral("rochat-*.log.gz")},
+                                                   QDir::Files, QDir::Name);
+        for (int i = 0; i < archives.size() - Logger::MaxArchives; ++i) {
+            dir.remove(archives.at(i));
+        }
+    }
+
+    QString m_directory;
+    QFile m_file;
+};
+
+// Moves every ring's pending records out and writes them in time order.
+// Returns whether there was anything to write.
+bool drainOnce(LogFile &file, std::vector<LogRecord> &scratch, std::vector<Line> &lines)
+{
+    static Counter *const written = MetricsRegistry::instance().counter("log.records");
+    static Counter *const dropped = MetricsRegistry::instance().counter("log.dropped");
+
+    Writer &w = writer();
+    std::vector<std::shared_ptr<Ring>> rings;
+    quint64 overflowLost = 0;
+    lines.clear();
+    {
+        QMutexLocker locker(&w.mutex);
+        rings = w.rings;
+        lines.swap(w.overflow);
+        overflowLost = w.overflowDropped;
+        w.overflowDropped = 0;
+    }
+
+    scratch.clear();
+    std::vector<std::pair<const Ring *, quint64>> losses;
+    for (const std::shared_ptr<Ring> &ring : rings) {
+        // Read closed before head so a record committed just before the
+        // thread exited is not missed
+        const bool closed = ring->closed.load(std::memory_order_acquire);
+        const quint64 tail = ring->tail.load(std::memory_order_relaxed);
+        const quint64 head = ring->head.load(std::memory_order_acquire);
+        for (quint64 i = tail; i < head; ++i) {
+            scratch.push_back(ring->records[size_t(i % Logger::RingCapacity)]);
+        }
+        ring->tail.store(head, std::memory_order_release);
+
+        const quint64 lost = ring->dropped.load(std::memory_order_relaxed);
+        if (lost > ring->droppedReported) {
+            losses.emplace_back(ring.get(), lost - ring->droppedReported);
+            dropped->increment(lost - ring->droppedReported);
+            ring->droppedReported = lost;
+        }
+        if (closed) {
+            QMutexLocker locker(&w.mutex);
+            w.rings.erase(std::remove(w.rings.begin(), w.rings.end(), ring), w.rings.end());
+        }
+    }
+
+    // Each ring is already in order; interleave the threads and the long
+    // messages
+    for (const LogRecord &record : scratch) {
+        lines.push_back({record.timeNs, record.level, record.category, formatRecord(record)});
+    }
+    std::stable_sort(lines.begin(), lines.end(), [](const Line &a, const Line &b) {
+        return a.timeNs < b.timeNs;
+    });
+
+    const LogLevel echo = LogLevel(w.echoLevel.load(std::memory_order_relaxed));
+    QByteArray out;
+    auto emitLine = [&out, echo](qint64 timeNs, LogLevel level, LogCategory category, const QString &message) {
+        QJsonObject line;
+        line["time"] = QDateTime::fromMSecsSinceEpoch(timeNs / 1000000, Qt::UTC).toString(Qt::ISODateWithMs);
+        line["level"] = QLatin1String(Logger::levelName(level));
+        line["category"] = QLatin1String(Logger::categoryName(category));
+        line["message"] = message;
+        out += QJsonDocument(line).toJson(QJsonDocument::Compact);
+        out += '\n';
+        if (level >= echo) {
+            std::fprintf(stderr, "%s %s: %s\n", Logger::levelName(level), Logger::categoryName(category),
+                         qUtf8Printable(message));
+        }
+    };
+
+    for (const auto &loss : losses) {
+        emitLine(nowNs(), LogLevel::Warning, LogCategory::General,
+                 QStringLiteral("Log ring full on thread %1, dropped %2 records").arg(loss.first->thread).arg(loss.second));
+    }
+    if (overflowLost > 0) {
+        dropped->increment(overflowLost);
+        emitLine(nowNs(), LogLevel::Warning, LogCategory::General,
+                 QStringLiteral("Long message queue full, dropped %1 messages").arg(overflowLost));
+    }
+    for (const Line &line : lines) {
+        emitLine(line.timeNs, line.level, line.category, line.message);
+    }
+    written->increment(quint64(lines.size()));
+
+    if (!out.isEmpty()) {
+        file.write(out);
+        file.flush();
+    }
+    return !lines.empty() || !losses.empty() || overflowLost > 0;
+}
+
+void runWriter(const QString &directory)
+{
+    LogFile file(directory);
+    std::vector<LogRecord> scratch;
+    std::vector<Line> lines;
+    Writer &w = writer();
+    for (;;) {
+        drainOnce(file, scratch, lines);
+
+        QMutexLocker locker(&w.mutex);
+        if (w.stopping) {
+            break;
+        }
+        w.wake.wait(&w.mutex, Logger::DrainIntervalMs);
+    }
+    // Whatever was committed before stop() was called
+    while (drainOnce(file, scratch, lines)) {
+    }
+}
+
+QtMessageHandler g_previousHandler = nullptr;
+
+void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    LogLevel level = LogLevel::Debug;
+    switch (type) {
+    case QtDebugMsg:
+        level = LogLevel::Debug;
+        break;
+    case QtInfoMsg:
+        level = LogLevel::Info;
+        break;
+    case QtWarningMsg:
+        level = LogLevel::Warning;
+        break;
+    case QtCriticalMsg:
+    case QtFatalMsg:
+        level = LogLevel::Critical;
+        break;
+    }
+
+    if (Logger::isEnabled(level, LogCategory::General) || type == QtFatalMsg) {
+        Logger::writeText(level, LogCategory::General, message);
+    }
+    if (type == QtFatalMsg) {
+        // The process is about to abort; flush the rings before it does
+        Logger::stop();
+        if (g_previousHandler) {
+            g_previousHandler(type, context, message);
+        }
+    }
+}
+
+} // namespace
+
+std::atomic<quint8> Logger::s_levels[int(LogCategory::Count)] = {
+    {quint8(LogLevel::Info)}, {quint8(LogLevel::Info)}, {quint8(LogLevel::Info)},
+    {quint8(LogLevel::Info)}, {quint8(LogLevel::Info)}, {quint8(LogLevel::Info)}};
+
+void Logger::start(const QString &directory)
+{
+    Writer &w = writer();
+    QMutexLocker locker(&w.mutex);
+    if (w.thread) {
+        return;
+    }
+    w.stopping = false;
+    w.thread = QThread::create(runWriter, directory);
+    w.thread->setObjectName(QStringLiteral("logger"));
+    w.thread->start(QThread::LowPriority);
+}
+
+void Logger::stop()
+{
+    Writer &w = writer();
+    QThread *thread = nullptr;
+    {
+        QMutexLocker locker(&w.mutex);
+        if (!w.thread || w.thread == QThread::currentThread()) {
+            return;
+        }
+        w.stopping = true;
+        w.wake.wakeAll();
+        thread = w.thread;
+    }
+    thread->wait();
+    delete thread;
+
+    QMutexLocker locker(&w.mutex);
+    w.thread = nullptr;
+}
+
+void Logger::writeText(LogLevel level, LogCategory category, const QString &message)
+{
+    if (message.size() <= LogRecord::TextChars) {
+        write(level, category, "%1", message);
+        return;
+    }
+
+    Writer &w = writer();
+    QMutexLocker locker(&w.mutex);
+    if (w.overflow.size() >= size_t(MaxOverflowMessages)) {
+        ++w.overflowDropped;
+        return;
+    }
+    w.overflow.push_back({nowNs(), level, category, message});
+}
+
+void Logger::setLevel(LogCategory category, LogLevel level)
+{
+    s_levels[int(category)].store(quint8(level), std::memory_order_relaxed);
+}
+
+void Logger::setLevel(LogLevel level)
+{
+    for (int category = 0; category < int(LogCategory::Count); ++category) {
+        setLevel(LogCategory(category), level);
+    }
+}
+
+void Logger::configure(const QString &rules)
+{
+    for (const QString &rule : rules.split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        const QString name = rule.section(QLatin1Char('='), 0, 0).trimmed().toLower();
+        const QString levelText = rule.section(QLatin1Char('='), 1).trimmed().toLower();
+
+        int level = -1;
+        for (int i = 0; i <= int(LogLevel::Off); ++i) {
+            if (levelText == QLatin1String(levelName(LogLevel(i)))) {
+                level = i;
+            }
+        }
+        if (level < 0) {
+            continue;
+        }
+        if (name == QLatin1String("*")) {
+            setLevel(LogLevel(level));
+            continue;
+        }
+        for (int category = 0; category < int(LogCategory::Count); ++category) {
+            if (name == QLatin1String(categoryName(LogCategory(category)))) {
+                setLevel(LogCategory(category), LogLevel(level));
+            }
+        }
+    }
+}
+
+void Logger::setEchoLevel(LogLevel level)
+{
+    writer().echoLevel.store(quint8(level), std::memory_order_relaxed);
+}
+
+void Logger::installMessageHandler()
+{
+    g_previousHandler = qInstallMessageHandler(messageHandler);
+}
+
+const char *Logger::levelName(LogLevel level)
+{
+    switch (level) {
+    case LogLevel::Debug:
+        return "debug";
+    case LogLevel::Info:
+        return "info";
+    case LogLevel::Warning:
+        return "warning";
+    case LogLevel::Critical:
+        return "critical";
+    case LogLevel::Off:
+        return "off";
+    }
+    return "";
+}
+
+const char *Logger::categoryName(LogCategory category)
+{
+    switch (category) {
+    case LogCategory::General:
+        return "general";
+    case LogCategory::Network:
+        return "network";
+    case LogCategory::Moderation:
+        return "moderation";
+    case LogCategory::Chat:
+        return "chat";
+    case LogCategory::Media:
+        return "media";
+    case LogCategory::Storage:
+        return "storage";
+    case LogCategory::Count:
+        break;
+    }
+    return "";
+}
+
+LogRecord *Logger::beginRecord(LogLevel level, LogCategory category, const char *format)
+{
+    Ring *ring = threadRing();
+    const quint64 head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= quint64(RingCapacity)) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    LogRecord &record = ring->records[size_t(head % RingCapacity)];
+    record.timeNs = nowNs();
+    record.format = format;
+    record.level = level;
+    record.category = category;
+    record.argCount = 0;
+    record.textUsed = 0;
+    return &record;
+}
+
+void Logger::commitRecord()
+{
+    Ring *ring = t_ring.ring.get();
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Logger::appendText(LogRecord &record, const char16_t *text, qsizetype length)
+{
+    LogRecord::Arg &arg = nextArg(record, LogRecord::Arg::String);
+    const qsizetype room = LogRecord::TextChars - record.textUsed;
+    const qsizetype copied = qMin(length, room);
+    arg.offset = record.textUsed;
+    arg.length = quint16(copied);
+    arg.truncated = copied < length;
+    std::memcpy(record.text + record.textUsed, text, size_t(copied) * sizeof(char16_t));
+    record.textUsed = quint8(record.textUsed + copied);
+}
+
+void Logger::appendLatin1(LogRecord &record, const char *text, qsizetype length)
+{
+    LogRecord::Arg &arg = nextArg(record, LogRecord::Arg::String);
+    const qsizetype room = LogRecord::TextChars - record.textUsed;
+    const qsizetype copied = qMin(length, room);
+    arg.offset = record.textUsed;
+    arg.length = quint16(copied);
+    arg.truncated = copied < length;
+    for (qsizetype i = 0; i < copied; ++i) {
+        record.text[record.textUsed + i] = char16_t(uchar(text[i]));
+    }
+    record.textUsed = quint8(record.textUsed + copied);
+}
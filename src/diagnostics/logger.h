@@ -0,0 +1,191 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <QByteArray>
+#include <QLatin1String>
+#include <QString>
+#include <QStringView>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+// Asynchronous structured logger.
+//
+// LOG_INFO(LogCategory::Network, "Connected to %1 in %2 ms", endpoint, ms)
+// checks the level with one relaxed atomic load, then copies the format
+// pointer and the raw arguments into a fixed-size record in the calling
+// thread's ring buffer. Nothing is formatted, allocated or locked on the
+// calling thread. A background thread drains every ring, formats the
+// records as JSON lines into <directory>/rochat.log, and rotates and
+// compresses the file when it grows too large.
+//
+// A full ring drops the record and counts it; the writer reports the loss
+// in the log and in the "log.dropped" metric, so logging never blocks.
+//
+// Formats must be string literals; %1..%9 are replaced by the arguments.
+// Strings are copied as UTF-16 into the record and truncated if they do
+// not fit, so log identifiers and sizes rather than message bodies;
+// writeText() keeps longer free-form text whole.
+
+enum class LogLevel : quint8 {
+    Debug,
+    Info,
+    Warning,
+    Critical,
+    Off
+};
+
+enum class LogCategory : quint8 {
+    General,
+    Network,
+    Moderation,
+    Chat,
+    Media,
+    Storage,
+    Count
+};
+
+struct LogRecord {
+    static constexpr int MaxArgs = 6;
+    static constexpr int TextChars = 68;
+
+    struct Arg {
+        enum Type : quint8 {
+            Int,
+            UInt,
+            Double,
+            Bool,
+            String
+        };
+        Type type;
+        bool truncated;
+        quint16 offset;         // String: range in text
+        quint16 length;
+        union {
+            qint64 i;
+            quint64 u;
+            double d;
+        };
+    };
+
+    qint64 timeNs;              // Since the epoch
+    const char *format;
+    LogLevel level;
+    LogCategory category;
+    quint8 argCount;
+    quint8 textUsed;
+    Arg args[MaxArgs];
+    char16_t text[TextChars];
+};
+
+class Logger
+{
+public:
+    static constexpr int RingCapacity = 1024;           // Records per thread; 256 KB
+    static constexpr int DrainIntervalMs = 50;
+    static constexpr qint64 MaxFileBytes = 8 * 1024 * 1024;
+    static constexpr int MaxArchives = 10;
+    static constexpr int MaxOverflowMessages = 1024;    // Per drain interval
+
+    // Starts the writer thread; records logged before this are kept until
+    // the rings fill
+    static void start(const QString &directory);
+    // Drains everything still queued and stops the writer
+    static void stop();
+
+    static bool isEnabled(LogLevel level, LogCategory category)
+    {
+        return quint8(level) >= s_levels[int(category)].load(std::memory_order_relaxed);
+    }
+    static void setLevel(LogCategory category, LogLevel level);
+    static void setLevel(LogLevel level);
+    // Comma-separated "category=level" pairs, "*" for all, e.g.
+    // "*=info,network=debug"
+    static void configure(const QString &rules);
+    // Records at or above this level are also written to stderr by the
+    // writer thread
+    static void setEchoLevel(LogLevel level);
+
+    // Routes qDebug/qInfo/qWarning/qCritical into the logger, so code not
+    // yet using LOG_* also stops writing to the console synchronously
+    static void installMessageHandler();
+
+    static const char *levelName(LogLevel level);
+    static const char *categoryName(LogCategory category);
+
+    // For free-form text of any length, such as forwarded Qt messages. Text
+    // that fits goes through the ring; longer text is kept whole in a
+    // mutex-guarded side queue, which drops and counts past
+    // MaxOverflowMessages rather than grow.
+    static void writeText(LogLevel level, LogCategory category, const QString &message);
+
+    template <typename... Args>
+    static void write(LogLevel level, LogCategory category, const char *format, const Args &...args)
+    {
+        static_assert(sizeof...(Args) <= LogRecord::MaxArgs, "too many log arguments");
+        LogRecord *record = beginRecord(level, category, format);
+        if (!record) {
+            return;
+        }
+        (append(*record, args), ...);
+        commitRecord();
+    }
+
+private:
+    static LogRecord *beginRecord(LogLevel level, LogCategory category, const char *format);
+    static void commitRecord();
+
+    static LogRecord::Arg &nextArg(LogRecord &record, LogRecord::Arg::Type type)
+    {
+        LogRecord::Arg &arg = record.args[record.argCount++];
+        arg.type = type;
+        arg.truncated = false;
+        return arg;
+    }
+
+    static void appendText(LogRecord &record, const char16_t *text, qsizetype length);
+    static void appendLatin1(LogRecord &record, const char *text, qsizetype length);
+
+    static void append(LogRecord &record, bool value) { nextArg(record, LogRecord::Arg::Bool).u = value; }
+    static void append(LogRecord &record, const QString &value)
+    {
+        appendText(record, reinterpret_cast<const char16_t *>(value.utf16()), value.size());
+    }
+    static void append(LogRecord &record, QStringView value) { appendText(record, value.utf16(), value.size()); }
+    static void append(LogRecord &record, QLatin1String value) { appendLatin1(record, value.data(), value.size()); }
+    static void append(LogRecord &record, const char *value) { appendLatin1(record, value, qstrlen(value)); }
+    static void append(LogRecord &record, const QByteArray &value)
+    {
+        appendLatin1(record, value.constData(), value.size());
+    }
+    template <typename T>
+    static std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>> append(LogRecord &record, T value)
+    {
+        if constexpr (std::is_signed_v<T> || std::is_enum_v<T>) {
+            nextArg(record, LogRecord::Arg::Int).i = qint64(value);
+        } else {
+            nextArg(record, LogRecord::Arg::UInt).u = quint64(value);
+        }
+    }
+    template <typename T>
+    static std::enable_if_t<std::is_floating_point_v<T>> append(LogRecord &record, T value)
+    {
+        nextArg(record, LogRecord::Arg::Double).d = double(value);
+    }
+
+    static std::atomic<quint8> s_levels[int(LogCategory::Count)];
+};
+
+#define ROCHAT_LOG(level, category, format, ...) \
+    do { \
+        if (Logger::isEnabled(level, category)) { \
+            Logger::write(level, category, "" format "", ##__VA_ARGS__); \
+        } \
+    } while (false)
+
+#define LOG_DEBUG(category, format, ...) ROCHAT_LOG(LogLevel::Debug, category, format, ##__VA_ARGS__)
+#define LOG_INFO(category, format, ...) ROCHAT_LOG(LogLevel::Info, category, format, ##__VA_ARGS__)
+#define LOG_WARNING(category, format, ...) ROCHAT_LOG(LogLevel::Warning, category, format, ##__VA_ARGS__)
+#define LOG_CRITICAL(category, format, ...) ROCHAT_LOG(LogLevel::Critical, category, format, ##__VA_ARGS__)
+
+#endif // LOGGER_H
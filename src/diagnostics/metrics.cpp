@@ -0,0 +1,110 @@
+#include "metrics.h"
+#include <QMutexLocker>
+
+Histogram::Histogram()
+    : m_buckets(new std::atomic<quint64>[size_t(LatencyHistogram::bucketCount())])
+{
+    for (int i = 0; i < LatencyHistogram::bucketCount(); ++i) {
+        m_buckets[size_t(i)].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(qint64 value)
+{
+    value = qBound<qint64>(0, value, LatencyHistogram::MaxValue);
+    m_buckets[size_t(LatencyHistogram::bucketFor(value))].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    qint64 max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram Histogram::snapshot() const
+{
+    // Buckets are read one at a time while writers carry on, so a snapshot
+    // may be off by the few values recorded while it was taken
+    LatencyHistogram snapshot;
+    for (int i = 0; i < LatencyHistogram::bucketCount(); ++i) {
+        snapshot.record(LatencyHistogram::highestValueIn(i),
+                        m_buckets[size_t(i)].load(std::memory_order_relaxed));
+    }
+    return snapshot;
+}
+
+MetricsRegistry::MetricsRegistry()
+{
+    m_uptime.start();
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+Counter *MetricsRegistry::counter(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    std::unique_ptr<Counter> &counter = m_counters[name];
+    if (!counter) {
+        counter = std::make_unique<Counter>();
+    }
+    return counter.get();
+}
+
+Gauge *MetricsRegistry::gauge(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    std::unique_ptr<Gauge> &gauge = m_gauges[name];
+    if (!gauge) {
+        gauge = std::make_unique<Gauge>();
+    }
+    return gauge.get();
+}
+
+Histogram *MetricsRegistry::histogram(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    std::unique_ptr<Histogram> &histogram = m_histograms[name];
+    if (!histogram) {
+        histogram = std::make_unique<Histogram>();
+    }
+    return histogram.get();
+}
+
+QJsonObject MetricsRegistry::snapshot() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QJsonObject counters;
+    for (const auto &entry : m_counters) {
+        counters[entry.first] = qint64(entry.second->value());
+    }
+    QJsonObject gauges;
+    for (const auto &entry : m_gauges) {
+        gauges[entry.first] = entry.second->value();
+    }
+    QJsonObject histograms;
+    for (const auto &entry : m_histograms) {
+        const Histogram &histogram = *entry.second;
+        const LatencyHistogram values = histogram.snapshot();
+        QJsonObject object;
+        object["count"] = qint64(histogram.count());
+        object["mean"] = histogram.count() ? double(histogram.sum()) / double(histogram.count()) : 0.0;
+        object["p50"] = values.valueAtPercentile(50);
+        object["p90"] = values.valueAtPercentile(90);
+        object["p99"] = values.valueAtPercentile(99);
+        object["p999"] = values.valueAtPercentile(99.9);
+        object["max"] = histogram.max();
+        histograms[entry.first] = object;
+    }
+
+    QJsonObject snapshot;
+    snapshot["uptime_ms"] = m_uptime.elapsed();
+    snapshot["counters"] = counters;
+    snapshot["gauges"] = gauges;
+    snapshot["histograms"] = histograms;
+    return snapshot;
+}
@@ -0,0 +1,108 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <map>
+#include <memory>
+#include "latencyhistogram.h"
+
+// Process-wide counters, gauges and histograms. Metrics are looked up by
+// name once, usually into a function-local static, and the returned pointer
+// stays valid for the life of the process. Updates are single relaxed
+// atomic operations, safe from any thread and cheap enough for per-message
+// paths. The same name always returns the same metric, so several
+// NetworkClients add into one set of totals.
+//
+// Names are dotted, "<component>.<what>". Histograms carry their unit as a
+// suffix: durations are "*_ns" (or "*_ms" where only milliseconds are
+// known), counts have none.
+
+class Counter
+{
+public:
+    void increment(quint64 by = 1) { m_value.fetch_add(by, std::memory_order_relaxed); }
+    quint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> m_value{0};
+};
+
+class Gauge
+{
+public:
+    void set(qint64 value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(qint64 delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value{0};
+};
+
+// Concurrent counterpart of LatencyHistogram, with the same buckets.
+// Percentiles come from snapshot(); count, sum and max are exact.
+class Histogram
+{
+public:
+    Histogram();
+
+    void record(qint64 value);
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    qint64 sum() const { return m_sum.load(std::memory_order_relaxed); }
+    qint64 max() const { return m_max.load(std::memory_order_relaxed); }
+    LatencyHistogram snapshot() const;
+
+private:
+    std::unique_ptr<std::atomic<quint64>[]> m_buckets;
+    std::atomic<quint64> m_count{0};
+    std::atomic<qint64> m_sum{0};
+    std::atomic<qint64> m_max{0};
+};
+
+// Records the time from construction to destruction into a histogram
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Histogram *histogram)
+        : m_histogram(histogram)
+    {
+        m_timer.start();
+    }
+    ~ScopedTimer() { m_histogram->record(m_timer.nsecsElapsed()); }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Histogram *m_histogram;
+    QElapsedTimer m_timer;
+};
+
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance();
+
+    Counter *counter(const QString &name);
+    Gauge *gauge(const QString &name);
+    Histogram *histogram(const QString &name);
+
+    // {"uptime_ms", "counters": {...}, "gauges": {...}, "histograms":
+    // {name: {count, mean, p50, p90, p99, p999, max}}}
+    QJsonObject snapshot() const;
+
+private:
+    MetricsRegistry();
+
+    mutable QMutex m_mutex;
+    std::map<QString, std::unique_ptr<Counter>> m_counters;
+    std::map<QString, std::unique_ptr<Gauge>> m_gauges;
+    std::map<QString, std::unique_ptr<Histogram>> m_histograms;
+    QElapsedTimer m_uptime;
+};
+
+#endif // METRICS_H
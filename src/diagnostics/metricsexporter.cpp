@@ -0,0 +1,36 @@
+#include "metricsexporter.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDebug>
+
+MetricsExporter::MetricsExporter(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_filePath(QDir(directory).filePath(QStringLiteral("metrics.json")))
+{
+    QDir().mkpath(directory);
+    m_timer.setInterval(DefaultIntervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &MetricsExporter::exportNow);
+    m_timer.start();
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    exportNow();
+}
+
+bool MetricsExporter::exportNow()
+{
+    QJsonObject snapshot = MetricsRegistry::instance().snapshot();
+    snapshot["time"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write metrics to" << m_filePath << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(snapshot).toJson(QJsonDocument::Indented));
+    return file.commit();
+}
@@ -0,0 +1,32 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QObject>
+#include <QTimer>
+
+// Writes MetricsRegistry snapshots to <directory>/metrics.json every
+// interval, replacing the previous one atomically, so the file can be
+// tailed or collected while the app runs. A last snapshot is written on
+// destruction.
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int DefaultIntervalMs = 10000;
+
+    explicit MetricsExporter(const QString &directory, QObject *parent = nullptr);
+    ~MetricsExporter() override;
+
+    void setInterval(int intervalMs) { m_timer.setInterval(intervalMs); }
+    QString filePath() const { return m_filePath; }
+
+public slots:
+    bool exportNow();
+
+private:
+    QString m_filePath;
+    QTimer m_timer;
+};
+
+#endif // METRICSEXPORTER_H
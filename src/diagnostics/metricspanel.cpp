@@ -0,0 +1,108 @@
+#include "metricspanel.h"
+#include "metrics.h"
+#include <QHeaderView>
+#include <QJsonObject>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+enum Column {
+    NameColumn,
+    ValueColumn,
+    P50Column,
+    P99Column,
+    MaxColumn,
+    ColumnCount
+};
+
+} // namespace
+
+MetricsPanel::MetricsPanel(QWidget *parent)
+    : QWidget(parent, Qt::Tool)
+    , m_tree(new QTreeWidget(this))
+{
+    setWindowTitle(tr("Metrics"));
+    resize(640, 480);
+
+    m_tree->setColumnCount(ColumnCount);
+    m_tree->setHeaderLabels({tr("Metric"), tr("Value / count"), tr("p50"), tr("p99"), tr("max")});
+    m_tree->header()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+    m_tree->setRootIsDecorated(true);
+    m_tree->setUniformRowHeights(true);
+
+    m_counters = new QTreeWidgetItem(m_tree, {tr("Counters")});
+    m_gauges = new QTreeWidgetItem(m_tree, {tr("Gauges")});
+    m_histograms = new QTreeWidgetItem(m_tree, {tr("Histograms")});
+    m_tree->expandAll();
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(m_tree);
+
+    m_timer.setInterval(RefreshIntervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &MetricsPanel::refresh);
+}
+
+void MetricsPanel::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+    m_timer.start();
+}
+
+void MetricsPanel::hideEvent(QHideEvent *event)
+{
+    m_timer.stop();
+    QWidget::hideEvent(event);
+}
+
+void MetricsPanel::refresh()
+{
+    const QJsonObject snapshot = MetricsRegistry::instance().snapshot();
+
+    const QJsonObject counters = snapshot.value("counters").toObject();
+    for (auto it = counters.constBegin(); it != counters.constEnd(); ++it) {
+        row(m_counters, it.key())->setText(ValueColumn, QString::number(it.value().toInteger()));
+    }
+    const QJsonObject gauges = snapshot.value("gauges").toObject();
+    for (auto it = gauges.constBegin(); it != gauges.constEnd(); ++it) {
+        row(m_gauges, it.key())->setText(ValueColumn, QString::number(it.value().toInteger()));
+    }
+    const QJsonObject histograms = snapshot.value("histograms").toObject();
+    for (auto it = histograms.constBegin(); it != histograms.constEnd(); ++it) {
+        const QJsonObject histogram = it.value().toObject();
+        QTreeWidgetItem *item = row(m_histograms, it.key());
+        item->setText(ValueColumn, QString::number(histogram.value("count").toInteger()));
+        item->setText(P50Column, formatValue(it.key(), histogram.value("p50").toDouble()));
+        item->setText(P99Column, formatValue(it.key(), histogram.value("p99").toDouble()));
+        item->setText(MaxColumn, formatValue(it.key(), histogram.value("max").toDouble()));
+    }
+}
+
+QTreeWidgetItem *MetricsPanel::row(QTreeWidgetItem *group, const QString &name)
+{
+    // Metrics are only ever added, and snapshots list them in name order
+    for (int i = 0; i < group->childCount(); ++i) {
+        if (group->child(i)->text(NameColumn) == name) {
+            return group->child(i);
+        }
+    }
+    return new QTreeWidgetItem(group, {name});
+}
+
+QString MetricsPanel::formatValue(const QString &name, double value)
+{
+    if (name.endsWith(QLatin1String("_ms"))) {
+        value *= 1e6;
+    } else if (!name.endsWith(QLatin1String("_ns"))) {
+        return QString::number(value);
+    }
+    if (value >= 1e6) {
+        return QString::number(value / 1e6, 'f', 2) + QStringLiteral(" ms");
+    }
+    if (value >= 1e3) {
+        return QString::number(value / 1e3, 'f', 1) + QStringLiteral(" µs");
+    }
+    return QString::number(value, 'f', 0) + QStringLiteral(" ns");
+}
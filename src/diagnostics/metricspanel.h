@@ -0,0 +1,37 @@
+#ifndef METRICSPANEL_H
+#define METRICSPANEL_H
+
+#include <QWidget>
+#include <QTimer>
+
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Debug window listing every registered metric, refreshed once a second
+// while it is shown
+class MetricsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    static constexpr int RefreshIntervalMs = 1000;
+
+    explicit MetricsPanel(QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    void refresh();
+    QTreeWidgetItem *row(QTreeWidgetItem *group, const QString &name);
+    static QString formatValue(const QString &name, double value);
+
+    QTreeWidget *m_tree;
+    QTreeWidgetItem *m_counters;
+    QTreeWidgetItem *m_gauges;
+    QTreeWidgetItem *m_histograms;
+    QTimer m_timer;
+};
+
+#endif // METRICSPANEL_H
@@ -0,0 +1,145 @@
+#include "duplicatefilter.h"
+#include "diagnostics/metrics.h"
+#include <QDateTime>
+
+namespace {
+
+// Two independent hashes; the k Bloom probes are h1 + i * h2
+constexpr size_t SeedA = 0x9e3779b97f4a7c15ull;
+constexpr size_t SeedB = 0xc2b2ae3d27d4eb4full;
+
+} // namespace
+
+bool DuplicateFilter::Bloom::mightContain(size_t h1, size_t h2) const
+{
+    for (int i = 0; i < BloomHashes; ++i) {
+        const size_t bit = (h1 + size_t(i) * h2) % BloomBits;
+        if (!(bits[int(bit / 64)] & (quint64(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DuplicateFilter::Bloom::insert(size_t h1, size_t h2)
+{
+    for (int i = 0; i < BloomHashes; ++i) {
+        const size_t bit = (h1 + size_t(i) * h2) % BloomBits;
+        bits[int(bit / 64)] |= quint64(1) << (bit % 64);
+    }
+    ++count;
+}
+
+DuplicateFilter::DuplicateFilter()
+{
+    m_clock.start();
+}
+
+bool DuplicateFilter::accept(const Message &message)
+{
+    if (message.id.isEmpty()) {
+        return true;
+    }
+
+    Channel &channel = channelFor(message.serverId);
+    const size_t h1 = qHash(message.id, SeedA);
+    const size_t h2 = qHash(message.id, SeedB) | 1;
+    if (isDuplicate(channel, message, h1, h2)) {
+        ++channel.suppressed;
+        ++m_suppressed;
+        static Counter *const suppressed = MetricsRegistry::instance().counter("dedup.suppressed");
+        suppressed->increment();
+        return false;
+    }
+    record(channel, message.id, h1, h2);
+    return true;
+}
+
+void DuplicateFilter::remember(const Message &message)
+{
+    if (message.id.isEmpty()) {
+        return;
+    }
+    Channel &channel = channelFor(message.serverId);
+    if (!channel.recent.contains(message.id)) {
+        record(channel, message.id, qHash(message.id, SeedA), qHash(message.id, SeedB) | 1);
+    }
+}
+
+void DuplicateFilter::forget(const QString &channel)
+{
+    m_channels.remove(channel);
+}
+
+quint64 DuplicateFilter::suppressedOn(const QString &channel) const
+{
+    auto it = m_channels.constFind(channel);
+    return it != m_channels.constEnd() ? it->suppressed : 0;
+}
+
+qint64 DuplicateFilter::memoryBytes() const
+{
+    // Bloom bits dominate; ids are counted at their UTF-16 size plus hash overhead
+    qint64 bytes = 0;
+    for (const Channel &channel : m_channels) {
+        bytes += 2 * (BloomBits / 8);
+        bytes += channel.recent.size() * qint64(sizeof(QString) * 2 + sizeof(qint64) + 32 + 72);
+    }
+    return bytes;
+}
+
+DuplicateFilter::Channel &DuplicateFilter::channelFor(const QString &serverId)
+{
+    Channel &channel = m_channels[serverId];
+    const qint64 now = m_clock.elapsed();
+    expire(channel, now);
+
+    // Rotate on age or when the current filter reaches its rated capacity
+    if (now - channel.generationStart >= BloomGenerationMs || channel.current.count >= BloomCapacity) {
+        channel.previous = std::move(channel.current);
+        channel.current = Bloom();
+        channel.generationStart = now;
+    }
+    return channel;
+}
+
+bool DuplicateFilter::isDuplicate(Channel &channel, const Message &message, size_t h1, size_t h2)
+{
+    if (channel.recent.contains(message.id)) {
+        return true;
+    }
+    if (!channel.current.mightContain(h1, h2) && !channel.previous.mightContain(h1, h2)) {
+        return false;
+    }
+
+    // Probably seen before, but not recently. Only trust that for messages
+    // older than what the exact set covers; anything newer would be in it.
+    const qint64 covered = qMin(ExactWindowMs, m_clock.elapsed() - channel.exactSince);
+    const qint64 age = QDateTime::currentMSecsSinceEpoch() - message.timestamp.toMSecsSinceEpoch();
+    return message.timestamp.isValid() && age > covered;
+}
+
+void DuplicateFilter::record(Channel &channel, const QString &id, size_t h1, size_t h2)
+{
+    const qint64 now = m_clock.elapsed();
+    if (channel.order.size() >= MaxExactIds) {
+        // Evicted early, so the exact set now only covers ids seen since
+        // the oldest one it keeps
+        channel.recent.remove(channel.order.dequeue());
+        channel.exactSince = channel.order.isEmpty() ? now : channel.recent.value(channel.order.head(), now);
+    }
+    channel.recent.insert(id, now);
+    channel.order.enqueue(id);
+    channel.current.insert(h1, h2);
+}
+
+void DuplicateFilter::expire(Channel &channel, qint64 now)
+{
+    while (!channel.order.isEmpty()) {
+        auto it = channel.recent.constFind(channel.order.head());
+        if (it != channel.recent.constEnd() && now - it.value() < ExactWindowMs) {
+            break;
+        }
+        channel.recent.remove(channel.order.dequeue());
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef DUPLICATEFILTER_H
+#define DUPLICATEFILTER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <QVector>
+#include "include/types.h"
+
+// Drops messages whose id was already seen on the same channel: server
+// retries, outbox replays after a reconnect, and the server's echo of our
+// own messages. Runs before moderation, so a duplicate costs one lookup.
+//
+// Each channel has two layers with a fixed memory cost:
+//  - an exact set of the ids seen in the last ExactWindowMs, capped at
+//    MaxExactIds, which decides for anything recent;
+//  - a pair of Bloom filters, rotated every BloomGenerationMs or when full,
+//    that remember older ids for up to two generations.
+// A Bloom hit alone only suppresses messages older than what the exact set
+// still covers: the full window normally, or back to the oldest id it kept
+// when a burst overflowed MaxExactIds. A false positive can therefore only
+// hide a message older than that, which is (rarely) a stale replay.
+class DuplicateFilter
+{
+public:
+    static constexpr qint64 ExactWindowMs = 5 * 60 * 1000;
+    static constexpr int MaxExactIds = 4096;
+    static constexpr qint64 BloomGenerationMs = 30 * 60 * 1000;
+    static constexpr int BloomBits = 1 << 17;           // 16 KB per generation
+    static constexpr int BloomCapacity = 10000;         // ~0.2% false positives when full
+    static constexpr int BloomHashes = 7;
+
+    DuplicateFilter();
+
+    // Records the message and returns true if it is new
+    bool accept(const Message &message);
+    // Records a message we sent, so the server's copy is dropped
+    void remember(const Message &message);
+    void forget(const QString &channel);
+
+    quint64 suppressed() const { return m_suppressed; }
+    quint64 suppressedOn(const QString &channel) const;
+    qint64 memoryBytes() const;
+
+private:
+    struct Bloom {
+        QVector<quint64> bits = QVector<quint64>(BloomBits / 64, 0);
+        int count = 0;
+
+        bool mightContain(size_t h1, size_t h2) const;
+        void insert(size_t h1, size_t h2);
+    };
+
+    struct Channel {
+        QHash<QString, qint64> recent;              // Id -> first seen, on m_clock
+        QQueue<QString> order;                      // Oldest first, for expiry
+        Bloom current;
+        Bloom previous;
+        qint64 generationStart = 0;
+        qint64 exactSince = 0;                      // First seen of the oldest id kept past the cap
+        quint64 suppressed = 0;
+    };
+
+    Channel &channelFor(const QString &serverId);
+    bool isDuplicate(Channel &channel, const Message &message, size_t h1, size_t h2);
+    void record(Channel &channel, const QString &id, size_t h1, size_t h2);
+    void expire(Channel &channel, qint64 now);
+
+    QHash<QString, Channel> m_channels;
+    QElapsedTimer m_clock;
+    quint64 m_suppressed = 0;
+};
+
+#endif // DUPLICATEFILTER_H
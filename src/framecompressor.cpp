@@ -0,0 +1,310 @@
+#include "framecompressor.h"
+#include <QFile>
+#include <QHash>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+#ifdef ROCHAT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Raw deflate with Z_SYNC_FLUSH ends every frame with this empty stored
+// block; it is dropped on the wire and restored before inflating
+const char SyncTail[] = {'\x00', '\x00', '\xff', '\xff'};
+
+} // namespace
+
+#ifdef ROCHAT_HAVE_ZLIB
+
+struct FrameCompressor::Streams {
+    z_stream deflater{};
+    z_stream inflater{};
+    bool deflaterReady = false;
+    bool inflaterReady = false;
+
+    ~Streams()
+    {
+        if (deflaterReady) {
+            deflateEnd(&deflater);
+        }
+        if (inflaterReady) {
+            inflateEnd(&inflater);
+        }
+    }
+};
+
+#else
+
+struct FrameCompressor::Streams {
+};
+
+#endif
+
+FrameCompressor::FrameCompressor()
+    : m_dictionary(defaultDictionary())
+{
+}
+
+FrameCompressor::~FrameCompressor() = default;
+
+bool FrameCompressor::isAvailable()
+{
+#ifdef ROCHAT_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FrameCompressor::setDictionary(const QByteArray &dictionary)
+{
+    m_dictionary = dictionary;
+}
+
+bool FrameCompressor::loadDictionary(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    setDictionary(file.readAll());
+    return true;
+}
+
+quint32 FrameCompressor::dictionaryId() const
+{
+#ifdef ROCHAT_HAVE_ZLIB
+    // The same Adler-32 zlib itself uses to identify preset dictionaries
+    return quint32(adler32(adler32(0L, Z_NULL, 0),
+                           reinterpret_cast<const Bytef *>(m_dictionary.constData()),
+                           uInt(m_dictionary.size())));
+#else
+    return 0;
+#endif
+}
+
+bool FrameCompressor::start()
+{
+    stop();
+#ifdef ROCHAT_HAVE_ZLIB
+    auto streams = std::make_unique<Streams>();
+
+    // Negative window bits: raw deflate, no zlib header per frame
+    if (deflateInit2(&streams->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    streams->deflaterReady = true;
+    if (inflateInit2(&streams->inflater, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+    streams->inflaterReady = true;
+
+    if (!m_dictionary.isEmpty()) {
+        const auto *dictionary = reinterpret_cast<const Bytef *>(m_dictionary.constData());
+        if (deflateSetDictionary(&streams->deflater, dictionary, uInt(m_dictionary.size())) != Z_OK
+            || inflateSetDictionary(&streams->inflater, dictionary, uInt(m_dictionary.size())) != Z_OK) {
+            qWarning() << "Failed to load compression dictionary";
+            return false;
+        }
+    }
+
+    m_streams = std::move(streams);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FrameCompressor::stop()
+{
+    m_streams.reset();
+}
+
+bool FrameCompressor::isCompressedFrame(const QByteArray &frame)
+{
+    return frame.size() >= 2 && (quint8(frame.at(1)) & CompressedFlag);
+}
+
+QByteArray FrameCompressor::compressFrame(const QByteArray &frame)
+{
+#ifdef ROCHAT_HAVE_ZLIB
+    if (!m_streams || frame.size() < 2 + MinCompressBytes) {
+        return frame;
+    }
+
+    z_stream &stream = m_streams->deflater;
+    const qsizetype bodySize = frame.size() - 2;
+
+    QByteArray out;
+    out.resize(2 + qsizetype(deflateBound(&stream, uLong(bodySize))) + 16);
+    out[0] = frame.at(0);
+    out[1] = char(quint8(frame.at(1)) | CompressedFlag);
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(frame.constData() + 2));
+    stream.avail_in = uInt(bodySize);
+    qsizetype written = 2;
+    do {
+        if (written == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        stream.next_out = reinterpret_cast<Bytef *>(out.data() + written);
+        stream.avail_out = uInt(out.size() - written);
+        if (deflate(&stream, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+            qWarning() << "Frame compression failed";
+            stop();
+            return frame;
+        }
+        written = out.size() - stream.avail_out;
+    } while (stream.avail_out == 0);
+
+    if (written >= 6 && memcmp(out.constData() + written - 4, SyncTail, 4) == 0) {
+        written -= 4;
+    }
+    out.truncate(written);
+
+    m_bytesIn += quint64(frame.size());
+    m_bytesOut += quint64(out.size());
+    return out;
+#else
+    return frame;
+#endif
+}
+
+bool FrameCompressor::decompressFrame(const QByteArray &frame, QByteArray *out)
+{
+    if (!isCompressedFrame(frame)) {
+        *out = frame;
+        return true;
+    }
+#ifdef ROCHAT_HAVE_ZLIB
+    if (!m_streams) {
+        return false;
+    }
+
+    QByteArray input = frame.mid(2);
+    input.append(SyncTail, 4);
+
+    z_stream &stream = m_streams->inflater;
+    stream.next_in = reinterpret_cast<Bytef *>(input.data());
+    stream.avail_in = uInt(input.size());
+
+    QByteArray result;
+    result.resize(2 + input.size() * 4);
+    result[0] = frame.at(0);
+    result[1] = char(quint8(frame.at(1)) & ~CompressedFlag);
+    qsizetype written = 2;
+
+    for (;;) {
+        if (written == result.size()) {
+            if (result.size() >= MaxInflatedBytes) {
+                qWarning() << "Compressed frame inflates past" << MaxInflatedBytes << "bytes";
+                return false;
+            }
+            result.resize(qMin<qsizetype>(result.size() * 2, MaxInflatedBytes));
+        }
+        stream.next_out = reinterpret_cast<Bytef *>(result.data() + written);
+        stream.avail_out = uInt(result.size() - written);
+        const int status = inflate(&stream, Z_SYNC_FLUSH);
+        written = result.size() - stream.avail_out;
+        if (status != Z_OK && status != Z_BUF_ERROR) {
+            qWarning() << "Frame decompression failed:" << status;
+            return false;
+        }
+        // Done once the input is consumed and output space was left over
+        if (stream.avail_out > 0 && (stream.avail_in == 0 || status == Z_BUF_ERROR)) {
+            break;
+        }
+    }
+
+    result.truncate(written);
+    *out = std::move(result);
+    return true;
+#else
+    return false;
+#endif
+}
+
+double FrameCompressor::compressionRatio() const
+{
+    return m_bytesOut == 0 ? 1.0 : double(m_bytesIn) / double(m_bytesOut);
+}
+
+QByteArray FrameCompressor::trainDictionary(const QVector<QByteArray> &samples, int maxSize)
+{
+    static const int lengths[] = {32, 16, 8};
+    constexpr qsizetype MaxTrainingBytes = 1024 * 1024;
+    constexpr int MaxCandidates = 20000;
+
+    struct Candidate {
+        QByteArray text;
+        qint64 score;
+    };
+    QVector<Candidate> candidates;
+
+    for (int length : lengths) {
+        QHash<QByteArray, int> counts;
+        qsizetype consumed = 0;
+        for (const QByteArray &sample : samples) {
+            if (consumed >= MaxTrainingBytes) {
+                break;
+            }
+            consumed += sample.size();
+            for (qsizetype i = 0; i + length <= sample.size(); ++i) {
+                ++counts[sample.mid(i, length)];
+            }
+        }
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            if (it.value() > 1) {
+                candidates.append({it.key(), qint64(it.value() - 1) * length});
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.score > b.score;
+    });
+    if (candidates.size() > MaxCandidates) {
+        candidates.resize(MaxCandidates);
+    }
+
+    QVector<QByteArray> chosen;
+    QByteArray combined;
+    for (const Candidate &candidate : std::as_const(candidates)) {
+        if (combined.size() + candidate.text.size() > maxSize) {
+            continue;
+        }
+        if (combined.contains(candidate.text)) {
+            continue;  // A longer fragment already covers it
+        }
+        chosen.append(candidate.text);
+        combined.append(candidate.text);
+    }
+
+    // Deflate reaches the end of the dictionary with the shortest distances
+    QByteArray dictionary;
+    dictionary.reserve(combined.size());
+    for (auto it = chosen.crbegin(); it != chosen.crend(); ++it) {
+        dictionary.append(*it);
+    }
+    return dictionary;
+}
+
+QByteArray FrameCompressor::defaultDictionary()
+{
+    // Common chat vocabulary and link fragments, used until a dictionary
+    // trained on real traffic is installed
+    return QByteArrayLiteral(
+        "lmaolol xd brb gtg idk tbh imo ngl fr omg wtf thx ty np pls plz "
+        "anyone want to trade? who wants to join my game? add me friend request "
+        "what are you doing i'm going to be back in a minute "
+        "https://www.roblox.com/games/ https://www.roblox.com/users/ "
+        "https://discord.gg/ https://youtube.com/watch?v= https://www. .com/ "
+        "hello hi hey yes no okay ok thanks thank you good game gg wp "
+        "is anyone here? can someone help me? how do i get that? "
+        "the and you that this for with have what your just like not "
+        "CurrentUser message serverId sender content timestamp");
+}
@@ -0,0 +1,66 @@
+#ifndef FRAMECOMPRESSOR_H
+#define FRAMECOMPRESSOR_H
+
+#include <QByteArray>
+#include <QVector>
+#include <memory>
+
+// Optional deflate compression for binary wire frames, negotiated in the
+// hello/welcome exchange. Like permessage-deflate, each direction keeps one
+// deflate stream for the life of the connection, so later frames can refer
+// back to earlier ones. The stream starts from a preset dictionary of
+// typical chat traffic, so even the first short frame compresses.
+//
+// Only the records are compressed. The two-byte frame header stays readable
+// and gets CompressedFlag set. Builds without zlib report
+// isAvailable() == false and never negotiate compression.
+class FrameCompressor
+{
+public:
+    static constexpr quint8 CompressedFlag = 0x01;
+    static constexpr const char *Name = "deflate";
+    static constexpr int MinCompressBytes = 24;             // Smaller frames go out as-is
+    static constexpr int MaxInflatedBytes = 16 * 1024 * 1024;
+
+    FrameCompressor();
+    ~FrameCompressor();
+
+    FrameCompressor(const FrameCompressor &) = delete;
+    FrameCompressor &operator=(const FrameCompressor &) = delete;
+
+    static bool isAvailable();
+
+    // Takes effect on the next start()
+    void setDictionary(const QByteArray &dictionary);
+    bool loadDictionary(const QString &path);
+    const QByteArray &dictionary() const { return m_dictionary; }
+    quint32 dictionaryId() const;
+
+    // Begins fresh streams for a new connection
+    bool start();
+    void stop();
+    bool isActive() const { return m_streams != nullptr; }
+
+    QByteArray compressFrame(const QByteArray &frame);
+    bool decompressFrame(const QByteArray &frame, QByteArray *out);
+    static bool isCompressedFrame(const QByteArray &frame);
+
+    quint64 bytesBeforeCompression() const { return m_bytesIn; }
+    quint64 bytesAfterCompression() const { return m_bytesOut; }
+    double compressionRatio() const;
+
+    // Builds a dictionary from recorded frames: the most common repeated
+    // substrings, most valuable last where deflate reaches them cheapest
+    static QByteArray trainDictionary(const QVector<QByteArray> &samples, int maxSize = 16 * 1024);
+    static QByteArray defaultDictionary();
+
+private:
+    struct Streams;
+
+    QByteArray m_dictionary;
+    std::unique_ptr<Streams> m_streams;
+    quint64 m_bytesIn = 0;
+    quint64 m_bytesOut = 0;
+};
+
+#endif // FRAMECOMPRESSOR_H
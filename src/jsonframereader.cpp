@@ -0,0 +1,400 @@
+#include "jsonframereader.h"
+#include <QTimeZone>
+#include <limits>
+
+namespace {
+
+constexpr int MaxDepth = 32;
+
+struct Cursor {
+    const QChar *p;
+    const QChar *end;
+
+    void skipWhitespace()
+    {
+        while (p < end) {
+            const char16_t c = p->unicode();
+            if (c != u' ' && c != u'\t' && c != u'\n' && c != u'\r') {
+                break;
+            }
+            ++p;
+        }
+    }
+
+    bool consume(char16_t c)
+    {
+        skipWhitespace();
+        if (p < end && p->unicode() == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    bool consumeLiteral(QStringView literal)
+    {
+        if (end - p < literal.size() || QStringView(p, literal.size()) != literal) {
+            return false;
+        }
+        p += literal.size();
+        return true;
+    }
+};
+
+// Called after the opening quote; leaves the cursor past the closing quote
+bool scanString(Cursor &c, QStringView *raw, bool *hasEscapes)
+{
+    const QChar *start = c.p;
+    *hasEscapes = false;
+    while (c.p < c.end) {
+        const char16_t u = c.p->unicode();
+        if (u == u'"') {
+            *raw = QStringView(start, c.p - start);
+            ++c.p;
+            return true;
+        }
+        if (u == u'\\') {
+            if (c.end - c.p < 2) {
+                return false;
+            }
+            *hasEscapes = true;
+            c.p += 2;
+            continue;
+        }
+        ++c.p;
+    }
+    return false;
+}
+
+int hexValue(char16_t c)
+{
+    if (c >= u'0' && c <= u'9') {
+        return c - u'0';
+    }
+    if (c >= u'a' && c <= u'f') {
+        return c - u'a' + 10;
+    }
+    if (c >= u'A' && c <= u'F') {
+        return c - u'A' + 10;
+    }
+    return -1;
+}
+
+bool unescape(QStringView raw, QString *out)
+{
+    out->clear();
+    out->reserve(raw.size());
+    for (qsizetype i = 0; i < raw.size(); ++i) {
+        const QChar ch = raw[i];
+        if (ch != u'\\') {
+            out->append(ch);
+            continue;
+        }
+        if (++i >= raw.size()) {
+            return false;
+        }
+        switch (raw[i].unicode()) {
+        case u'"':  out->append(u'"'); break;
+        case u'\\': out->append(u'\\'); break;
+        case u'/':  out->append(u'/'); break;
+        case u'b':  out->append(u'\b'); break;
+        case u'f':  out->append(u'\f'); break;
+        case u'n':  out->append(u'\n'); break;
+        case u'r':  out->append(u'\r'); break;
+        case u't':  out->append(u'\t'); break;
+        case u'u': {
+            if (raw.size() - i < 5) {
+                return false;
+            }
+            int code = 0;
+            for (int k = 1; k <= 4; ++k) {
+                const int digit = hexValue(raw[i + k].unicode());
+                if (digit < 0) {
+                    return false;
+                }
+                code = (code << 4) | digit;
+            }
+            // Surrogate pairs arrive as two escapes and recombine naturally
+            out->append(QChar(char16_t(code)));
+            i += 4;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool skipValue(Cursor &c, int depth)
+{
+    if (depth > MaxDepth) {
+        return false;
+    }
+
+    c.skipWhitespace();
+    if (c.p >= c.end) {
+        return false;
+    }
+
+    QStringView raw;
+    bool escaped = false;
+    const char16_t first = c.p->unicode();
+
+    if (first == u'"') {
+        ++c.p;
+        return scanString(c, &raw, &escaped);
+    }
+
+    if (first == u'{' || first == u'[') {
+        const char16_t close = first == u'{' ? u'}' : u']';
+        ++c.p;
+        if (c.consume(close)) {
+            return true;
+        }
+        for (;;) {
+            if (first == u'{') {
+                if (!c.consume(u'"') || !scanString(c, &raw, &escaped) || !c.consume(u':')) {
+                    return false;
+                }
+            }
+            if (!skipValue(c, depth + 1)) {
+                return false;
+            }
+            if (c.consume(u',')) {
+                continue;
+            }
+            return c.consume(close);
+        }
+    }
+
+    // Number or literal: runs up to the next delimiter
+    const QChar *start = c.p;
+    while (c.p < c.end) {
+        const char16_t u = c.p->unicode();
+        if (u == u',' || u == u'}' || u == u']' || u == u' ' || u == u'\t' || u == u'\n' || u == u'\r') {
+            break;
+        }
+        ++c.p;
+    }
+    return c.p > start;
+}
+
+// Non-negative integers only, which is all the frames carry
+bool readUnsigned(Cursor &c, quint64 *value)
+{
+    c.skipWhitespace();
+    const QChar *start = c.p;
+    quint64 result = 0;
+    while (c.p < c.end && c.p->unicode() >= u'0' && c.p->unicode() <= u'9') {
+        const quint64 digit = c.p->unicode() - u'0';
+        // Reject rather than wrap, which would corrupt sequence tracking
+        if (result > (std::numeric_limits<quint64>::max() - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+        ++c.p;
+    }
+    if (c.p == start) {
+        return false;
+    }
+    *value = result;
+    return true;
+}
+
+bool readNumber(QStringView text, qsizetype pos, int length, int *value)
+{
+    if (pos + length > text.size()) {
+        return false;
+    }
+    int result = 0;
+    for (int i = 0; i < length; ++i) {
+        const char16_t c = text[pos + i].unicode();
+        if (c < u'0' || c > u'9') {
+            return false;
+        }
+        result = result * 10 + (c - u'0');
+    }
+    *value = result;
+    return true;
+}
+
+} // namespace
+
+bool JsonFrameReader::read(QStringView text, Frame *frame)
+{
+    Cursor c{text.data(), text.data() + text.size()};
+    if (!c.consume(u'{')) {
+        return false;
+    }
+
+    QStringView type;
+    QStringView timestamp;
+    QString escapedType;
+    QString escapedTimestamp;
+
+    if (!c.consume(u'}')) {
+        for (;;) {
+            QStringView key;
+            bool keyEscaped = false;
+            if (!c.consume(u'"') || !scanString(c, &key, &keyEscaped) || !c.consume(u':')) {
+                return false;
+            }
+
+            // Known fields are decoded straight into their destination
+            QString *target = nullptr;
+            QStringView *view = nullptr;
+            QString *viewStorage = nullptr;
+            bool *flag = nullptr;
+            quint64 *number = nullptr;
+            if (!keyEscaped) {
+                if (key == u"type") {
+                    view = &type;
+                    viewStorage = &escapedType;
+                } else if (key == u"timestamp") {
+                    view = &timestamp;
+                    viewStorage = &escapedTimestamp;
+                } else if (key == u"id") {
+                    target = &frame->message.id;
+                } else if (key == u"sender") {
+                    target = &frame->message.sender;
+                } else if (key == u"content") {
+                    target = &frame->message.content;
+                } else if (key == u"serverId") {
+                    target = &frame->message.serverId;
+                } else if (key == u"url") {
+                    target = &frame->url;
+                } else if (key == u"protocol") {
+                    target = &frame->protocol;
+                } else if (key == u"compression") {
+                    target = &frame->compression;
+                } else if (key == u"isMalicious") {
+                    flag = &frame->isMalicious;
+                } else if (key == u"batch") {
+                    flag = &frame->batch;
+                } else if (key == u"seq") {
+                    number = &frame->message.sequence;
+                }
+            }
+
+            c.skipWhitespace();
+            if ((target || view) && c.p < c.end && c.p->unicode() == u'"') {
+                ++c.p;
+                QStringView raw;
+                bool escaped = false;
+                if (!scanString(c, &raw, &escaped)) {
+                    return false;
+                }
+                if (target) {
+                    if (escaped) {
+                        if (!unescape(raw, target)) {
+                            return false;
+                        }
+                    } else {
+                        *target = raw.toString();
+                    }
+                } else if (escaped) {
+                    if (!unescape(raw, viewStorage)) {
+                        return false;
+                    }
+                    *view = *viewStorage;
+                } else {
+                    *view = raw;
+                }
+            } else if (flag && c.consumeLiteral(u"true")) {
+                *flag = true;
+            } else if (flag && c.consumeLiteral(u"false")) {
+                *flag = false;
+            } else if (number && c.p < c.end && c.p->unicode() >= u'0' && c.p->unicode() <= u'9') {
+                if (!readUnsigned(c, number)) {
+                    return false;
+                }
+            } else if (!skipValue(c, 0)) {
+                return false;
+            }
+
+            if (c.consume(u',')) {
+                continue;
+            }
+            if (c.consume(u'}')) {
+                break;
+            }
+            return false;
+        }
+    }
+
+    // One object per frame; anything after it means a malformed frame
+    c.skipWhitespace();
+    if (c.p != c.end) {
+        return false;
+    }
+
+    if (type == u"message") {
+        frame->type = FrameType::Message;
+        frame->message.timestamp = parseIsoTimestamp(timestamp);
+    } else if (type == u"linkValidation") {
+        frame->type = FrameType::LinkValidation;
+    } else if (type == u"welcome") {
+        frame->type = FrameType::Welcome;
+    } else {
+        frame->type = FrameType::Unknown;
+    }
+    return true;
+}
+
+QDateTime JsonFrameReader::parseIsoTimestamp(QStringView text)
+{
+    // Fast path for yyyy-MM-ddTHH:mm:ss[.zzz][Z|+HH:mm|-HH:mm]
+    int year, month, day, hour, minute, second;
+    if (text.size() < 19
+        || !readNumber(text, 0, 4, &year) || text[4] != u'-'
+        || !readNumber(text, 5, 2, &month) || text[7] != u'-'
+        || !readNumber(text, 8, 2, &day) || (text[10] != u'T' && text[10] != u' ')
+        || !readNumber(text, 11, 2, &hour) || text[13] != u':'
+        || !readNumber(text, 14, 2, &minute) || text[16] != u':'
+        || !readNumber(text, 17, 2, &second)) {
+        return text.isEmpty() ? QDateTime() : QDateTime::fromString(text.toString(), Qt::ISODate);
+    }
+
+    qsizetype pos = 19;
+    int msec = 0;
+    if (pos < text.size() && text[pos] == u'.') {
+        ++pos;
+        int digits = 0;
+        while (pos < text.size() && text[pos].unicode() >= u'0' && text[pos].unicode() <= u'9') {
+            if (digits < 3) {
+                msec = msec * 10 + (text[pos].unicode() - u'0');
+            }
+            ++digits;
+            ++pos;
+        }
+        for (int i = digits; i < 3; ++i) {
+            msec *= 10;
+        }
+    }
+
+    const QDate date(year, month, day);
+    const QTime time(hour, minute, second, msec);
+
+    if (pos == text.size()) {
+        return QDateTime(date, time);
+    }
+    if (text[pos] == u'Z' && pos + 1 == text.size()) {
+        return QDateTime(date, time, QTimeZone::utc());
+    }
+    if (text[pos] == u'+' || text[pos] == u'-') {
+        int offsetHours, offsetMinutes = 0;
+        const int sign = text[pos] == u'-' ? -1 : 1;
+        if (readNumber(text, pos + 1, 2, &offsetHours)) {
+            qsizetype minutesPos = pos + 3;
+            if (minutesPos < text.size() && text[minutesPos] == u':') {
+                ++minutesPos;
+            }
+            if (minutesPos == text.size() || readNumber(text, minutesPos, 2, &offsetMinutes)) {
+                return QDateTime(date, time, QTimeZone(sign * (offsetHours * 3600 + offsetMinutes * 60)));
+            }
+        }
+    }
+
+    return QDateTime::fromString(text.toString(), Qt::ISODate);
+}
@@ -0,0 +1,35 @@
+#ifndef JSONFRAMEREADER_H
+#define JSONFRAMEREADER_H
+
+#include <QStringView>
+#include "include/types.h"
+
+// Streaming reader for the inbound JSON frames NetworkClient understands.
+// It walks the frame text once, skips fields it does not know without
+// copying them, and decodes each known string field with a single
+// allocation, instead of building a QJsonDocument and copying out of it.
+class JsonFrameReader
+{
+public:
+    enum class FrameType {
+        Unknown,
+        Message,
+        LinkValidation,
+        Welcome
+    };
+
+    struct Frame {
+        FrameType type = FrameType::Unknown;
+        Message message;            // FrameType::Message
+        QString url;                // FrameType::LinkValidation
+        bool isMalicious = false;
+        QString protocol;           // FrameType::Welcome
+        bool batch = false;         // FrameType::Welcome: server accepts "batch" frames
+        QString compression;        // FrameType::Welcome
+    };
+
+    static bool read(QStringView text, Frame *frame);
+    static QDateTime parseIsoTimestamp(QStringView text);
+};
+
+#endif // JSONFRAMEREADER_H
@@ -0,0 +1,109 @@
+#include "latencyhistogram.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int MaxValueBits = 40;
+constexpr qint64 HalfBuckets = LatencyHistogram::SubBuckets / 2;
+constexpr int BucketCount = int((MaxValueBits - LatencyHistogram::SubBucketBits) * HalfBuckets
+                                + LatencyHistogram::SubBuckets);
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : m_counts(BucketCount, 0)
+{
+}
+
+int LatencyHistogram::bucketFor(qint64 value)
+{
+    value = qBound<qint64>(0, value, MaxValue);
+    if (value < SubBuckets) {
+        return int(value);
+    }
+    // Keep the top SubBucketBits - 1 significant bits below the leading one
+    const int msb = 63 - qCountLeadingZeroBits(quint64(value));
+    const int shift = msb - (SubBucketBits - 1);
+    const qint64 sub = value >> shift;
+    return int(SubBuckets + (shift - 1) * HalfBuckets + (sub - HalfBuckets));
+}
+
+qint64 LatencyHistogram::highestValueIn(int bucket)
+{
+    if (bucket < SubBuckets) {
+        return bucket;
+    }
+    const qint64 offset = bucket - SubBuckets;
+    const int shift = int(offset / HalfBuckets) + 1;
+    const qint64 sub = HalfBuckets + offset % HalfBuckets;
+    return ((sub + 1) << shift) - 1;
+}
+
+int LatencyHistogram::bucketCount()
+{
+    return BucketCount;
+}
+
+void LatencyHistogram::record(qint64 value)
+{
+    record(value, 1);
+}
+
+void LatencyHistogram::record(qint64 value, quint64 count)
+{
+    if (count == 0) {
+        return;
+    }
+    value = qBound<qint64>(0, value, MaxValue);
+    m_counts[size_t(bucketFor(value))] += count;
+    if (m_count == 0 || value < m_min) {
+        m_min = value;
+    }
+    m_max = qMax(m_max, value);
+    m_sum += value * qint64(count);
+    m_count += count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    if (other.m_count == 0) {
+        return;
+    }
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_min = m_count ? qMin(m_min, other.m_min) : other.m_min;
+    m_max = qMax(m_max, other.m_max);
+    m_sum += other.m_sum;
+    m_count += other.m_count;
+}
+
+void LatencyHistogram::reset()
+{
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+qint64 LatencyHistogram::valueAtPercentile(double percentile) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    if (percentile >= 100.0) {
+        return m_max;
+    }
+    const quint64 target = qMax<quint64>(1, quint64(std::ceil(percentile / 100.0 * double(m_count))));
+    quint64 seen = 0;
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+        seen += m_counts[i];
+        if (seen >= target) {
+            return qMin(highestValueIn(int(i)), m_max);
+        }
+    }
+    return m_max;
+}
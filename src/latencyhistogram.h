@@ -0,0 +1,48 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <vector>
+
+// Fixed-size log-linear histogram in the style of HdrHistogram. Values below
+// SubBuckets are counted exactly; above that each power of two is split into
+// SubBuckets / 2 linear buckets, so any recorded value is reported within
+// 1/64 (~1.6%) of its true value. Memory is constant whatever the range.
+// Values are unitless; callers pick the unit (the load generator uses
+// microseconds). Not thread-safe.
+class LatencyHistogram
+{
+public:
+    static constexpr int SubBucketBits = 7;
+    static constexpr qint64 SubBuckets = qint64(1) << SubBucketBits;
+    static constexpr qint64 MaxValue = (qint64(1) << 40) - 1;  // Larger values are clamped
+
+    LatencyHistogram();
+
+    void record(qint64 value);
+    void record(qint64 value, quint64 count);
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    quint64 count() const { return m_count; }
+    qint64 min() const { return m_count ? m_min : 0; }
+    qint64 max() const { return m_max; }
+    double mean() const { return m_count ? double(m_sum) / double(m_count) : 0.0; }
+
+    // Smallest value v such that at least `percentile`% of recorded values
+    // are <= v, to the histogram's precision. 100 returns max().
+    qint64 valueAtPercentile(double percentile) const;
+
+    static int bucketCount();
+    static int bucketFor(qint64 value);
+    static qint64 highestValueIn(int bucket);
+
+private:
+    std::vector<quint64> m_counts;
+    quint64 m_count = 0;
+    qint64 m_min = 0;
+    qint64 m_max = 0;
+    qint64 m_sum = 0;
+};
+
+#endif // LATENCYHISTOGRAM_H
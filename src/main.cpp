@@ -1,8 +1,8 @@
 #include <QApplication>
 #include <QSplashScreen>
 #include <QPixmap>
-#include <QDebug>
 #include "mainwindow.h"
+#include "diagnostics/logger.h"
 #include "include/constants.h"
 
 int main(int argc, char *argv[])
@@ -18,11 +18,22 @@ int main(int argc, char *argv[])
     app.setAttribute(Qt::AA_EnableHighDpiScaling);
     app.setAttribute(Qt::AA_UseHighDpiPixmaps);
 
-    qDebug() << "Starting" << Constants::APP_NAME << "v" << Constants::APP_VERSION;
+    // e.g. ROCHAT_LOG="*=info,network=debug"
+    Logger::configure(qEnvironmentVariable("ROCHAT_LOG"));
+    Logger::start(Constants::LOG_PATH);
+    Logger::installMessageHandler();
 
-    // Create and show main window
-    MainWindow window;
-    window.show();
+    LOG_INFO(LogCategory::General, "Starting %1 v%2", Constants::APP_NAME, Constants::APP_VERSION);
 
-    return app.exec();
+    int result = 0;
+    {
+        // Create and show main window
+        MainWindow window;
+        window.show();
+
+        result = app.exec();
+    }
+
+    Logger::stop();
+    return result;
 }
@@ -7,13 +7,22 @@
 #include <QSystemTrayIcon>
 #include <QSettings>
 #include <QMessageBox>
+#include <QFileInfo>
+#include <QStatusBar>
 #include <QDebug>
 #include "include/constants.h"
+#include "storage/outbox.h"
+#include "diagnostics/metricspanel.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , m_tabWidget(new QTabWidget(this))
-    , m_networkClient(std::make_unique<NetworkClient>(this))
+    , m_mediaCache(std::make_unique<MediaCache>(Constants::MEDIA_CACHE_PATH, this))
+    , m_connectionManager(std::make_unique<ConnectionManager>(this))
+    , m_moderationPipeline(std::make_unique<ModerationPipeline>(this))
+    , m_historyStore(std::make_unique<HistoryStore>(Constants::HISTORY_PATH, this))
+    , m_thumbnailPool(std::make_unique<ThumbnailPool>(m_mediaCache.get(), this))
+    , m_metricsExporter(std::make_unique<MetricsExporter>(Constants::LOG_PATH, this))
     , m_trayIcon(new QSystemTrayIcon(this))
 {
     setWindowTitle(QString("%1 v%2").arg(Constants::APP_NAME, Constants::APP_VERSION));
@@ -22,6 +31,10 @@ MainWindow::MainWindow(QWidget *parent)
     // Set default window size
     setGeometry(100, 100, 1000, 600);
 
+    if (!m_mediaCache->open()) {
+        qWarning() << "Media cache unavailable, images will not be shown";
+    }
+
     setupUI();
     setupMenuBar();
     setupSystemTray();
@@ -37,8 +50,8 @@ MainWindow::~MainWindow()
 {
     saveWindowState();
     saveServers();
-    if (m_networkClient) {
-        m_networkClient->disconnect();
+    if (m_connectionManager) {
+        m_connectionManager->disconnectAll();
     }
 }
 
@@ -77,6 +90,10 @@ void MainWindow::setupMenuBar()
     // Help menu
     QMenu *helpMenu = menuBar()->addMenu(tr("&Help"));
     
+    QAction *metricsAction = helpMenu->addAction(tr("&Metrics"));
+    metricsAction->setShortcut(QKeySequence(tr("Ctrl+Shift+M")));
+    connect(metricsAction, &QAction::triggered, this, &MainWindow::onShowMetrics);
+    
     QAction *aboutAction = helpMenu->addAction(tr("&About"));
     connect(aboutAction, &QAction::triggered, this, &MainWindow::onShowAbout);
 }
@@ -111,22 +128,57 @@ void MainWindow::connectSignals()
     connect(m_tabWidget, QOverload<int>::of(&QTabWidget::currentChanged),
             this, &MainWindow::onTabChanged);
     
-    connect(m_networkClient.get(), &NetworkClient::connected,
+    m_connectionManager->setConfig(m_networkConfig);
+    m_connectionManager->setMediaCache(m_mediaCache.get());
+    
+    connect(m_connectionManager.get(), &ConnectionManager::connected,
             this, &MainWindow::onServerConnected);
     
-    connect(m_networkClient.get(), &NetworkClient::disconnected,
+    connect(m_connectionManager.get(), &ConnectionManager::disconnected,
             this, &MainWindow::onServerDisconnected);
     
-    connect(m_networkClient.get(), &NetworkClient::messageReceived,
+    // Incoming messages from every connection are moderated off the UI
+    // thread before display; duplicates are dropped before that
+    connect(m_connectionManager.get(), &ConnectionManager::messageReceived,
+            this, [this](const Message &message) {
+        if (m_duplicateFilter.accept(message)) {
+            m_moderationPipeline->submit(message);
+        }
+    });
+    
+    connect(m_moderationPipeline.get(), &ModerationPipeline::messageReady,
             this, &MainWindow::onMessageReceived);
+    
+    connect(m_connectionManager.get(), &ConnectionManager::imageReceived,
+            this, &MainWindow::onImageReceived);
+    connect(m_connectionManager.get(), &ConnectionManager::imageTransferFailed,
+            this, [this](const QString &serverId, const QString &error) {
+        qWarning() << "Image transfer failed on" << serverId << error;
+        statusBar()->showMessage(tr("Image transfer failed: %1").arg(error), 5000);
+    });
 }
 
 void MainWindow::createChatTab(const Server &server)
 {
     auto chatWidget = std::make_unique<ChatWidget>(server, this);
+    chatWidget->setHistorySize(m_chatConfig.maxHistorySize);
+    chatWidget->setRefreshInterval(qRound(m_chatConfig.messageRefreshRate * 1000.0f));
+    chatWidget->setHistoryStore(m_historyStore.get());
+    chatWidget->setThumbnailPool(m_thumbnailPool.get());
+    connect(chatWidget.get(), &ChatWidget::messageSent, m_historyStore.get(), &HistoryStore::append);
+    connect(chatWidget.get(), &ChatWidget::messageSent, m_connectionManager.get(), &ConnectionManager::sendMessage);
+    // The server echoes our own messages back; they are already displayed
+    connect(chatWidget.get(), &ChatWidget::messageSent, this, [this](const Message &message) {
+        m_duplicateFilter.remember(message);
+    });
+    connect(chatWidget.get(), &ChatWidget::imageSelected, this, [this, serverId = server.id](const QString &filePath) {
+        sendImage(serverId, filePath);
+    });
     int index = m_tabWidget->addTab(chatWidget.get(), server.name);
     m_chatWidgets[server.id] = std::move(chatWidget);
     m_tabWidget->setCurrentIndex(index);
+    
+    m_connectionManager->addServer(server);
 }
 
 void MainWindow::onAddServerTab()
@@ -146,6 +198,8 @@ void MainWindow::onRemoveServerTab(int index)
     }
     
     if (!serverId.isEmpty()) {
+        m_connectionManager->removeServer(serverId);
+        m_duplicateFilter.forget(serverId);
         m_chatWidgets.remove(serverId);
         m_servers.remove(serverId);
         m_tabWidget->removeTab(index);
@@ -173,8 +227,47 @@ void MainWindow::onServerDisconnected(const QString &serverId)
     }
 }
 
+void MainWindow::sendImage(const QString &serverId, const QString &filePath)
+{
+    QString error;
+    if (!m_connectionManager->sendImage(serverId, "CurrentUser", filePath, &error)) {
+        QMessageBox::warning(this, tr("Image Not Sent"), error);
+        return;
+    }
+    
+    // Our own copy is shown from the cache like any received image
+    const QString key = m_mediaCache->insertFile(filePath, MediaCache::Kind::Image);
+    if (key.isEmpty()) {
+        return;
+    }
+    const Message message = imageMessage(serverId, "CurrentUser", key, QFileInfo(filePath).fileName());
+    m_historyStore->append(message);
+    if (m_chatWidgets.contains(serverId)) {
+        m_chatWidgets[serverId]->displayMessage(message);
+    }
+}
+
+Message MainWindow::imageMessage(const QString &serverId, const QString &sender, const QString &mediaKey,
+                                 const QString &fileName)
+{
+    Message message(sender, tr("[Image: %1]").arg(fileName));
+    message.id = Outbox::createMessageId();
+    message.serverId = serverId;
+    message.containsImage = true;
+    message.imageData = mediaKey;
+    return message;
+}
+
+void MainWindow::onImageReceived(const QString &serverId, const QString &sender, const QString &mediaKey)
+{
+    onMessageReceived(imageMessage(serverId, sender, mediaKey, mediaKey.left(12)));
+}
+
 void MainWindow::onMessageReceived(const Message &message)
 {
+    // Stored before display so a tab paging through history sees it
+    m_historyStore->append(message);
+    
     if (m_chatWidgets.contains(message.serverId)) {
         m_chatWidgets[message.serverId]->displayMessage(message);
     }
@@ -193,6 +286,16 @@ void MainWindow::onShowAbout()
             .arg(Constants::APP_NAME, Constants::APP_VERSION, Constants::APP_AUTHOR));
 }
 
+void MainWindow::onShowMetrics()
+{
+    if (!m_metricsPanel) {
+        m_metricsPanel = new MetricsPanel(this);
+    }
+    m_metricsPanel->show();
+    m_metricsPanel->raise();
+    m_metricsPanel->activateWindow();
+}
+
 void MainWindow::onSystemTrayActivated(QSystemTrayIcon::ActivationReason reason)
 {
     if (reason == QSystemTrayIcon::DoubleClick) {
@@ -6,9 +6,17 @@
 #include <QMap>
 #include <memory>
 #include "chatwidget.h"
-#include "networkclient.h"
+#include "connectionmanager.h"
+#include "moderation/moderationpipeline.h"
+#include "storage/historystore.h"
+#include "media/mediacache.h"
+#include "media/thumbnailpool.h"
+#include "duplicatefilter.h"
+#include "diagnostics/metricsexporter.h"
 #include "include/types.h"
 
+class MetricsPanel;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -17,6 +25,8 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow() override;
 
+    const DuplicateFilter &duplicateFilter() const { return m_duplicateFilter; }
+
 protected:
     void closeEvent(QCloseEvent *event) override;
 
@@ -27,8 +37,10 @@ private slots:
     void onServerConnected(const QString &serverId);
     void onServerDisconnected(const QString &serverId);
     void onMessageReceived(const Message &message);
+    void onImageReceived(const QString &serverId, const QString &sender, const QString &mediaKey);
     void onShowSettings();
     void onShowAbout();
+    void onShowMetrics();
     void onSystemTrayActivated(QSystemTrayIcon::ActivationReason reason);
 
 private:
@@ -36,6 +48,9 @@ private:
     void setupMenuBar();
     void setupSystemTray();
     void createChatTab(const Server &server);
+    void sendImage(const QString &serverId, const QString &filePath);
+    static Message imageMessage(const QString &serverId, const QString &sender, const QString &mediaKey,
+                                const QString &fileName);
     void connectSignals();
     void loadServers();
     void saveServers();
@@ -45,7 +60,14 @@ private:
     QTabWidget *m_tabWidget;
     QMap<QString, std::unique_ptr<ChatWidget>> m_chatWidgets;
     QMap<QString, Server> m_servers;
-    std::unique_ptr<NetworkClient> m_networkClient;
+    std::unique_ptr<MediaCache> m_mediaCache;
+    std::unique_ptr<ConnectionManager> m_connectionManager;
+    std::unique_ptr<ModerationPipeline> m_moderationPipeline;
+    std::unique_ptr<HistoryStore> m_historyStore;
+    std::unique_ptr<ThumbnailPool> m_thumbnailPool;
+    DuplicateFilter m_duplicateFilter;
+    std::unique_ptr<MetricsExporter> m_metricsExporter;
+    MetricsPanel *m_metricsPanel = nullptr;     // Created on first use
     QSystemTrayIcon *m_trayIcon;
     
     ChatConfig m_chatConfig;
@@ -0,0 +1,357 @@
+#include "imageprobe.h"
+#include "include/constants.h"
+#include <QBuffer>
+#include <QFile>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+// Sequential reads over a QIODevice that remember whether the data ran out
+struct Reader {
+    QIODevice *device;
+    bool truncated = false;
+
+    bool read(char *out, qint64 size)
+    {
+        if (truncated || device->read(out, size) != size) {
+            truncated = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool skip(qint64 size)
+    {
+        if (truncated) {
+            return false;
+        }
+        if (!device->isSequential()) {
+            if (device->pos() + size > device->size()) {
+                truncated = true;
+                return false;
+            }
+            return device->seek(device->pos() + size);
+        }
+        if (device->skip(size) != size) {
+            truncated = true;
+            return false;
+        }
+        return true;
+    }
+
+    quint8 u8()
+    {
+        char c = 0;
+        read(&c, 1);
+        return quint8(c);
+    }
+
+    quint16 u16be()
+    {
+        uchar b[2] = {};
+        read(reinterpret_cast<char *>(b), 2);
+        return quint16(b[0] << 8 | b[1]);
+    }
+
+    quint16 u16le()
+    {
+        uchar b[2] = {};
+        read(reinterpret_cast<char *>(b), 2);
+        return quint16(b[1] << 8 | b[0]);
+    }
+
+    quint32 u32be()
+    {
+        uchar b[4] = {};
+        read(reinterpret_cast<char *>(b), 4);
+        return quint32(b[0]) << 24 | quint32(b[1]) << 16 | quint32(b[2]) << 8 | b[3];
+    }
+};
+
+ImageProbe::Info failure(ImageProbe::Format format, ImageProbe::Status status, const QString &error)
+{
+    ImageProbe::Info info;
+    info.format = format;
+    info.status = status;
+    info.error = error;
+    return info;
+}
+
+ImageProbe::Info truncated(ImageProbe::Format format)
+{
+    return failure(format, ImageProbe::Status::Incomplete, QStringLiteral("Header is truncated"));
+}
+
+} // namespace
+
+ImageProbe::Info ImageProbe::probe(const QByteArray &data)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    return probe(&buffer);
+}
+
+ImageProbe::Info ImageProbe::probeFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return failure(Format::Unknown, Status::Malformed, file.errorString());
+    }
+    if (file.size() > maxFileBytes()) {
+        return failure(Format::Unknown, Status::TooLarge,
+                       QStringLiteral("File is over %1 MB").arg(Constants::MAX_IMAGE_SIZE_MB));
+    }
+
+    Info info = probe(&file);
+    // A whole file that ends early is broken, not incomplete
+    if (info.status == Status::Incomplete) {
+        info.status = Status::Malformed;
+    }
+    return info;
+}
+
+ImageProbe::Info ImageProbe::probe(QIODevice *device)
+{
+    const QByteArray magic = device->peek(8);
+    if (magic.startsWith("\x89PNG\r\n\x1a\n")) {
+        return checkLimits(probePng(device));
+    }
+    if (magic.startsWith("\xFF\xD8\xFF")) {
+        return checkLimits(probeJpeg(device));
+    }
+    if (magic.startsWith("GIF87a") || magic.startsWith("GIF89a")) {
+        return checkLimits(probeGif(device));
+    }
+    if (magic.size() < 8) {
+        return truncated(Format::Unknown);
+    }
+    return failure(Format::Unknown, Status::Unsupported, QStringLiteral("Not a PNG, JPEG or GIF image"));
+}
+
+qint64 ImageProbe::maxFileBytes()
+{
+    return qint64(Constants::MAX_IMAGE_SIZE_MB) * 1024 * 1024;
+}
+
+qint64 ImageProbe::maxPixels()
+{
+    return qint64(Constants::MAX_IMAGE_DIMENSION) * Constants::MAX_IMAGE_DIMENSION;
+}
+
+QString ImageProbe::formatName(Format format)
+{
+    switch (format) {
+    case Format::Png:
+        return QStringLiteral("PNG");
+    case Format::Jpeg:
+        return QStringLiteral("JPEG");
+    case Format::Gif:
+        return QStringLiteral("GIF");
+    case Format::Unknown:
+        break;
+    }
+    return QStringLiteral("unknown");
+}
+
+ImageProbe::Info ImageProbe::probePng(QIODevice *device)
+{
+    Reader reader{device};
+    reader.skip(8);
+
+    // IHDR must come first
+    const quint32 headerLength = reader.u32be();
+    char type[4] = {};
+    reader.read(type, 4);
+    if (reader.truncated) {
+        return truncated(Format::Png);
+    }
+    if (headerLength != 13 || memcmp(type, "IHDR", 4) != 0) {
+        return failure(Format::Png, Status::Malformed, QStringLiteral("Missing IHDR"));
+    }
+
+    Info info;
+    info.format = Format::Png;
+    info.width = int(qMin<quint32>(reader.u32be(), INT_MAX));
+    info.height = int(qMin<quint32>(reader.u32be(), INT_MAX));
+    info.frameCount = 1;
+    reader.skip(5 + 4);  // Depth, colour type, compression, filter, interlace; CRC
+
+    // An animation control chunk, if any, sits between IHDR and the first IDAT
+    while (!reader.truncated) {
+        const quint32 length = reader.u32be();
+        reader.read(type, 4);
+        if (reader.truncated) {
+            break;
+        }
+        if (memcmp(type, "IDAT", 4) == 0 || memcmp(type, "IEND", 4) == 0) {
+            info.status = Status::Ok;
+            return info;
+        }
+        if (memcmp(type, "acTL", 4) == 0 && length >= 8) {
+            info.frameCount = int(qMin<quint32>(reader.u32be(), INT_MAX));
+            reader.skip(qint64(length));  // Rest of the chunk and its CRC
+        } else {
+            reader.skip(qint64(length) + 4);
+        }
+    }
+
+    // Dimensions are known, which is enough to judge a partial download
+    info.status = Status::Incomplete;
+    info.error = QStringLiteral("Header is truncated");
+    return info;
+}
+
+ImageProbe::Info ImageProbe::probeJpeg(QIODevice *device)
+{
+    Reader reader{device};
+    reader.skip(2);
+
+    for (;;) {
+        quint8 marker = reader.u8();
+        if (marker != 0xFF) {
+            return reader.truncated ? truncated(Format::Jpeg)
+                                    : failure(Format::Jpeg, Status::Malformed, QStringLiteral("Bad marker"));
+        }
+        while (marker == 0xFF && !reader.truncated) {
+            marker = reader.u8();   // Fill bytes
+        }
+        if (reader.truncated) {
+            return truncated(Format::Jpeg);
+        }
+
+        // Markers without a length
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) {
+            return failure(Format::Jpeg, Status::Malformed, QStringLiteral("No frame header before scan data"));
+        }
+
+        const quint16 length = reader.u16be();
+        if (reader.truncated) {
+            return truncated(Format::Jpeg);
+        }
+        if (length < 2) {
+            return failure(Format::Jpeg, Status::Malformed, QStringLiteral("Bad segment length"));
+        }
+
+        // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        const bool startOfFrame = marker >= 0xC0 && marker <= 0xCF
+                                  && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (startOfFrame) {
+            reader.u8();  // Precision
+            Info info;
+            info.format = Format::Jpeg;
+            info.height = reader.u16be();
+            info.width = reader.u16be();
+            info.frameCount = 1;
+            if (reader.truncated) {
+                return truncated(Format::Jpeg);
+            }
+            if (info.width == 0 || info.height == 0) {
+                // Height 0 defers to a DNL marker after the scan; nothing we can bound
+                return failure(Format::Jpeg, Status::Unsupported, QStringLiteral("Deferred image height"));
+            }
+            info.status = Status::Ok;
+            return info;
+        }
+        reader.skip(length - 2);
+    }
+}
+
+ImageProbe::Info ImageProbe::probeGif(QIODevice *device)
+{
+    Reader reader{device};
+    reader.skip(6);
+
+    Info info;
+    info.format = Format::Gif;
+    info.width = reader.u16le();
+    info.height = reader.u16le();
+    const quint8 flags = reader.u8();
+    reader.skip(2);  // Background colour, aspect ratio
+    if (flags & 0x80) {
+        reader.skip(3 << ((flags & 0x07) + 1));
+    }
+
+    auto skipSubBlocks = [&reader]() {
+        for (quint8 size = reader.u8(); size != 0 && !reader.truncated; size = reader.u8()) {
+            reader.skip(size);
+        }
+    };
+
+    while (!reader.truncated) {
+        const quint8 block = reader.u8();
+        if (reader.truncated) {
+            break;
+        }
+        switch (block) {
+        case 0x2C: {
+            reader.skip(4);  // Frame position
+            const int frameWidth = reader.u16le();
+            const int frameHeight = reader.u16le();
+            const quint8 frameFlags = reader.u8();
+            // Frames are clipped to the canvas, but oversized ones still get allocated
+            if (frameWidth > info.width || frameHeight > info.height) {
+                info.width = qMax(info.width, frameWidth);
+                info.height = qMax(info.height, frameHeight);
+            }
+            if (frameFlags & 0x80) {
+                reader.skip(3 << ((frameFlags & 0x07) + 1));
+            }
+            reader.u8();  // LZW minimum code size
+            skipSubBlocks();
+            if (++info.frameCount > MaxFrames) {
+                info.status = Status::Incomplete;   // Stop reading; checkLimits rejects it
+                return info;
+            }
+            break;
+        }
+        case 0x21:
+            reader.u8();  // Extension label
+            skipSubBlocks();
+            break;
+        case 0x3B:
+            info.status = info.frameCount > 0 ? Status::Ok : Status::Malformed;
+            if (info.frameCount == 0) {
+                info.error = QStringLiteral("No frames");
+            }
+            return info;
+        default:
+            return failure(Format::Gif, Status::Malformed, QStringLiteral("Unknown block"));
+        }
+    }
+
+    // The frames seen so far still count towards the limits
+    info.status = Status::Incomplete;
+    info.error = QStringLiteral("Data ends before the trailer");
+    return info;
+}
+
+ImageProbe::Info ImageProbe::checkLimits(Info info)
+{
+    if (info.status != Status::Ok && info.status != Status::Incomplete) {
+        return info;
+    }
+
+    const qint64 pixels = qint64(info.width) * info.height;
+    if (info.width > Constants::MAX_IMAGE_DIMENSION || info.height > Constants::MAX_IMAGE_DIMENSION) {
+        info.status = Status::TooLarge;
+        info.error = QStringLiteral("%1x%2 is over the %3 pixel limit")
+                         .arg(info.width).arg(info.height).arg(Constants::MAX_IMAGE_DIMENSION);
+    } else if (info.frameCount > MaxFrames) {
+        info.status = Status::TooLarge;
+        info.error = QStringLiteral("More than %1 frames").arg(MaxFrames);
+    } else if (pixels * qMax(1, info.frameCount) > 4 * maxPixels()) {
+        // Many large frames add up even when each one is allowed
+        info.status = Status::TooLarge;
+        info.error = QStringLiteral("%1 frames of %2x%3 decode too large")
+                         .arg(info.frameCount).arg(info.width).arg(info.height);
+    } else if (info.status == Status::Ok && pixels == 0) {
+        info.status = Status::Malformed;
+        info.error = QStringLiteral("Zero-sized image");
+    }
+    return info;
+}
@@ -0,0 +1,64 @@
+#ifndef IMAGEPROBE_H
+#define IMAGEPROBE_H
+
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+// Reads just enough of a PNG, JPEG or GIF to learn its dimensions and frame
+// count, without decoding any pixels. Used to turn away decompression bombs
+// (a few KB on the wire that inflate to gigabytes) before anything decodes
+// them, and to size placeholders before the thumbnail exists.
+//
+// Field lengths in the headers are used to seek over everything else, so a
+// JPEG or PNG probe touches a few hundred bytes. Counting GIF frames walks
+// the block chain, which still only reads one length byte per 255.
+class ImageProbe
+{
+public:
+    enum class Format {
+        Unknown,
+        Png,
+        Jpeg,
+        Gif
+    };
+
+    enum class Status {
+        Ok,
+        Incomplete,     // Data ended before the header did; probe again with more
+        Unsupported,
+        Malformed,
+        TooLarge        // Dimensions, frame count or file size over the limits
+    };
+
+    struct Info {
+        Status status = Status::Malformed;
+        Format format = Format::Unknown;
+        int width = 0;
+        int height = 0;
+        int frameCount = 0;
+        QString error;
+
+        bool isOk() const { return status == Status::Ok; }
+    };
+
+    static constexpr int MaxFrames = 1000;
+
+    // Probes the start of an image, such as its first transfer chunk
+    static Info probe(const QByteArray &data);
+    static Info probe(QIODevice *device);
+    static Info probeFile(const QString &path);
+
+    static qint64 maxFileBytes();
+    static qint64 maxPixels();
+    static QString formatName(Format format);
+
+private:
+    static Info probePng(QIODevice *device);
+    static Info probeJpeg(QIODevice *device);
+    static Info probeGif(QIODevice *device);
+    static Info checkLimits(Info info);
+};
+
+#endif // IMAGEPROBE_H
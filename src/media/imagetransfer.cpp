@@ -0,0 +1,442 @@
+#include "imagetransfer.h"
+#include "imageprobe.h"
+#include "mediacache.h"
+#include "include/constants.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QUuid>
+#include <QDebug>
+
+namespace {
+
+constexpr qint64 MaxImageBytes = qint64(Constants::MAX_IMAGE_SIZE_MB) * 1024 * 1024;
+constexpr qint64 StalePartAgeMs = 24 * 3600 * 1000LL;
+
+QByteArray sha256(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+// Transfer ids name files in the spool, so only accept plain tokens
+bool isSafeId(const QString &id)
+{
+    static const QRegularExpression pattern(QStringLiteral("^[A-Za-z0-9_-]{1,64}$"));
+    return pattern.match(id).hasMatch();
+}
+
+} // namespace
+
+ImageTransfer::ImageTransfer(const QString &spoolDirectory, QObject *parent)
+    : QObject(parent)
+    , m_spoolDirectory(spoolDirectory)
+{
+    if (!QDir().mkpath(m_spoolDirectory)) {
+        qWarning() << "Cannot create image spool directory" << m_spoolDirectory;
+    }
+    purgeStaleParts();
+}
+
+ImageTransfer::~ImageTransfer() = default;
+
+QString ImageTransfer::startUpload(const QString &serverId, const QString &sender, const QString &path,
+                                   QString *error)
+{
+    auto upload = std::make_unique<Upload>();
+    upload->file.setFileName(path);
+    if (!upload->file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = tr("Cannot open %1").arg(QFileInfo(path).fileName());
+        }
+        return QString();
+    }
+
+    const qint64 size = upload->file.size();
+    if (size <= 0 || size > MaxImageBytes) {
+        if (error) {
+            *error = tr("Images must be between 1 byte and %1 MB").arg(Constants::MAX_IMAGE_SIZE_MB);
+        }
+        return QString();
+    }
+    const ImageProbe::Info info = ImageProbe::probe(&upload->file);
+    if (!info.isOk()) {
+        if (error) {
+            *error = info.status == ImageProbe::Status::Incomplete ? tr("The image file is damaged") : info.error;
+        }
+        return QString();
+    }
+
+    WireProtocol::ImageBegin &begin = upload->begin;
+    begin.transferId = QUuid::createUuid().toString(QUuid::Id128);
+    begin.serverId = serverId;
+    begin.sender = sender;
+    begin.fileName = QFileInfo(path).fileName();
+    begin.totalSize = quint64(size);
+    begin.chunkSize = ChunkSize;
+    begin.chunkCount = quint32((size + ChunkSize - 1) / ChunkSize);
+    begin.sha256 = hashFile(&upload->file);
+
+    const QString transferId = begin.transferId;
+    qDebug() << "Queued image upload" << transferId << begin.fileName << size << "bytes in"
+             << begin.chunkCount << "chunks";
+    m_uploads.emplace(transferId, std::move(upload));
+    return transferId;
+}
+
+void ImageTransfer::cancelUpload(const QString &transferId)
+{
+    m_uploads.erase(transferId);
+}
+
+QVector<WireProtocol::ImageBegin> ImageTransfer::pendingBegins() const
+{
+    QVector<WireProtocol::ImageBegin> begins;
+    for (const auto &entry : m_uploads) {
+        if (!entry.second->accepted) {
+            begins.append(entry.second->begin);
+        }
+    }
+    return begins;
+}
+
+bool ImageTransfer::hasChunkReady() const
+{
+    for (const auto &entry : m_uploads) {
+        const Upload &upload = *entry.second;
+        if (upload.accepted && upload.nextToSend < upload.begin.chunkCount
+            && upload.nextToSend - upload.acked < MaxUnackedChunks) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ImageTransfer::nextChunk(WireProtocol::ImageChunk *chunk)
+{
+    if (m_uploads.empty()) {
+        return false;
+    }
+
+    // Start after the upload that sent last, so concurrent images share the link
+    auto it = m_uploads.upper_bound(m_lastChunkFrom);
+    for (size_t visited = 0; visited < m_uploads.size(); ++visited, ++it) {
+        if (it == m_uploads.end()) {
+            it = m_uploads.begin();
+        }
+        Upload &upload = *it->second;
+        if (!upload.accepted || upload.nextToSend >= upload.begin.chunkCount
+            || upload.nextToSend - upload.acked >= MaxUnackedChunks) {
+            continue;
+        }
+
+        if (!upload.file.seek(qint64(upload.nextToSend) * upload.begin.chunkSize)) {
+            const QString transferId = it->first;
+            const QString serverId = upload.begin.serverId;
+            m_uploads.erase(it);
+            emit transferFailed(transferId, serverId, tr("Image file became unreadable"));
+            return false;
+        }
+        chunk->transferId = it->first;
+        chunk->index = upload.nextToSend;
+        chunk->data = upload.file.read(upload.begin.chunkSize);
+        chunk->sha256 = sha256(chunk->data);
+        ++upload.nextToSend;
+        m_lastChunkFrom = it->first;
+        return true;
+    }
+    return false;
+}
+
+void ImageTransfer::onAck(const WireProtocol::ImageAck &ack)
+{
+    auto it = m_uploads.find(ack.transferId);
+    if (it == m_uploads.end()) {
+        return;
+    }
+    Upload &upload = *it->second;
+    const QString serverId = upload.begin.serverId;
+
+    if (ack.status == WireProtocol::AckStatus::Rejected || ack.nextIndex > upload.begin.chunkCount) {
+        m_uploads.erase(it);
+        emit transferFailed(ack.transferId, serverId, tr("The server rejected the image"));
+        return;
+    }
+
+    if (!upload.accepted || ack.status == WireProtocol::AckStatus::Resend) {
+        // Resume from wherever the receiver's file ends
+        upload.accepted = true;
+        upload.nextToSend = ack.nextIndex;
+        upload.acked = ack.nextIndex;
+    } else {
+        upload.acked = qMax(upload.acked, ack.nextIndex);
+    }
+
+    const qint64 total = qint64(upload.begin.totalSize);
+    emit uploadProgress(ack.transferId, serverId, qMin(total, qint64(upload.acked) * upload.begin.chunkSize), total);
+
+    if (upload.acked == upload.begin.chunkCount) {
+        qDebug() << "Image upload" << ack.transferId << "complete";
+        m_uploads.erase(it);
+        emit uploadFinished(ack.transferId, serverId);
+    }
+}
+
+bool ImageTransfer::onBegin(const WireProtocol::ImageBegin &begin, WireProtocol::ImageAck *ack)
+{
+    ack->transferId = begin.transferId;
+    if (!isValidBegin(begin)) {
+        qWarning() << "Rejecting image transfer" << begin.transferId << "from" << begin.sender;
+        ack->status = WireProtocol::AckStatus::Rejected;
+        return isSafeId(begin.transferId);
+    }
+
+    // Already have this image: skip the transfer. Either a begin repeated
+    // after a reconnect, or the same picture posted again.
+    if (isStored(begin)) {
+        m_downloads.erase(begin.transferId);
+        QFile::remove(partPath(begin.transferId));
+        ack->nextIndex = begin.chunkCount;
+        if (!m_completed.contains(begin.transferId)) {
+            if (m_completed.size() >= MaxRememberedTransfers) {
+                m_completed.clear();
+            }
+            m_completed.insert(begin.transferId);
+            emit imageReceived(begin.serverId, begin.sender, mediaKey(begin));
+        }
+        return true;
+    }
+
+    auto it = m_downloads.find(begin.transferId);
+    if (it == m_downloads.end()) {
+        if (static_cast<int>(m_downloads.size()) >= MaxIncoming) {
+            ack->status = WireProtocol::AckStatus::Rejected;
+            return true;
+        }
+        auto download = std::make_unique<Download>();
+        download->part.setFileName(partPath(begin.transferId));
+        if (!download->part.open(QIODevice::ReadWrite)) {
+            qWarning() << "Cannot write" << download->part.fileName();
+            ack->status = WireProtocol::AckStatus::Rejected;
+            return true;
+        }
+        it = m_downloads.emplace(begin.transferId, std::move(download)).first;
+    }
+
+    // Keep only whole chunks from an earlier attempt
+    Download &download = *it->second;
+    download.begin = begin;
+    download.nextIndex = quint32(qMin<qint64>(download.part.size() / begin.chunkSize, begin.chunkCount));
+    download.part.resize(qint64(download.nextIndex) * begin.chunkSize);
+    if (download.nextIndex > 0) {
+        qDebug() << "Resuming image" << begin.transferId << "at chunk" << download.nextIndex << "of"
+                 << begin.chunkCount;
+    }
+
+    ack->nextIndex = download.nextIndex;
+    if (download.nextIndex == begin.chunkCount && !finishDownload(download)) {
+        ack->nextIndex = 0;
+        ack->status = WireProtocol::AckStatus::Rejected;
+    }
+    if (download.nextIndex == begin.chunkCount || ack->status == WireProtocol::AckStatus::Rejected) {
+        m_downloads.erase(it);
+    }
+    return true;
+}
+
+bool ImageTransfer::onChunk(const WireProtocol::ImageChunk &chunk, WireProtocol::ImageAck *ack)
+{
+    auto it = m_downloads.find(chunk.transferId);
+    if (it == m_downloads.end()) {
+        return false;
+    }
+    Download &download = *it->second;
+    const WireProtocol::ImageBegin &begin = download.begin;
+
+    // Stale chunks still in flight from before a resend request
+    if (chunk.index != download.nextIndex) {
+        return false;
+    }
+
+    ack->transferId = chunk.transferId;
+    const bool last = chunk.index + 1 == begin.chunkCount;
+    const qint64 expectedSize = last ? qint64(begin.totalSize) - qint64(chunk.index) * begin.chunkSize
+                                     : qint64(begin.chunkSize);
+    if (chunk.data.size() != expectedSize || sha256(chunk.data) != chunk.sha256) {
+        if (++download.retries > MaxChunkRetries) {
+            qWarning() << "Image" << chunk.transferId << "keeps failing verification, giving up";
+            ack->status = WireProtocol::AckStatus::Rejected;
+            emit transferFailed(chunk.transferId, begin.serverId, tr("Image data was corrupted"));
+            download.part.remove();
+            m_downloads.erase(it);
+            return true;
+        }
+        ack->nextIndex = download.nextIndex;
+        ack->status = WireProtocol::AckStatus::Resend;
+        return true;
+    }
+
+    // The first chunk carries the headers: refuse bombs before storing more
+    if (chunk.index == 0) {
+        const ImageProbe::Info info = ImageProbe::probe(chunk.data);
+        if (info.status != ImageProbe::Status::Ok && info.status != ImageProbe::Status::Incomplete) {
+            qWarning() << "Rejecting image" << chunk.transferId << "from" << begin.sender << info.error;
+            ack->status = WireProtocol::AckStatus::Rejected;
+            emit transferFailed(chunk.transferId, begin.serverId, info.error);
+            download.part.remove();
+            m_downloads.erase(it);
+            return true;
+        }
+    }
+
+    if (!download.part.seek(qint64(chunk.index) * begin.chunkSize)
+        || download.part.write(chunk.data) != chunk.data.size()) {
+        qWarning() << "Write failed for" << download.part.fileName() << download.part.errorString();
+        ack->status = WireProtocol::AckStatus::Rejected;
+        emit transferFailed(chunk.transferId, begin.serverId, tr("Could not save the image"));
+        m_downloads.erase(it);
+        return true;
+    }
+    ++download.nextIndex;
+
+    if (!last) {
+        if (download.nextIndex % AckInterval != 0) {
+            return false;
+        }
+        // The ack promises the data survives a crash, so flush it first
+        download.part.flush();
+        ack->nextIndex = download.nextIndex;
+        return true;
+    }
+
+    ack->nextIndex = download.nextIndex;
+    if (!finishDownload(download)) {
+        ack->nextIndex = 0;
+        ack->status = WireProtocol::AckStatus::Rejected;
+    }
+    m_downloads.erase(it);
+    return true;
+}
+
+void ImageTransfer::onDisconnected()
+{
+    for (auto &entry : m_uploads) {
+        entry.second->accepted = false;
+    }
+    // Closing flushes; the .part files are found again by the next begin
+    m_downloads.clear();
+}
+
+void ImageTransfer::failUploads(const QString &reason)
+{
+    auto uploads = std::move(m_uploads);
+    m_uploads.clear();
+    for (const auto &entry : uploads) {
+        emit transferFailed(entry.first, entry.second->begin.serverId, reason);
+    }
+}
+
+QByteArray ImageTransfer::hashFile(QFile *file)
+{
+    // Streams through QCryptographicHash in blocks rather than loading the file
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!file->seek(0) || !hash.addData(file)) {
+        return QByteArray();
+    }
+    return hash.result();
+}
+
+bool ImageTransfer::isValidBegin(const WireProtocol::ImageBegin &begin)
+{
+    if (!isSafeId(begin.transferId) || begin.sha256.size() != 32) {
+        return false;
+    }
+    if (begin.totalSize == 0 || begin.totalSize > quint64(MaxImageBytes)) {
+        return false;
+    }
+    if (begin.chunkSize == 0 || begin.chunkSize > MaxChunkSize) {
+        return false;
+    }
+    return quint64(begin.chunkCount) == (begin.totalSize + begin.chunkSize - 1) / begin.chunkSize;
+}
+
+QString ImageTransfer::partPath(const QString &transferId) const
+{
+    return QDir(m_spoolDirectory).filePath(transferId + QStringLiteral(".part"));
+}
+
+QString ImageTransfer::finalPath(const WireProtocol::ImageBegin &begin) const
+{
+    // Named by content, so the same image received twice is stored once
+    QString suffix = QFileInfo(begin.fileName).suffix().toLower();
+    static const QRegularExpression plainSuffix(QStringLiteral("^[a-z0-9]{1,5}$"));
+    if (!plainSuffix.match(suffix).hasMatch()) {
+        suffix = QStringLiteral("img");
+    }
+    return QDir(m_spoolDirectory).filePath(QString::fromLatin1(begin.sha256.toHex()) + QLatin1Char('.') + suffix);
+}
+
+bool ImageTransfer::finishDownload(Download &download)
+{
+    const WireProtocol::ImageBegin &begin = download.begin;
+    download.part.flush();
+
+    if (download.part.size() != qint64(begin.totalSize) || hashFile(&download.part) != begin.sha256) {
+        qWarning() << "Image" << begin.transferId << "failed whole-file verification";
+        download.part.remove();
+        emit transferFailed(begin.transferId, begin.serverId, tr("Image data was corrupted"));
+        return false;
+    }
+
+    download.part.close();
+    if (m_cache) {
+        if (m_cache->insertFile(download.part.fileName(), MediaCache::Kind::Image, begin.sha256, true).isEmpty()) {
+            download.part.remove();
+            emit transferFailed(begin.transferId, begin.serverId, tr("Could not save the image"));
+            return false;
+        }
+    } else {
+        const QString path = finalPath(begin);
+        if (!QFile::exists(path) && !QFile::rename(download.part.fileName(), path)) {
+            qWarning() << "Cannot move received image to" << path;
+            download.part.remove();
+            emit transferFailed(begin.transferId, begin.serverId, tr("Could not save the image"));
+            return false;
+        }
+        QFile::remove(download.part.fileName());
+    }
+
+    if (m_completed.size() >= MaxRememberedTransfers) {
+        m_completed.clear();
+    }
+    m_completed.insert(begin.transferId);
+    emit imageReceived(begin.serverId, begin.sender, mediaKey(begin));
+    return true;
+}
+
+bool ImageTransfer::isStored(const WireProtocol::ImageBegin &begin) const
+{
+    if (m_cache) {
+        // lookup() drops an entry whose file has gone, so it is downloaded again
+        return !m_cache->lookup(MediaCache::keyFor(begin.sha256), MediaCache::Kind::Image).isEmpty();
+    }
+    return QFile::exists(finalPath(begin));
+}
+
+QString ImageTransfer::mediaKey(const WireProtocol::ImageBegin &begin) const
+{
+    return m_cache ? MediaCache::keyFor(begin.sha256) : finalPath(begin);
+}
+
+void ImageTransfer::purgeStaleParts()
+{
+    // Transfers the peer never came back to
+    const QDateTime cutoff = QDateTime::currentDateTime().addMSecs(-StalePartAgeMs);
+    const QFileInfoList parts = QDir(m_spoolDirectory).entryInfoList({QStringLiteral("*.part")}, QDir::Files);
+    for (const QFileInfo &part : parts) {
+        if (part.lastModified() < cutoff) {
+            QFile::remove(part.absoluteFilePath());
+        }
+    }
+}
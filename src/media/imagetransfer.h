@@ -0,0 +1,115 @@
+#ifndef IMAGETRANSFER_H
+#define IMAGETRANSFER_H
+
+#include <QObject>
+#include <QFile>
+#include <QString>
+#include <QSet>
+#include <map>
+#include <memory>
+#include "wireprotocol.h"
+
+class MediaCache;
+
+// Chunked image transfer for one connection, in both directions. Neither
+// side ever holds more than one chunk of an image in memory.
+//
+// Sending: the file is hashed and announced with an ImageBegin. Chunks are
+// then read from disk one at a time. The owner pulls them with nextChunk()
+// whenever the socket has room, so chunks fill the gaps between chat frames
+// instead of queueing ahead of them. The receiver acks every AckInterval
+// chunks with the index it has safely written. After a reconnect the begin
+// is sent again and the ack says where to resume.
+//
+// Receiving: chunks are verified against their hash and written straight
+// to a .part file under the spool directory. The file is checked against
+// the whole-image hash and moved into the MediaCache once complete. An
+// image the cache already holds is acked as complete without transferring
+// it again. A .part file left by a dropped connection, or by a restart, is
+// picked up where it stopped.
+class ImageTransfer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr quint32 ChunkSize = 64 * 1024;
+    static constexpr quint32 MaxChunkSize = 256 * 1024;     // Accepted from peers
+    static constexpr quint32 AckInterval = 16;
+    static constexpr quint32 MaxUnackedChunks = 2 * AckInterval;
+    static constexpr int MaxIncoming = 8;
+    static constexpr int MaxChunkRetries = 4;
+
+    explicit ImageTransfer(const QString &spoolDirectory, QObject *parent = nullptr);
+    ~ImageTransfer() override;
+
+    // Without a cache, finished images stay in the spool directory
+    void setMediaCache(MediaCache *cache) { m_cache = cache; }
+
+    // Sending side. Returns the transfer id, or an empty string with
+    // *error set when the file is unusable.
+    QString startUpload(const QString &serverId, const QString &sender, const QString &path,
+                        QString *error = nullptr);
+    void cancelUpload(const QString &transferId);
+    bool hasUploads() const { return !m_uploads.empty(); }
+
+    // Begins the peer has not acknowledged on this connection
+    QVector<WireProtocol::ImageBegin> pendingBegins() const;
+    bool hasChunkReady() const;
+    // Reads the next chunk of one of the accepted uploads, taking turns
+    bool nextChunk(WireProtocol::ImageChunk *chunk);
+    void onAck(const WireProtocol::ImageAck &ack);
+
+    // Receiving side. Each returns the ack to send back, if any.
+    bool onBegin(const WireProtocol::ImageBegin &begin, WireProtocol::ImageAck *ack);
+    bool onChunk(const WireProtocol::ImageChunk &chunk, WireProtocol::ImageAck *ack);
+
+    // The connection dropped: uploads wait to be re-announced and partial
+    // downloads stay on disk for the peer to resume
+    void onDisconnected();
+    // The peer can't take image records at all
+    void failUploads(const QString &reason);
+
+    static QByteArray hashFile(QFile *file);
+
+signals:
+    void uploadProgress(const QString &transferId, const QString &serverId, qint64 bytesAcked, qint64 totalBytes);
+    void uploadFinished(const QString &transferId, const QString &serverId);
+    // mediaKey is the image's MediaCache key, or its path when there is no cache
+    void imageReceived(const QString &serverId, const QString &sender, const QString &mediaKey);
+    void transferFailed(const QString &transferId, const QString &serverId, const QString &error);
+
+private:
+    struct Upload {
+        WireProtocol::ImageBegin begin;
+        QFile file;
+        bool accepted = false;      // The peer acked the begin on this connection
+        quint32 nextToSend = 0;
+        quint32 acked = 0;
+    };
+
+    struct Download {
+        WireProtocol::ImageBegin begin;
+        QFile part;
+        quint32 nextIndex = 0;
+        int retries = 0;
+    };
+
+    static bool isValidBegin(const WireProtocol::ImageBegin &begin);
+    QString partPath(const QString &transferId) const;
+    QString finalPath(const WireProtocol::ImageBegin &begin) const;
+    bool isStored(const WireProtocol::ImageBegin &begin) const;
+    QString mediaKey(const WireProtocol::ImageBegin &begin) const;
+    bool finishDownload(Download &download);
+    void purgeStaleParts();
+
+    static constexpr int MaxRememberedTransfers = 1024;
+
+    QString m_spoolDirectory;
+    MediaCache *m_cache = nullptr;
+    QSet<QString> m_completed;      // Begins repeated after a reconnect are not new images
+    std::map<QString, std::unique_ptr<Upload>> m_uploads;
+    std::map<QString, std::unique_ptr<Download>> m_downloads;
+    QString m_lastChunkFrom;        // Round-robin position among uploads
+};
+
+#endif // IMAGETRANSFER_H
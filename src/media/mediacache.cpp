@@ -0,0 +1,337 @@
+#include "mediacache.h"
+#include "include/constants.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+const char ImageSuffix[] = ".img";
+const char ThumbnailSuffix[] = ".thumb";
+
+QString indexPath(const QString &directory)
+{
+    return QDir(directory).filePath(QStringLiteral("index.bin"));
+}
+
+} // namespace
+
+MediaCache::MediaCache(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_directory(directory)
+    , m_diskBudget(qint64(Constants::MEDIA_CACHE_DISK_MB) * 1024 * 1024)
+    , m_images(qint64(Constants::MEDIA_CACHE_MEMORY_MB) * 1024 * 1024)
+{
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(IndexSaveDelayMs);
+    connect(&m_saveTimer, &QTimer::timeout, this, &MediaCache::saveIndex);
+}
+
+MediaCache::~MediaCache()
+{
+    if (m_saveTimer.isActive()) {
+        saveIndex();
+    }
+}
+
+bool MediaCache::open()
+{
+    if (!QDir().mkpath(m_directory)) {
+        qWarning() << "Cannot create media cache" << m_directory;
+        return false;
+    }
+    if (!loadIndex()) {
+        rebuildIndex();
+    }
+    qDebug() << "Media cache:" << m_entries.size() << "entries," << m_diskBytes / 1024 << "KB";
+    evict();
+    return true;
+}
+
+void MediaCache::setBudgets(qint64 diskBytes, qint64 memoryBytes)
+{
+    m_diskBudget = diskBytes;
+    m_images.setMaxCost(memoryBytes);
+    evict();
+}
+
+bool MediaCache::isKey(const QString &key)
+{
+    static const QRegularExpression pattern(QStringLiteral("^[0-9a-f]{64}$"));
+    return pattern.match(key).hasMatch();
+}
+
+QString MediaCache::entryName(const QString &key, Kind kind)
+{
+    return key + QLatin1String(kind == Kind::Image ? ImageSuffix : ThumbnailSuffix);
+}
+
+bool MediaCache::contains(const QString &key, Kind kind) const
+{
+    return m_entries.contains(entryName(key, kind));
+}
+
+QString MediaCache::lookup(const QString &key, Kind kind)
+{
+    const QString name = entryName(key, kind);
+    auto it = m_entries.find(name);
+    if (it == m_entries.end()) {
+        return QString();
+    }
+
+    // The index is trusted at startup; a file deleted behind our back is
+    // noticed here instead
+    const QString path = filePath(key, kind);
+    if (!QFile::exists(path)) {
+        m_diskBytes -= it->size;
+        m_lru.erase(it->lru);
+        m_entries.erase(it);
+        scheduleSave();
+        return QString();
+    }
+    touch(*it);
+    return path;
+}
+
+QString MediaCache::filePath(const QString &key, Kind kind) const
+{
+    return QDir(m_directory).filePath(key.left(2) + QLatin1Char('/') + entryName(key, kind));
+}
+
+QString MediaCache::insertFile(const QString &path, Kind kind, const QByteArray &sha256, bool move)
+{
+    QByteArray hash = sha256;
+    if (hash.isEmpty()) {
+        QFile file(path);
+        QCryptographicHash hasher(QCryptographicHash::Sha256);
+        if (!file.open(QIODevice::ReadOnly) || !hasher.addData(&file)) {
+            qWarning() << "Cannot read" << path << "into the media cache";
+            return QString();
+        }
+        hash = hasher.result();
+    }
+
+    const QString key = keyFor(hash);
+    if (!lookup(key, kind).isEmpty()) {
+        if (move) {
+            QFile::remove(path);
+        }
+        return key;
+    }
+
+    const QString target = filePath(key, kind);
+    QDir().mkpath(QFileInfo(target).absolutePath());
+    QFile::remove(target);
+    bool stored = move && QFile::rename(path, target);
+    if (!stored) {
+        stored = QFile::copy(path, target);
+        if (stored && move) {
+            QFile::remove(path);
+        }
+    }
+    if (!stored) {
+        qWarning() << "Cannot store" << path << "in the media cache";
+        return QString();
+    }
+
+    record(entryName(key, kind), QFileInfo(target).size());
+    evict();
+    return key;
+}
+
+bool MediaCache::adopt(const QString &key, Kind kind)
+{
+    const QFileInfo info(filePath(key, kind));
+    if (!info.exists()) {
+        return false;
+    }
+    record(entryName(key, kind), info.size());
+    evict();
+    return true;
+}
+
+void MediaCache::remove(const QString &key, Kind kind)
+{
+    const QString name = entryName(key, kind);
+    m_images.remove(name);
+    auto it = m_entries.find(name);
+    if (it == m_entries.end()) {
+        return;
+    }
+    QFile::remove(filePath(key, kind));
+    m_diskBytes -= it->size;
+    m_lru.erase(it->lru);
+    m_entries.erase(it);
+    scheduleSave();
+}
+
+QImage MediaCache::image(const QString &key, Kind kind) const
+{
+    const QImage *image = m_images.object(entryName(key, kind));
+    return image ? *image : QImage();
+}
+
+void MediaCache::insertImage(const QString &key, Kind kind, const QImage &image)
+{
+    m_images.insert(entryName(key, kind), new QImage(image), qMax<qsizetype>(1, image.sizeInBytes()));
+}
+
+void MediaCache::record(const QString &name, qint64 size)
+{
+    auto it = m_entries.find(name);
+    if (it != m_entries.end()) {
+        m_diskBytes += size - it->size;
+        it->size = size;
+        touch(*it);
+    } else {
+        m_lru.push_front(name);
+        m_entries.insert(name, Entry{size, m_lru.begin()});
+        m_diskBytes += size;
+    }
+    scheduleSave();
+}
+
+void MediaCache::touch(Entry &entry)
+{
+    if (entry.lru != m_lru.begin()) {
+        m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+    }
+}
+
+void MediaCache::evict()
+{
+    // The newest entry stays even if it alone is over budget
+    int evicted = 0;
+    while (m_diskBytes > m_diskBudget && m_lru.size() > 1) {
+        const QString name = m_lru.back();
+        m_lru.pop_back();
+        const Entry entry = m_entries.take(name);
+        m_diskBytes -= entry.size;
+        m_images.remove(name);
+        QFile::remove(QDir(m_directory).filePath(name.left(2) + QLatin1Char('/') + name));
+        ++evicted;
+    }
+    if (evicted > 0) {
+        qDebug() << "Media cache evicted" << evicted << "entries";
+        scheduleSave();
+    }
+}
+
+void MediaCache::scheduleSave()
+{
+    if (!m_saveTimer.isActive()) {
+        m_saveTimer.start();
+    }
+}
+
+bool MediaCache::saveIndex()
+{
+    m_saveTimer.stop();
+
+    // Fixed-size records, most recently used first
+    QByteArray data;
+    data.reserve(12 + m_entries.size() * RecordSize);
+    auto appendU32 = [&data](quint32 value) {
+        const quint32 be = qToBigEndian(value);
+        data.append(reinterpret_cast<const char *>(&be), 4);
+    };
+    appendU32(IndexMagic);
+    appendU32(IndexVersion);
+    appendU32(quint32(m_entries.size()));
+    for (const QString &name : m_lru) {
+        const int dot = name.indexOf(QLatin1Char('.'));
+        data.append(QByteArray::fromHex(name.left(dot).toLatin1()));
+        data.append(char(name.mid(dot) == QLatin1String(ImageSuffix) ? Kind::Image : Kind::Thumbnail));
+        const quint64 be = qToBigEndian(quint64(m_entries.value(name).size));
+        data.append(reinterpret_cast<const char *>(&be), 8);
+    }
+
+    QSaveFile file(indexPath(m_directory));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "Cannot write media cache index" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MediaCache::loadIndex()
+{
+    QFile file(indexPath(m_directory));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    const auto *p = reinterpret_cast<const uchar *>(data.constData());
+    if (data.size() < 12 || qFromBigEndian<quint32>(p) != IndexMagic
+        || qFromBigEndian<quint32>(p + 4) != IndexVersion) {
+        qWarning() << "Media cache index is unreadable, rebuilding";
+        return false;
+    }
+    const quint32 count = qFromBigEndian<quint32>(p + 8);
+    if (data.size() != 12 + qint64(count) * RecordSize) {
+        qWarning() << "Media cache index is truncated, rebuilding";
+        return false;
+    }
+
+    // The index is saved a little after each change, so files written just
+    // before a crash are missing from it. Adding or removing a file touches
+    // its fan-out directory, so any directory newer than the index means it
+    // is stale.
+    const QDateTime saved = QFileInfo(file).lastModified();
+    const QFileInfoList fanout = QDir(m_directory).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QFileInfo &dir : fanout) {
+        if (dir.lastModified() > saved) {
+            qWarning() << "Media cache index is older than" << dir.fileName() << ", rebuilding";
+            return false;
+        }
+    }
+
+    p += 12;
+    for (quint32 i = 0; i < count; ++i, p += RecordSize) {
+        const QString key = QString::fromLatin1(QByteArray(reinterpret_cast<const char *>(p), 32).toHex());
+        const Kind kind = p[32] == quint8(Kind::Image) ? Kind::Image : Kind::Thumbnail;
+        const qint64 size = qint64(qFromBigEndian<quint64>(p + 33));
+        const QString name = entryName(key, kind);
+        if (m_entries.contains(name)) {
+            continue;
+        }
+        // Stored most recent first, so each entry goes behind the previous
+        m_lru.push_back(name);
+        m_entries.insert(name, Entry{size, std::prev(m_lru.end())});
+        m_diskBytes += size;
+    }
+    return true;
+}
+
+void MediaCache::rebuildIndex()
+{
+    static const QRegularExpression pattern(QStringLiteral("^([0-9a-f]{64})\\.(img|thumb)$"));
+
+    QFileInfoList files;
+    QDirIterator it(m_directory, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        if (pattern.match(it.fileName()).hasMatch()) {
+            files.append(it.fileInfo());
+        }
+    }
+    // Modification time is the best available guess at recency
+    std::sort(files.begin(), files.end(), [](const QFileInfo &a, const QFileInfo &b) {
+        return a.lastModified() > b.lastModified();
+    });
+
+    for (const QFileInfo &info : std::as_const(files)) {
+        m_lru.push_back(info.fileName());
+        m_entries.insert(info.fileName(), Entry{info.size(), std::prev(m_lru.end())});
+        m_diskBytes += info.size();
+    }
+    scheduleSave();
+}
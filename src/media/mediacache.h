@@ -0,0 +1,95 @@
+#ifndef MEDIACACHE_H
+#define MEDIACACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QTimer>
+#include <list>
+
+// Content-addressed store for images and their thumbnails, keyed by the
+// hex SHA-256 of the full image. An image posted a hundred times, or shown
+// in several tabs, is kept and downloaded once.
+//
+// Files live on disk under the cache directory, two hex characters of
+// fan-out deep. The disk tier has a byte budget and evicts least recently
+// used entries past it. A binary index of (hash, kind, size) records, kept
+// in LRU order, is read in one go at startup instead of walking the
+// directory. Decoded thumbnails are kept in a memory tier with its own
+// budget. Used from the GUI thread only.
+class MediaCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Kind : quint8 {
+        Image = 0,
+        Thumbnail = 1
+    };
+
+    MediaCache(const QString &directory, QObject *parent = nullptr);
+    ~MediaCache() override;
+
+    // Loads the index, or rebuilds it from the directory if it is missing
+    // or older than the files it describes
+    bool open();
+    void setBudgets(qint64 diskBytes, qint64 memoryBytes);
+
+    static QString keyFor(const QByteArray &sha256) { return QString::fromLatin1(sha256.toHex()); }
+    static bool isKey(const QString &key);
+
+    bool contains(const QString &key, Kind kind) const;
+    // Path of a cached entry, marking it recently used; empty on a miss
+    QString lookup(const QString &key, Kind kind);
+    // Where an entry is stored, whether or not it exists yet
+    QString filePath(const QString &key, Kind kind) const;
+
+    // Copies (or moves) a file in and returns its key. The hash is
+    // computed when not supplied.
+    QString insertFile(const QString &path, Kind kind, const QByteArray &sha256 = QByteArray(),
+                       bool move = false);
+    // Registers a file another thread already wrote at filePath()
+    bool adopt(const QString &key, Kind kind);
+    void remove(const QString &key, Kind kind);
+
+    // Memory tier for decoded images
+    QImage image(const QString &key, Kind kind) const;
+    void insertImage(const QString &key, Kind kind, const QImage &image);
+
+    qint64 diskBytes() const { return m_diskBytes; }
+    qint64 diskBudget() const { return m_diskBudget; }
+    int entryCount() const { return m_entries.size(); }
+
+    bool saveIndex();
+
+private:
+    static constexpr quint32 IndexMagic = 0x52434D49;   // "RCMI"
+    static constexpr quint32 IndexVersion = 1;
+    static constexpr int RecordSize = 32 + 1 + 8;
+    static constexpr int IndexSaveDelayMs = 2000;
+
+    struct Entry {
+        qint64 size = 0;
+        std::list<QString>::iterator lru;
+    };
+
+    static QString entryName(const QString &key, Kind kind);
+    bool loadIndex();
+    void rebuildIndex();
+    void record(const QString &name, qint64 size);
+    void touch(Entry &entry);
+    void evict();
+    void scheduleSave();
+
+    QString m_directory;
+    qint64 m_diskBudget;
+    qint64 m_diskBytes = 0;
+
+    QHash<QString, Entry> m_entries;        // By entry name
+    std::list<QString> m_lru;               // Most recently used first
+    mutable QCache<QString, QImage> m_images;
+    QTimer m_saveTimer;
+};
+
+#endif // MEDIACACHE_H
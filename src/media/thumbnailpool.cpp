@@ -0,0 +1,129 @@
+#include "thumbnailpool.h"
+#include "imageprobe.h"
+#include "mediacache.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QDebug>
+
+ThumbnailPool::ThumbnailPool(MediaCache *cache, QObject *parent)
+    : QObject(parent)
+    , m_cache(cache)
+{
+    m_pool.setMaxThreadCount(MaxConcurrentDecodes);
+    m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+ThumbnailPool::~ThumbnailPool()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+QImage ThumbnailPool::thumbnail(const QString &image)
+{
+    const QImage cached = m_cache->image(image, MediaCache::Kind::Thumbnail);
+    if (!cached.isNull()) {
+        return cached;
+    }
+    if (m_pending.contains(image) || m_failed.contains(image)) {
+        return QImage();
+    }
+
+    // Paths are resolved here, since the cache is only used from this thread
+    Job job;
+    job.image = image;
+    if (MediaCache::isKey(image)) {
+        job.thumbnailPath = m_cache->lookup(image, MediaCache::Kind::Thumbnail);
+        if (job.thumbnailPath.isEmpty()) {
+            job.sourcePath = m_cache->lookup(image, MediaCache::Kind::Image);
+            job.savePath = m_cache->filePath(image, MediaCache::Kind::Thumbnail);
+        }
+    } else {
+        job.sourcePath = image;
+    }
+    if (job.thumbnailPath.isEmpty() && job.sourcePath.isEmpty()) {
+        m_failed.insert(image, tr("No longer cached"));
+        return QImage();
+    }
+
+    m_pending.insert(image);
+    m_pool.start([this, job]() {
+        QString error;
+        const QImage thumbnail = run(job, &error);
+        // Applied on the GUI thread; the destructor waits for running decodes
+        // and Qt drops the posted call if this pool is gone by then
+        QMetaObject::invokeMethod(this, [this, job, thumbnail, error]() {
+            onDecoded(job, thumbnail, error);
+        }, Qt::QueuedConnection);
+    });
+    return QImage();
+}
+
+void ThumbnailPool::onDecoded(const Job &job, const QImage &image, const QString &error)
+{
+    m_pending.remove(job.image);
+    if (image.isNull()) {
+        qWarning() << "No thumbnail for" << job.image << error;
+        m_failed.insert(job.image, error);
+        emit thumbnailFailed(job.image, error);
+        return;
+    }
+
+    if (!job.savePath.isEmpty()) {
+        m_cache->adopt(job.image, MediaCache::Kind::Thumbnail);
+    }
+    m_cache->insertImage(job.image, MediaCache::Kind::Thumbnail, image);
+    emit thumbnailReady(job.image);
+}
+
+QImage ThumbnailPool::run(const Job &job, QString *error)
+{
+    if (!job.thumbnailPath.isEmpty()) {
+        QImage image(job.thumbnailPath);
+        if (!image.isNull()) {
+            return image;
+        }
+        *error = QStringLiteral("Cached thumbnail is unreadable");
+        return QImage();
+    }
+
+    const QImage image = decode(job.sourcePath, error);
+    if (!image.isNull() && !job.savePath.isEmpty()) {
+        QDir().mkpath(QFileInfo(job.savePath).absolutePath());
+        QSaveFile file(job.savePath);
+        if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG") || !file.commit()) {
+            qWarning() << "Cannot save thumbnail" << job.savePath;
+        }
+    }
+    return image;
+}
+
+QImage ThumbnailPool::decode(const QString &path, QString *error)
+{
+    // The headers are checked before the decoder allocates anything
+    const ImageProbe::Info info = ImageProbe::probeFile(path);
+    if (!info.isOk()) {
+        *error = info.error;
+        return QImage();
+    }
+
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    const QSize size = QSize(info.width, info.height).scaled(thumbnailSize(), Qt::KeepAspectRatio);
+    if (QSize(info.width, info.height).boundedTo(thumbnailSize()) != QSize(info.width, info.height)) {
+        // Lets the JPEG decoder skip detail it would throw away
+        reader.setScaledSize(size);
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        *error = reader.errorString();
+        return QImage();
+    }
+    if (image.width() > ThumbnailWidth || image.height() > ThumbnailHeight) {
+        image = image.scaled(thumbnailSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image;
+}
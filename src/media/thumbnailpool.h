@@ -0,0 +1,67 @@
+#ifndef THUMBNAILPOOL_H
+#define THUMBNAILPOOL_H
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+#include <QSize>
+#include <QThreadPool>
+
+class MediaCache;
+
+// Decodes chat images into thumbnails on a private thread pool, so a burst
+// of images never decodes on the GUI thread or more than
+// MaxConcurrentDecodes at a time. Each file is probed before decoding and
+// rejected if its headers describe an oversized image; JPEGs are decoded
+// directly at thumbnail scale.
+//
+// Images are named by MediaCache key. Finished thumbnails go into the
+// cache's memory tier and are saved to its disk tier as PNG, so the next
+// run loads a small file instead of decoding the original again. A plain
+// file path works too, but is only cached in memory.
+//
+// thumbnail() never blocks: it starts the work and returns a null image
+// until thumbnailReady() fires for that image.
+class ThumbnailPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int MaxConcurrentDecodes = 2;
+    static constexpr int ThumbnailWidth = 240;
+    static constexpr int ThumbnailHeight = 180;
+
+    explicit ThumbnailPool(MediaCache *cache, QObject *parent = nullptr);
+    ~ThumbnailPool() override;
+
+    QImage thumbnail(const QString &image);
+    // Set once the image failed to probe or decode
+    QString failure(const QString &image) const { return m_failed.value(image); }
+    int pendingCount() const { return m_pending.size(); }
+
+    static QSize thumbnailSize() { return QSize(ThumbnailWidth, ThumbnailHeight); }
+
+signals:
+    void thumbnailReady(const QString &image);
+    void thumbnailFailed(const QString &image, const QString &error);
+
+private:
+    struct Job {
+        QString image;
+        QString thumbnailPath;      // Cached thumbnail to load, if any
+        QString sourcePath;         // Otherwise the original to decode
+        QString savePath;           // Where to store a new thumbnail
+    };
+
+    void onDecoded(const Job &job, const QImage &image, const QString &error);
+    static QImage run(const Job &job, QString *error);
+    static QImage decode(const QString &path, QString *error);
+
+    MediaCache *m_cache;
+    QThreadPool m_pool;
+    QSet<QString> m_pending;
+    QHash<QString, QString> m_failed;
+};
+
+#endif // THUMBNAILPOOL_H
@@ -0,0 +1,138 @@
+#include "messagedelegate.h"
+#include "transcriptmodel.h"
+#include "media/thumbnailpool.h"
+#include <QPainter>
+#include <QAbstractItemView>
+#include <QFontMetrics>
+
+namespace {
+
+// Wraps the row's arena text without copying it; only used for the length
+// of one paint or measure call, while the row is alive
+QString rawText(QStringView text)
+{
+    return QString::fromRawData(reinterpret_cast<const QChar *>(text.utf16()), text.size());
+}
+
+} // namespace
+
+MessageDelegate::MessageDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+QString MessageDelegate::timestampText(const QDateTime &timestamp)
+{
+    return timestamp.toString("hh:mm:ss");
+}
+
+void MessageDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                            const QModelIndex &index) const
+{
+    const auto *model = qobject_cast<const TranscriptModel *>(index.model());
+    if (!model) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    const int row = index.row();
+    const QString sender = model->senderAt(row);
+    const QRect rect = option.rect.adjusted(Padding, Padding, -Padding, -Padding);
+
+    QFont senderFont = option.font;
+    senderFont.setBold(true);
+    const QFontMetrics senderMetrics(senderFont);
+    const int baseline = rect.top() + senderMetrics.ascent();
+
+    painter->save();
+
+    // Header: sender in bold followed by a dimmed timestamp
+    painter->setFont(senderFont);
+    painter->setPen(QColor("#ffffff"));
+    painter->drawText(QPoint(rect.left(), baseline), sender);
+
+    const int timestampX = rect.left() + senderMetrics.horizontalAdvance(sender) + 4 * Spacing;
+    painter->setFont(option.font);
+    painter->setPen(QColor("#888888"));
+    painter->drawText(QPoint(timestampX, baseline), timestampText(model->timestampAt(row)));
+
+    // Body is drawn as plain text, so no HTML escaping is needed
+    QRect body = rect;
+    body.setTop(rect.top() + senderMetrics.height() + Spacing);
+    if (model->containsImageAt(row) && m_thumbnails) {
+        paintImage(painter, QRect(body.topLeft(), ThumbnailPool::thumbnailSize()), model->imageKeyAt(row));
+    } else {
+        painter->setPen(QColor("#ffffff"));
+        painter->drawText(body, Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, rawText(model->contentAt(row)));
+    }
+
+    painter->restore();
+}
+
+void MessageDelegate::paintImage(QPainter *painter, const QRect &box, const QString &imageKey) const
+{
+    // Requests the decode on first paint, so only visible images are decoded
+    const QImage thumbnail = m_thumbnails->thumbnail(imageKey);
+    if (!thumbnail.isNull()) {
+        painter->drawImage(QRect(box.topLeft(), thumbnail.size()), thumbnail);
+        return;
+    }
+
+    const QString failure = m_thumbnails->failure(imageKey);
+    painter->setPen(QColor("#555555"));
+    painter->setBrush(QColor("#2b2b2b"));
+    painter->drawRoundedRect(box.adjusted(0, 0, -1, -1), 4, 4);
+    painter->setPen(QColor("#888888"));
+    painter->drawText(box.adjusted(Padding, Padding, -Padding, -Padding),
+                      Qt::AlignCenter | Qt::TextWordWrap,
+                      failure.isEmpty() ? tr("Loading image...") : tr("Image unavailable\n%1").arg(failure));
+}
+
+QSize MessageDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const auto *model = qobject_cast<const TranscriptModel *>(index.model());
+    if (!model) {
+        return QStyledItemDelegate::sizeHint(option, index);
+    }
+
+    const int width = contentWidth(option);
+    if (width != m_cachedWidth || m_heightCache.size() > MaxCachedHeights) {
+        m_heightCache.clear();
+        m_cachedWidth = width;
+    }
+
+    const quint64 serial = model->serialAt(index.row());
+    auto it = m_heightCache.constFind(serial);
+    if (it != m_heightCache.constEnd()) {
+        return QSize(width + 2 * Padding, *it);
+    }
+
+    const int height = measureHeight(model, index.row(), option.font, width);
+    m_heightCache.insert(serial, height);
+    return QSize(width + 2 * Padding, height);
+}
+
+int MessageDelegate::contentWidth(const QStyleOptionViewItem &option) const
+{
+    const auto *view = qobject_cast<const QAbstractItemView *>(option.widget);
+    const int width = view ? view->viewport()->width() : option.rect.width();
+    return qMax(50, width - 2 * Padding);
+}
+
+int MessageDelegate::measureHeight(const TranscriptModel *model, int row, const QFont &font, int width) const
+{
+    QFont senderFont = font;
+    senderFont.setBold(true);
+    const QFontMetrics senderMetrics(senderFont);
+    const QFontMetrics bodyMetrics(font);
+
+    if (model->containsImageAt(row) && m_thumbnails) {
+        return 2 * Padding + senderMetrics.height() + Spacing + ThumbnailPool::ThumbnailHeight;
+    }
+
+    const QRect body = bodyMetrics.boundingRect(QRect(0, 0, width, 0),
+                                                Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap,
+                                                rawText(model->contentAt(row)));
+
+    return 2 * Padding + senderMetrics.height() + Spacing + qMax(body.height(), bodyMetrics.height());
+}
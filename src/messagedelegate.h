@@ -0,0 +1,45 @@
+#ifndef MESSAGEDELEGATE_H
+#define MESSAGEDELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QHash>
+#include "include/types.h"
+
+class ThumbnailPool;
+class TranscriptModel;
+
+// Paints one chat message per row of a TranscriptModel. The view only asks
+// for painting of visible rows; row heights are measured once per message
+// and viewport width and then served from a cache. Image messages reserve a
+// fixed thumbnail box, so a row keeps its height while its thumbnail loads.
+class MessageDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit MessageDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    void setThumbnailPool(ThumbnailPool *pool) { m_thumbnails = pool; }
+
+    static QString timestampText(const QDateTime &timestamp);
+
+private:
+    static constexpr int Padding = 6;
+    static constexpr int Spacing = 2;
+    static constexpr int MaxCachedHeights = 8192;
+
+    int contentWidth(const QStyleOptionViewItem &option) const;
+    int measureHeight(const TranscriptModel *model, int row, const QFont &font, int width) const;
+    void paintImage(QPainter *painter, const QRect &box, const QString &imageKey) const;
+
+    ThumbnailPool *m_thumbnails = nullptr;
+
+    mutable QHash<quint64, int> m_heightCache;
+    mutable int m_cachedWidth = -1;
+};
+
+#endif // MESSAGEDELEGATE_H
@@ -0,0 +1,112 @@
+#include "domaintrie.h"
+#include <algorithm>
+
+DomainTrie::DomainTrie()
+{
+    clear();
+}
+
+void DomainTrie::clear()
+{
+    m_nodes.clear();
+    m_nodes.emplace_back();  // Root
+    m_entryCount = 0;
+}
+
+QStringView DomainTrie::normalize(QStringView domain)
+{
+    domain = domain.trimmed();
+    if (domain.startsWith(u"*.")) {
+        domain = domain.mid(2);
+    }
+    while (domain.startsWith(u'.')) {
+        domain = domain.mid(1);
+    }
+    while (domain.endsWith(u'.')) {
+        domain.chop(1);
+    }
+    return domain;
+}
+
+void DomainTrie::insert(const QString &domain)
+{
+    const QStringView normalized = normalize(domain);
+    if (normalized.isEmpty()) {
+        return;
+    }
+
+    quint32 node = 0;
+    qsizetype end = normalized.size();
+    while (end > 0) {
+        const qsizetype dot = normalized.lastIndexOf(u'.', end - 1);
+        const QString label = normalized.mid(dot + 1, end - dot - 1).toString().toLower();
+
+        auto it = m_nodes[node].children.constFind(label);
+        if (it != m_nodes[node].children.constEnd()) {
+            node = *it;
+        } else {
+            const quint32 child = static_cast<quint32>(m_nodes.size());
+            m_nodes[node].children.insert(label, child);
+            m_nodes.emplace_back();
+            node = child;
+        }
+
+        end = dot;
+    }
+
+    if (!m_nodes[node].terminal) {
+        m_nodes[node].terminal = true;
+        ++m_entryCount;
+    }
+}
+
+void DomainTrie::insert(const QStringList &domains)
+{
+    for (const QString &domain : domains) {
+        insert(domain);
+    }
+}
+
+DomainTrie::Match DomainTrie::match(QStringView host) const
+{
+    host = normalize(host);
+    if (host.isEmpty()) {
+        return Match::None;
+    }
+
+    // Lowercase once per query, and only if needed; hosts taken from URLs
+    // usually already are
+    QString lowered;
+    if (std::any_of(host.begin(), host.end(), [](QChar c) { return c.isUpper(); })) {
+        lowered = host.toString().toLower();
+        host = lowered;
+    }
+
+    quint32 node = 0;
+    qsizetype end = host.size();
+    while (end > 0) {
+        const qsizetype dot = host.lastIndexOf(u'.', end - 1);
+        // Borrows the label's characters for the lookup instead of copying
+        const QStringView view = host.mid(dot + 1, end - dot - 1);
+        const QString label = QString::fromRawData(view.data(), view.size());
+
+        auto it = m_nodes[node].children.constFind(label);
+        if (it == m_nodes[node].children.constEnd()) {
+            return Match::None;
+        }
+        node = *it;
+
+        if (dot < 0) {
+            return m_nodes[node].terminal ? Match::Exact : Match::None;
+        }
+
+        // A listed parent domain covers every host beneath it
+        if (m_nodes[node].terminal) {
+            return Match::Subdomain;
+        }
+
+        end = dot;
+    }
+
+    return Match::None;
+}
@@ -0,0 +1,47 @@
+#ifndef DOMAINTRIE_H
+#define DOMAINTRIE_H
+
+#include <QString>
+#include <QStringView>
+#include <QHash>
+#include <vector>
+
+// Set of domains stored as a trie over reversed labels ("www.roblox.com"
+// is stored as com -> roblox -> www). Lookups walk one node per label, so
+// the cost of a query depends on the host, not on the number of entries,
+// and matches always fall on label boundaries ("notroblox.com" does not
+// match "roblox.com").
+class DomainTrie
+{
+public:
+    enum class Match {
+        None,
+        Exact,      // The host itself is in the set
+        Subdomain   // A parent domain of the host is in the set
+    };
+
+    DomainTrie();
+
+    void insert(const QString &domain);
+    void insert(const QStringList &domains);
+    void clear();
+
+    Match match(QStringView host) const;
+    bool contains(QStringView host) const { return match(host) != Match::None; }
+
+    int size() const { return m_entryCount; }
+    bool isEmpty() const { return m_entryCount == 0; }
+
+private:
+    struct Node {
+        QHash<QString, quint32> children;
+        bool terminal = false;
+    };
+
+    static QStringView normalize(QStringView domain);
+
+    std::vector<Node> m_nodes;
+    int m_entryCount = 0;
+};
+
+#endif // DOMAINTRIE_H
@@ -1,10 +1,20 @@
 #include "linkvalidator.h"
+#include "urlscanner.h"
 #include <QUrl>
-#include <QRegularExpression>
 #include <QDebug>
 
 LinkValidator::LinkValidator()
 {
+    m_whitelist.insert(QStringList{
+        "roblox.com", "discord.com", "youtube.com", "twitch.tv", "github.com"
+    });
+    m_blacklist.insert(QStringList{
+        "malicious.com", "phishing.net", "scam.org", "suspicious.net"
+    });
+    m_validTlds.insert(QStringList{
+        "com", "org", "net", "edu", "gov", "io", "co", "tv", "info", "app", "dev"
+    });
+    
     qDebug() << "LinkValidator initialized";
 }
 
@@ -18,7 +28,9 @@ bool LinkValidator::isValidUrl(const QString &urlString) const
 
 bool LinkValidator::isSafeUrl(const QString &urlString) const
 {
-    if (!isValidUrl(urlString)) {
+    // Parse once and reuse the host for every check below
+    QUrl url(urlString);
+    if (!url.isValid() || url.scheme().isEmpty()) {
         return false;
     }
     
@@ -30,13 +42,13 @@ bool LinkValidator::isSafeUrl(const QString &urlString) const
         return false;
     }
     
-    QString domain = extractDomain(urlString);
+    QString domain = url.host();
     if (isDomainBlacklisted(domain)) {
         return false;
     }
     
-    float reputationScore = calculateReputationScore(urlString);
-    if (reputationScore < 0.8f) {
+    float score = reputationScore(urlString, domain);
+    if (score < 0.8f) {
         return false;
     }
     
@@ -45,32 +57,12 @@ bool LinkValidator::isSafeUrl(const QString &urlString) const
 
 bool LinkValidator::isDomainWhitelisted(const QString &domain) const
 {
-    const QStringList whitelist = {
-        "roblox.com", "discord.com", "youtube.com", "twitch.tv", "github.com"
-    };
-    
-    for (const QString &whitelistedDomain : whitelist) {
-        if (domain.endsWith(whitelistedDomain, Qt::CaseInsensitive)) {
-            return true;
-        }
-    }
-    
-    return false;
+    return m_whitelist.contains(domain);
 }
 
 bool LinkValidator::isDomainBlacklisted(const QString &domain) const
 {
-    const QStringList blacklist = {
-        "malicious.com", "phishing.net", "scam.org", "suspicious.net"
-    };
-    
-    for (const QString &blacklistedDomain : blacklist) {
-        if (domain.endsWith(blacklistedDomain, Qt::CaseInsensitive)) {
-            return true;
-        }
-    }
-    
-    return false;
+    return m_blacklist.contains(domain);
 }
 
 QString LinkValidator::extractDomain(const QString &urlString) const
@@ -81,10 +73,13 @@ QString LinkValidator::extractDomain(const QString &urlString) const
 
 float LinkValidator::calculateReputationScore(const QString &urlString) const
 {
-    float score = 0.5f;  // Default neutral score
-    
     QUrl url(urlString);
-    QString domain = url.host();
+    return reputationScore(urlString, url.host());
+}
+
+float LinkValidator::reputationScore(const QString &urlString, const QString &domain) const
+{
+    float score = 0.5f;  // Default neutral score
     
     // Higher score for whitelisted domains
     if (isDomainWhitelisted(domain)) {
@@ -132,8 +127,7 @@ bool LinkValidator::containsSuspiciousPatterns(const QString &urlString) const
     }
     
     // Check for IP addresses instead of domain names
-    QRegularExpression ipRegex("\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}");
-    if (urlString.contains(ipRegex)) {
+    if (UrlScanner::containsIpv4(urlString)) {
         return true;
     }
     
@@ -154,17 +148,8 @@ bool LinkValidator::isPhishingLike(const QString &url) const
 
 bool LinkValidator::hasValidTLD(const QString &domain) const
 {
-    const QStringList validTLDs = {
-        ".com", ".org", ".net", ".edu", ".gov", ".io", ".co", ".tv", ".info", ".app", ".dev"
-    };
-    
-    for (const QString &tld : validTLDs) {
-        if (domain.endsWith(tld, Qt::CaseInsensitive)) {
-            return true;
-        }
-    }
-    
-    return false;
+    // A bare TLD is not a registrable domain, so require at least one label before it
+    return m_validTlds.match(domain) == DomainTrie::Match::Subdomain;
 }
 
 bool LinkValidator::hasExcessiveSubdomains(const QString &domain) const
@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QUrl>
+#include "domaintrie.h"
 
 class LinkValidator
 {
@@ -24,6 +25,12 @@ private:
     bool isPhishingLike(const QString &url) const;
     bool hasValidTLD(const QString &domain) const;
     bool hasExcessiveSubdomains(const QString &domain) const;
+    float reputationScore(const QString &urlString, const QString &domain) const;
+
+    // Compiled once from the built-in lists
+    DomainTrie m_whitelist;
+    DomainTrie m_blacklist;
+    DomainTrie m_validTlds;
 };
 
 #endif // LINKVALIDATOR_H
@@ -1,8 +1,36 @@
 #include "moderationengine.h"
 #include "linkvalidator.h"
-#include <QDebug>
+#include "urlscanner.h"
+#include "media/imageprobe.h"
+#include "diagnostics/logger.h"
+#include "diagnostics/metrics.h"
 #include <QFile>
-#include <QRegularExpression>
+#include <QFileInfo>
+#include <QtConcurrent/QtConcurrentRun>
+#include "include/constants.h"
+
+namespace {
+
+// Shared by every engine and worker thread
+struct ModerationMetrics {
+    Counter *messages = MetricsRegistry::instance().counter("moderation.messages");
+    Counter *linkChecks = MetricsRegistry::instance().counter("moderation.link_checks");
+    Counter *cacheHits = MetricsRegistry::instance().counter("moderation.verdict_cache_hits");
+    Counter *malicious = MetricsRegistry::instance().counter("moderation.verdicts_malicious");
+    Counter *clean = MetricsRegistry::instance().counter("moderation.verdicts_clean");
+    Counter *timedOut = MetricsRegistry::instance().counter("moderation.links_timed_out");
+    Histogram *messageTime = MetricsRegistry::instance().histogram("moderation.message_ns");
+    Histogram *checkTime = MetricsRegistry::instance().histogram("moderation.link_check_ns");
+    Histogram *evaluateTime = MetricsRegistry::instance().histogram("moderation.link_evaluate_ns");
+};
+
+const ModerationMetrics &metrics()
+{
+    static const ModerationMetrics instance;
+    return instance;
+}
+
+} // namespace
 
 ModerationEngine::ModerationEngine()
     : m_linkValidator(std::make_unique<LinkValidator>())
@@ -10,7 +38,11 @@ ModerationEngine::ModerationEngine()
     initializeBlacklist();
 }
 
-ModerationEngine::~ModerationEngine() = default;
+ModerationEngine::~ModerationEngine()
+{
+    // The background reload captures this engine
+    m_updateFuture.waitForFinished();
+}
 
 bool ModerationEngine::validateLink(const QString &url)
 {
@@ -19,30 +51,17 @@ bool ModerationEngine::validateLink(const QString &url)
 
 bool ModerationEngine::validateImage(const QByteArray &imageData)
 {
-    // TODO: Implement image content validation
-    // - Check file type and magic bytes
-    // - Scan for inappropriate content
-    // - Verify image dimensions
-    
-    if (imageData.isEmpty()) {
+    // Header-only: dimensions and frame counts are checked against the
+    // limits without decoding, so bombs are refused before any decoder runs
+    if (imageData.size() > ImageProbe::maxFileBytes()) {
         return false;
     }
-    
-    // Basic validation: check for common image magic bytes
-    if (imageData.startsWith("\xFF\xD8\xFF")) {  // JPEG
-        return true;
-    }
-    if (imageData.startsWith("\x89PNG")) {  // PNG
-        return true;
-    }
-    if (imageData.startsWith("GIF8")) {  // GIF
-        return true;
-    }
-    if (imageData.startsWith("\x00\x00\x01\x00")) {  // ICO
-        return true;
+    const ImageProbe::Info info = ImageProbe::probe(imageData);
+    if (!info.isOk()) {
+        LOG_DEBUG(LogCategory::Moderation, "Image rejected: %1", info.error);
+        return false;
     }
-    
-    return false;
+    return true;
 }
 
 QString ModerationEngine::filterContent(const QString &content)
@@ -60,16 +79,50 @@ QString ModerationEngine::filterContent(const QString &content)
     return filtered;
 }
 
+Message ModerationEngine::moderateMessage(const Message &message, const QDeadlineTimer &deadline)
+{
+    metrics().messages->increment();
+    ScopedTimer timer(metrics().messageTime);
+    Message moderated = message;
+    moderated.linkUrls.clear();
+    
+    QStringList links = extractLinks(message.content);
+    moderated.containsLink = !links.isEmpty();
+    
+    for (const QString &link : links) {
+        if (deadline.hasExpired()) {
+            metrics().timedOut->increment();
+            moderated.content.replace(link, "[REMOVED - LINK CHECK TIMED OUT]");
+        } else if (isMaliciousLink(link)) {
+            moderated.content.replace(link, "[REMOVED - MALICIOUS LINK]");
+        } else {
+            moderated.linkUrls.append(link);
+        }
+    }
+    
+    return moderated;
+}
+
+QString ModerationEngine::redactLinks(const QString &content)
+{
+    QString redacted = content;
+    
+    QStringList links = extractLinks(content);
+    for (const QString &link : links) {
+        redacted.replace(link, "[REMOVED - LINK CHECK TIMED OUT]");
+    }
+    
+    return redacted;
+}
+
 QStringList ModerationEngine::extractLinks(const QString &text)
 {
     QStringList links;
     
-    QRegularExpression urlRegex("https?://[^\\s]+");
-    QRegularExpressionMatchIterator it = urlRegex.globalMatch(text);
-    
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-        links.append(match.captured(0));
+    const UrlSpanList spans = UrlScanner::scan(text);
+    links.reserve(spans.size());
+    for (const UrlSpan &span : spans) {
+        links.append(span.url(text).toString());
     }
     
     return links;
@@ -77,47 +130,148 @@ QStringList ModerationEngine::extractLinks(const QString &text)
 
 void ModerationEngine::loadBlacklist(const QString &filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open blacklist file:" << filePath;
+    std::shared_ptr<const PatternMatcher> matcher = compileBlacklist(filePath);
+    if (!matcher) {
+        LOG_WARNING(LogCategory::Moderation, "Could not open blacklist file %1", filePath);
         return;
     }
     
-    m_blacklist.clear();
-    while (!file.atEnd()) {
-        QString line = QString::fromUtf8(file.readLine()).trimmed();
-        if (!line.isEmpty() && !line.startsWith("#")) {
-            m_blacklist.append(line);
+    publishBlacklist(std::move(matcher));
+}
+
+void ModerationEngine::updateBlacklist()
+{
+    if (m_updateFuture.isRunning()) {
+        LOG_DEBUG(LogCategory::Moderation, "Blacklist update already in progress");
+        return;
+    }
+    
+    LOG_INFO(LogCategory::Moderation, "Updating blacklist");
+    
+    // Build the new index off the calling thread; readers keep using the
+    // current one until it is swapped in.
+    m_updateFuture = QtConcurrent::run([this]() {
+        QFileInfo compiled(Constants::BLACKLIST_INDEX_PATH);
+        QFileInfo source(Constants::BLACKLIST_PATH);
+        
+        QString path = Constants::BLACKLIST_PATH;
+        if (compiled.exists() && (!source.exists() || compiled.lastModified() >= source.lastModified())) {
+            path = Constants::BLACKLIST_INDEX_PATH;
+        }
+        
+        std::shared_ptr<const PatternMatcher> matcher = compileBlacklist(path);
+        if (!matcher && path == Constants::BLACKLIST_INDEX_PATH && source.exists()) {
+            // A compiled index that fails validation is ignored, not trusted
+            path = Constants::BLACKLIST_PATH;
+            matcher = compileBlacklist(path);
+        }
+        if (!matcher) {
+            LOG_WARNING(LogCategory::Moderation, "Blacklist update failed, keeping current list %1", path);
+            return;
+        }
+        publishBlacklist(std::move(matcher));
+    });
+}
+
+std::shared_ptr<const PatternMatcher> ModerationEngine::compileBlacklist(const QString &filePath)
+{
+    auto matcher = std::make_shared<PatternMatcher>();
+    
+    // Precompiled indexes are mapped and used in place
+    if (PatternMatcher::isCompiledFile(filePath)) {
+        if (!matcher->mapFile(filePath)) {
+            return nullptr;
         }
+        return matcher;
     }
     
-    file.close();
-    qDebug() << "Blacklist loaded:" << m_blacklist.size() << "entries";
+    bool ok = false;
+    QStringList patterns = PatternMatcher::loadPatterns(filePath, &ok);
+    if (!ok) {
+        return nullptr;
+    }
+    matcher->build(patterns);
+    return matcher;
 }
 
-void ModerationEngine::updateBlacklist()
+void ModerationEngine::publishBlacklist(std::shared_ptr<const PatternMatcher> matcher)
 {
-    // TODO: Implement periodic blacklist updates from remote source
-    qDebug() << "Updating blacklist...";
+    const int entries = matcher->patternCount();
+    const bool mapped = matcher->isMapped();
+    std::atomic_store(&m_blacklistMatcher, std::move(matcher));
+    
+    // Cached verdicts from the previous list are now stale
+    m_blacklistGeneration.fetch_add(1, std::memory_order_release);
+    LOG_INFO(LogCategory::Moderation, "Blacklist loaded: %1 entries, mapped %2", entries, mapped);
 }
 
 bool ModerationEngine::isMaliciousLink(const QString &url) const
 {
-    // Check against local blacklist
-    for (const QString &pattern : m_blacklist) {
-        if (url.contains(pattern, Qt::CaseInsensitive)) {
-            qWarning() << "Malicious link detected:" << url;
-            return true;
-        }
+    LinkVerdict verdict = checkLink(url);
+    if (!verdict.matchedPattern.isEmpty()) {
+        LOG_WARNING(LogCategory::Moderation, "Malicious link detected: %1 matched %2", url, verdict.matchedPattern);
+    }
+    return verdict.malicious;
+}
+
+bool ModerationEngine::isSafeUrl(const QString &url) const
+{
+    return checkLink(url).safe;
+}
+
+float ModerationEngine::getReputationScore(const QString &url) const
+{
+    return checkLink(url).reputationScore;
+}
+
+LinkVerdict ModerationEngine::checkLink(const QString &url) const
+{
+    metrics().linkChecks->increment();
+    ScopedTimer timer(metrics().checkTime);
+    const QString key = VerdictCache::canonicalKey(url);
+    const quint64 generation = m_blacklistGeneration.load(std::memory_order_acquire);
+    
+    LinkVerdict verdict;
+    if (m_verdictCache.lookup(key, generation, &verdict)) {
+        metrics().cacheHits->increment();
+        return verdict;
     }
     
+    {
+        ScopedTimer evaluateTimer(metrics().evaluateTime);
+        verdict = evaluateLink(key);
+    }
+    (verdict.malicious ? metrics().malicious : metrics().clean)->increment();
+    m_verdictCache.insert(key, generation, verdict);
+    return verdict;
+}
+
+LinkVerdict ModerationEngine::evaluateLink(const QString &url) const
+{
+    LinkVerdict verdict;
+    
+    // Check against local blacklist
+    verdict.matchedPattern = findBlacklistMatch(url);
+    
     // Check trust score
-    float trustScore = getLinkTrustScore(url);
-    if (trustScore < 0.8f) {
-        return true;
+    verdict.trustScore = getLinkTrustScore(url);
+    verdict.malicious = !verdict.matchedPattern.isEmpty() || verdict.trustScore < 0.8f;
+    
+    verdict.safe = m_linkValidator->isSafeUrl(url);
+    verdict.reputationScore = m_linkValidator->calculateReputationScore(url);
+    
+    return verdict;
+}
+
+QString ModerationEngine::findBlacklistMatch(const QString &url) const
+{
+    std::shared_ptr<const PatternMatcher> matcher = std::atomic_load(&m_blacklistMatcher);
+    if (!matcher) {
+        return QString();
     }
     
-    return false;
+    PatternMatcher::Hit hit = matcher->findFirst(url);
+    return hit.isValid() ? matcher->pattern(hit.pattern) : QString();
 }
 
 float ModerationEngine::getLinkTrustScore(const QString &url) const
@@ -136,9 +290,10 @@ float ModerationEngine::getLinkTrustScore(const QString &url) const
 void ModerationEngine::initializeBlacklist()
 {
     // Initialize with some common malicious domains
-    m_blacklist << "malicious.com"
-                << "phishing.net"
-                << "scam.org";
+    QStringList blacklist;
+    blacklist << "malicious.com"
+              << "phishing.net"
+              << "scam.org";
     
     // Whitelist major domains
     m_whitelistDomains << "roblox.com"
@@ -147,5 +302,10 @@ void ModerationEngine::initializeBlacklist()
                        << "youtube.com"
                        << "github.com";
     
-    qDebug() << "ModerationEngine initialized";
+    // All patterns are matched in one pass over the URL
+    auto matcher = std::make_shared<PatternMatcher>();
+    matcher->build(blacklist);
+    publishBlacklist(std::move(matcher));
+    
+    LOG_DEBUG(LogCategory::Moderation, "ModerationEngine initialized");
 }
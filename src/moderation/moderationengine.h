@@ -4,7 +4,13 @@
 #include <QString>
 #include <QStringList>
 #include <QVector>
+#include <QFuture>
+#include <QDeadlineTimer>
 #include <memory>
+#include <atomic>
+#include "patternmatcher.h"
+#include "verdictcache.h"
+#include "include/types.h"
 
 class LinkValidator;
 
@@ -19,18 +25,40 @@ public:
     QString filterContent(const QString &content);
     QStringList extractLinks(const QString &text);
     
+    // Filters a message's links, giving up on link checks once the deadline
+    // expires; unchecked links are redacted rather than let through
+    Message moderateMessage(const Message &message, const QDeadlineTimer &deadline);
+    QString redactLinks(const QString &content);
+    
     void loadBlacklist(const QString &filePath);
     void updateBlacklist();
     
     bool isMaliciousLink(const QString &url) const;
+    bool isSafeUrl(const QString &url) const;
+    float getReputationScore(const QString &url) const;
+    LinkVerdict checkLink(const QString &url) const;
+    QString findBlacklistMatch(const QString &url) const;
     float getLinkTrustScore(const QString &url) const;
+    
+    const VerdictCache &verdictCache() const { return m_verdictCache; }
 
 private:
     std::unique_ptr<LinkValidator> m_linkValidator;
-    QStringList m_blacklist;
     QStringList m_whitelistDomains;
     
+    // Published RCU-style: readers take a reference with std::atomic_load and
+    // keep using it while a reload swaps in a new index with std::atomic_store.
+    // The old index is released once its last reader drops it.
+    std::shared_ptr<const PatternMatcher> m_blacklistMatcher;
+    QFuture<void> m_updateFuture;
+    std::atomic<quint64> m_blacklistGeneration{0};
+    
+    mutable VerdictCache m_verdictCache;
+    
     void initializeBlacklist();
+    LinkVerdict evaluateLink(const QString &url) const;
+    void publishBlacklist(std::shared_ptr<const PatternMatcher> matcher);
+    static std::shared_ptr<const PatternMatcher> compileBlacklist(const QString &filePath);
 };
 
 #endif // MODERATIONENGINE_H
@@ -0,0 +1,147 @@
+#include "moderationpipeline.h"
+#include "moderationengine.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QThread>
+#include "diagnostics/logger.h"
+#include "include/constants.h"
+
+ModerationPipeline::ModerationPipeline(QObject *parent)
+    : QObject(parent)
+    , m_engine(std::make_unique<ModerationEngine>())
+{
+    // Leave a core for the UI thread
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+
+    // A zero-interval single shot collects everything that arrives in the
+    // same event loop pass into one batch
+    m_batchTimer.setSingleShot(true);
+    m_batchTimer.setInterval(0);
+    connect(&m_batchTimer, &QTimer::timeout, this, &ModerationPipeline::dispatchBatch);
+
+    m_deadlineTimer.setInterval(DeadlineCheckIntervalMs);
+    connect(&m_deadlineTimer, &QTimer::timeout, this, &ModerationPipeline::expireOverdue);
+}
+
+ModerationPipeline::~ModerationPipeline()
+{
+    // Workers use the engine; late results are dropped with this object
+    m_pool.waitForDone();
+}
+
+int ModerationPipeline::pendingCount() const
+{
+    int count = 0;
+    for (const ChannelQueue &queue : m_channels) {
+        count += static_cast<int>(queue.entries.size());
+    }
+    return count;
+}
+
+void ModerationPipeline::submit(const Message &message)
+{
+    ChannelQueue &queue = m_channels[message.serverId];
+
+    Job job;
+    job.channel = message.serverId;
+    job.sequence = queue.nextSequence++;
+    job.message = message;
+    job.deadline = QDeadlineTimer(Constants::LINK_CHECK_TIMEOUT_MS);
+
+    queue.entries.push_back({job.sequence, message, job.deadline, false});
+    m_batch.append(std::move(job));
+
+    if (m_batch.size() >= BatchSize) {
+        dispatchBatch();
+    } else if (!m_batchTimer.isActive()) {
+        m_batchTimer.start();
+    }
+
+    if (!m_deadlineTimer.isActive()) {
+        m_deadlineTimer.start();
+    }
+}
+
+void ModerationPipeline::dispatchBatch()
+{
+    m_batchTimer.stop();
+    if (m_batch.isEmpty()) {
+        return;
+    }
+
+    QVector<Job> batch;
+    batch.swap(m_batch);
+
+    ModerationEngine *engine = m_engine.get();
+    QtConcurrent::run(&m_pool, [this, engine, batch = std::move(batch)]() mutable {
+        for (Job &job : batch) {
+            job.message = engine->moderateMessage(job.message, job.deadline);
+        }
+
+        QMetaObject::invokeMethod(this, [this, batch = std::move(batch)]() {
+            onBatchFinished(batch);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ModerationPipeline::onBatchFinished(const QVector<Job> &results)
+{
+    for (const Job &job : results) {
+        auto it = m_channels.find(job.channel);
+        if (it == m_channels.end() || it->entries.empty()) {
+            continue;
+        }
+
+        ChannelQueue &queue = it.value();
+        const quint64 first = queue.entries.front().sequence;
+        if (job.sequence < first) {
+            continue;  // Already released with links redacted after its deadline
+        }
+
+        Pending &pending = queue.entries[job.sequence - first];
+        if (!pending.done) {
+            pending.message = job.message;
+            pending.done = true;
+        }
+    }
+
+    for (ChannelQueue &queue : m_channels) {
+        releaseReady(queue);
+    }
+}
+
+void ModerationPipeline::releaseReady(ChannelQueue &queue)
+{
+    while (!queue.entries.empty() && queue.entries.front().done) {
+        Message message = std::move(queue.entries.front().message);
+        queue.entries.pop_front();
+        emit messageReady(message);
+    }
+}
+
+void ModerationPipeline::expireOverdue()
+{
+    bool pending = false;
+
+    for (ChannelQueue &queue : m_channels) {
+        // Deadlines grow with the sequence, so only the head can be overdue
+        // before anything behind it
+        while (!queue.entries.empty()) {
+            Pending &head = queue.entries.front();
+            if (!head.done && !head.deadline.hasExpired()) {
+                break;
+            }
+            if (!head.done) {
+                LOG_WARNING(LogCategory::Moderation, "Link check timed out for message %1", head.message.id);
+                head.message.content = m_engine->redactLinks(head.message.content);
+                head.message.linkUrls.clear();
+                head.done = true;
+            }
+            releaseReady(queue);
+        }
+        pending = pending || !queue.entries.empty();
+    }
+
+    if (!pending) {
+        m_deadlineTimer.stop();
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef MODERATIONPIPELINE_H
+#define MODERATIONPIPELINE_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
+#include <QThreadPool>
+#include <QDeadlineTimer>
+#include <deque>
+#include <memory>
+#include "include/types.h"
+
+class ModerationEngine;
+
+// Asynchronous moderation stage between NetworkClient::messageReceived and
+// ChatWidget::displayMessage. Incoming messages are collected into batches
+// and moderated on a worker pool; results come back to the owning thread
+// through queued calls and are released in arrival order per channel.
+// A message whose checks miss the LINK_CHECK_TIMEOUT_MS deadline is
+// delivered with its links redacted.
+class ModerationPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ModerationPipeline(QObject *parent = nullptr);
+    ~ModerationPipeline() override;
+
+    ModerationEngine *engine() const { return m_engine.get(); }
+    int pendingCount() const;
+
+public slots:
+    void submit(const Message &message);
+
+signals:
+    void messageReady(const Message &message);
+
+private:
+    struct Job {
+        QString channel;
+        quint64 sequence = 0;
+        Message message;
+        QDeadlineTimer deadline;
+    };
+
+    struct Pending {
+        quint64 sequence = 0;
+        Message message;
+        QDeadlineTimer deadline;
+        bool done = false;
+    };
+
+    struct ChannelQueue {
+        quint64 nextSequence = 0;
+        std::deque<Pending> entries;
+    };
+
+    static constexpr int BatchSize = 32;
+    static constexpr int DeadlineCheckIntervalMs = 100;
+
+    void dispatchBatch();
+    void onBatchFinished(const QVector<Job> &results);
+    void releaseReady(ChannelQueue &queue);
+    void expireOverdue();
+
+    std::unique_ptr<ModerationEngine> m_engine;
+    QThreadPool m_pool;
+
+    QVector<Job> m_batch;
+    QTimer m_batchTimer;
+    QTimer m_deadlineTimer;
+    QHash<QString, ChannelQueue> m_channels;
+};
+
+#endif // MODERATIONPIPELINE_H
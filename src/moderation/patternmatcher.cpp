@@ -0,0 +1,391 @@
+#include "patternmatcher.h"
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char FileMagic[4] = {'R', 'C', 'B', 'L'};
+constexpr quint32 FileVersion = 1;
+constexpr quint32 ByteOrderMark = 0x01020304u;
+
+struct FileHeader {
+    char magic[4];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 stateCount;
+    quint32 edgeCount;
+    quint32 patternCount;
+    quint32 poolSize;
+    quint32 reserved;
+};
+
+static_assert(sizeof(FileHeader) == 32, "FileHeader layout is part of the file format");
+
+struct BuildNode {
+    quint32 firstChild = 0xFFFFFFFFu;
+    quint32 lastChild = 0xFFFFFFFFu;
+    quint32 nextSibling = 0xFFFFFFFFu;
+    qint32 pattern = -1;
+    char16_t label = 0;
+};
+
+QString foldPattern(const QString &pattern)
+{
+    QString folded(pattern.size(), Qt::Uninitialized);
+    for (qsizetype i = 0; i < pattern.size(); ++i) {
+        folded[i] = QChar(PatternMatcher::fold(pattern.at(i).unicode()));
+    }
+    return folded;
+}
+
+} // namespace
+
+PatternMatcher::PatternMatcher() = default;
+
+PatternMatcher::~PatternMatcher() = default;
+
+void PatternMatcher::clear()
+{
+    m_ownedStates.clear();
+    m_ownedEdges.clear();
+    m_ownedPool.clear();
+    m_ownedOffsets.clear();
+    m_ownedLengths.clear();
+    m_mappedFile.reset();
+
+    m_states = nullptr;
+    m_edges = nullptr;
+    m_patternPool = nullptr;
+    m_patternOffsets = nullptr;
+    m_patternLengths = nullptr;
+    m_stateCount = 0;
+    m_patternCount = 0;
+}
+
+void PatternMatcher::attachOwnedStorage()
+{
+    m_states = m_ownedStates.data();
+    m_edges = m_ownedEdges.data();
+    m_patternPool = m_ownedPool.data();
+    m_patternOffsets = m_ownedOffsets.data();
+    m_patternLengths = m_ownedLengths.data();
+    m_stateCount = static_cast<quint32>(m_ownedStates.size());
+    m_patternCount = static_cast<quint32>(m_ownedOffsets.size());
+}
+
+void PatternMatcher::build(const QStringList &patterns)
+{
+    clear();
+
+    // Sorting the folded patterns means a node's children are created in
+    // label order, so an insert only ever has to look at the last child.
+    QStringList folded;
+    folded.reserve(patterns.size());
+    for (const QString &pattern : patterns) {
+        if (!pattern.isEmpty()) {
+            folded.append(foldPattern(pattern));
+        }
+    }
+    std::sort(folded.begin(), folded.end());
+    folded.erase(std::unique(folded.begin(), folded.end()), folded.end());
+
+    std::vector<BuildNode> nodes(1);
+    for (qsizetype p = 0; p < folded.size(); ++p) {
+        const QString &pattern = folded.at(p);
+
+        m_ownedOffsets.push_back(static_cast<quint32>(m_ownedPool.size()));
+        m_ownedLengths.push_back(static_cast<quint32>(pattern.size()));
+        m_ownedPool.insert(m_ownedPool.end(), pattern.utf16(), pattern.utf16() + pattern.size());
+
+        quint32 node = 0;
+        for (QChar ch : pattern) {
+            const char16_t c = ch.unicode();
+            const quint32 last = nodes[node].lastChild;
+            if (last != NoState && nodes[last].label == c) {
+                node = last;
+                continue;
+            }
+
+            const quint32 child = static_cast<quint32>(nodes.size());
+            nodes.emplace_back();
+            nodes[child].label = c;
+            if (last == NoState) {
+                nodes[node].firstChild = child;
+            } else {
+                nodes[last].nextSibling = child;
+            }
+            nodes[node].lastChild = child;
+            node = child;
+        }
+        nodes[node].pattern = static_cast<qint32>(p);
+    }
+
+    // Flatten in breadth-first order so each state's edges are contiguous
+    // and sorted, and every fail target precedes the states that use it.
+    m_ownedStates.resize(nodes.size());
+    m_ownedEdges.reserve(nodes.size() - 1);
+
+    std::vector<quint32> queue;
+    queue.reserve(nodes.size());
+    queue.push_back(0);
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const BuildNode &node = nodes[queue[head]];
+        State &state = m_ownedStates[head];
+        state.pattern = node.pattern;
+        state.firstEdge = static_cast<quint32>(m_ownedEdges.size());
+        for (quint32 child = node.firstChild; child != NoState; child = nodes[child].nextSibling) {
+            m_ownedEdges.push_back({static_cast<quint32>(queue.size()), nodes[child].label, 0});
+            queue.push_back(child);
+        }
+        state.edgeCount = static_cast<quint32>(m_ownedEdges.size()) - state.firstEdge;
+    }
+
+    attachOwnedStorage();
+
+    for (quint32 s = 0; s < m_stateCount; ++s) {
+        const State state = m_ownedStates[s];
+        for (quint32 e = state.firstEdge; e < state.firstEdge + state.edgeCount; ++e) {
+            const quint32 target = m_edges[e].target;
+            quint32 fail = 0;
+            if (s != 0) {
+                quint32 f = state.fail;
+                for (;;) {
+                    const quint32 next = transition(f, m_edges[e].label);
+                    if (next != NoState) {
+                        fail = next;
+                        break;
+                    }
+                    if (f == 0) {
+                        break;
+                    }
+                    f = m_states[f].fail;
+                }
+            }
+
+            m_ownedStates[target].fail = fail;
+            m_ownedStates[target].outputLink = m_ownedStates[fail].pattern >= 0
+                ? fail
+                : m_ownedStates[fail].outputLink;
+        }
+    }
+}
+
+quint32 PatternMatcher::transition(quint32 state, char16_t c) const
+{
+    const State &s = m_states[state];
+    const Edge *begin = m_edges + s.firstEdge;
+    const Edge *end = begin + s.edgeCount;
+    const Edge *it = std::lower_bound(begin, end, c, [](const Edge &edge, char16_t label) {
+        return edge.label < label;
+    });
+    return (it != end && it->label == c) ? it->target : NoState;
+}
+
+PatternMatcher::Hit PatternMatcher::findFirst(QStringView text) const
+{
+    Hit hit;
+    if (m_stateCount <= 1) {
+        return hit;
+    }
+
+    quint32 state = 0;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const char16_t c = fold(text[i].unicode());
+        for (;;) {
+            const quint32 next = transition(state, c);
+            if (next != NoState) {
+                state = next;
+                break;
+            }
+            if (state == 0) {
+                break;
+            }
+            state = m_states[state].fail;
+        }
+
+        const State &current = m_states[state];
+        if (current.pattern >= 0) {
+            hit.pattern = current.pattern;
+        } else if (current.outputLink != NoState) {
+            hit.pattern = m_states[current.outputLink].pattern;
+        }
+        if (hit.isValid()) {
+            hit.end = i + 1;
+            return hit;
+        }
+    }
+
+    return hit;
+}
+
+QString PatternMatcher::pattern(qint32 index) const
+{
+    if (index < 0 || index >= patternCount()) {
+        return QString();
+    }
+    return QString::fromUtf16(m_patternPool + m_patternOffsets[index],
+                              m_patternLengths[index]);
+}
+
+bool PatternMatcher::save(const QString &filePath) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write compiled blacklist:" << filePath;
+        return false;
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    header.byteOrder = ByteOrderMark;
+    header.stateCount = m_stateCount;
+    header.edgeCount = m_stateCount > 0 ? m_stateCount - 1 : 0;  // A trie has one edge per non-root state
+    header.patternCount = m_patternCount;
+    header.poolSize = m_patternCount > 0
+        ? m_patternOffsets[m_patternCount - 1] + m_patternLengths[m_patternCount - 1]
+        : 0;
+
+    auto writeSection = [&file](const void *data, qint64 bytes) {
+        return bytes == 0 || file.write(static_cast<const char *>(data), bytes) == bytes;
+    };
+
+    bool ok = writeSection(&header, sizeof(header))
+        && writeSection(m_states, qint64(header.stateCount) * sizeof(State))
+        && writeSection(m_edges, qint64(header.edgeCount) * sizeof(Edge))
+        && writeSection(m_patternOffsets, qint64(header.patternCount) * sizeof(quint32))
+        && writeSection(m_patternLengths, qint64(header.patternCount) * sizeof(quint32))
+        && writeSection(m_patternPool, qint64(header.poolSize) * sizeof(char16_t));
+
+    if (!ok || !file.commit()) {
+        qWarning() << "Failed writing compiled blacklist:" << filePath << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PatternMatcher::mapFile(const QString &filePath)
+{
+    auto file = std::make_unique<QFile>(filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open compiled blacklist:" << filePath;
+        return false;
+    }
+
+    const qint64 size = file->size();
+    if (size < qint64(sizeof(FileHeader))) {
+        qWarning() << "Compiled blacklist is truncated:" << filePath;
+        return false;
+    }
+
+    const uchar *base = file->map(0, size);
+    if (!base) {
+        qWarning() << "Could not map compiled blacklist:" << filePath << file->errorString();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0
+        || header.version != FileVersion
+        || header.byteOrder != ByteOrderMark
+        || header.stateCount == 0
+        || header.edgeCount != header.stateCount - 1) {
+        qWarning() << "Unsupported compiled blacklist:" << filePath;
+        return false;
+    }
+
+    const qint64 statesOffset = sizeof(FileHeader);
+    const qint64 edgesOffset = statesOffset + qint64(header.stateCount) * sizeof(State);
+    const qint64 offsetsOffset = edgesOffset + qint64(header.edgeCount) * sizeof(Edge);
+    const qint64 lengthsOffset = offsetsOffset + qint64(header.patternCount) * sizeof(quint32);
+    const qint64 poolOffset = lengthsOffset + qint64(header.patternCount) * sizeof(quint32);
+    const qint64 expectedSize = poolOffset + qint64(header.poolSize) * sizeof(char16_t);
+    if (expectedSize != size) {
+        qWarning() << "Compiled blacklist size mismatch:" << filePath;
+        return false;
+    }
+
+    clear();
+    m_states = reinterpret_cast<const State *>(base + statesOffset);
+    m_edges = reinterpret_cast<const Edge *>(base + edgesOffset);
+    m_patternOffsets = reinterpret_cast<const quint32 *>(base + offsetsOffset);
+    m_patternLengths = reinterpret_cast<const quint32 *>(base + lengthsOffset);
+    m_patternPool = reinterpret_cast<const char16_t *>(base + poolOffset);
+    m_stateCount = header.stateCount;
+    m_patternCount = header.patternCount;
+    if (!isConsistent(header.edgeCount, header.poolSize)) {
+        qWarning() << "Compiled blacklist is corrupt:" << filePath;
+        clear();
+        return false;
+    }
+    m_mappedFile = std::move(file);
+    return true;
+}
+
+bool PatternMatcher::isConsistent(quint32 edgeCount, quint32 poolSize) const
+{
+    // build() lays states out breadth-first, so edges point forward and
+    // fail and output links point backward; requiring that also rules out
+    // cycles that findFirst() would follow forever
+    for (quint32 s = 0; s < m_stateCount; ++s) {
+        const State &state = m_states[s];
+        if (quint64(state.firstEdge) + state.edgeCount > edgeCount
+            || (s != 0 && state.fail >= s)
+            || (s == 0 && state.fail != 0)
+            || (state.outputLink != NoState && (state.outputLink >= s || m_states[state.outputLink].pattern < 0))
+            || state.pattern < -1
+            || (state.pattern >= 0 && quint32(state.pattern) >= m_patternCount)) {
+            return false;
+        }
+        for (quint32 e = state.firstEdge; e < state.firstEdge + state.edgeCount; ++e) {
+            if (m_edges[e].target <= s || m_edges[e].target >= m_stateCount
+                || (e > state.firstEdge && m_edges[e - 1].label >= m_edges[e].label)) {
+                return false;
+            }
+        }
+    }
+    for (quint32 p = 0; p < m_patternCount; ++p) {
+        if (quint64(m_patternOffsets[p]) + m_patternLengths[p] > poolSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QStringList PatternMatcher::loadPatterns(const QString &filePath, bool *ok)
+{
+    QStringList patterns;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (ok) {
+            *ok = false;
+        }
+        return patterns;
+    }
+
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (!line.isEmpty() && !line.startsWith("#")) {
+            patterns.append(line);
+        }
+    }
+
+    if (ok) {
+        *ok = true;
+    }
+    return patterns;
+}
+
+bool PatternMatcher::isCompiledFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    char magic[sizeof(FileMagic)];
+    return file.read(magic, sizeof(magic)) == qint64(sizeof(magic))
+        && std::memcmp(magic, FileMagic, sizeof(FileMagic)) == 0;
+}
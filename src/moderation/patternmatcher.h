@@ -0,0 +1,105 @@
+#ifndef PATTERNMATCHER_H
+#define PATTERNMATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QFile>
+#include <memory>
+#include <vector>
+
+// Case-folded Aho-Corasick automaton over UTF-16 code units. Built once
+// from the blacklist patterns, it finds any of them in a single pass over
+// the input regardless of how many patterns were loaded.
+//
+// The automaton is stored as flat arrays so it can be written to disk with
+// save() and later memory-mapped with mapFile() and used in place, without
+// parsing or rebuilding.
+class PatternMatcher
+{
+public:
+    struct Hit {
+        qint32 pattern = -1;    // Index into the matcher's pattern table
+        qsizetype end = -1;     // Offset one past the last matched character
+
+        bool isValid() const { return pattern >= 0; }
+    };
+
+    PatternMatcher();
+    ~PatternMatcher();
+    PatternMatcher(const PatternMatcher &) = delete;
+    PatternMatcher &operator=(const PatternMatcher &) = delete;
+    PatternMatcher(PatternMatcher &&) = default;
+    PatternMatcher &operator=(PatternMatcher &&) = default;
+
+    void build(const QStringList &patterns);
+    void clear();
+
+    bool save(const QString &filePath) const;
+    bool mapFile(const QString &filePath);
+    bool isMapped() const { return m_mappedFile != nullptr; }
+
+    Hit findFirst(QStringView text) const;
+    QString pattern(qint32 index) const;
+
+    int patternCount() const { return static_cast<int>(m_patternCount); }
+    bool isEmpty() const { return m_patternCount == 0; }
+
+    // One pattern per line; blank lines and '#' comments are skipped
+    static QStringList loadPatterns(const QString &filePath, bool *ok = nullptr);
+    static bool isCompiledFile(const QString &filePath);
+
+    static inline char16_t fold(char16_t c)
+    {
+        if (c < 0x80) {
+            return (c >= u'A' && c <= u'Z') ? char16_t(c | 0x20) : c;
+        }
+        if (QChar::isSurrogate(c)) {
+            return c;
+        }
+        return static_cast<char16_t>(QChar::toCaseFolded(char32_t(c)));
+    }
+
+private:
+    static constexpr quint32 NoState = 0xFFFFFFFFu;
+
+    // On-disk layout; must stay trivially copyable and padding-free
+    struct State {
+        quint32 firstEdge = 0;
+        quint32 edgeCount = 0;
+        quint32 fail = 0;
+        quint32 outputLink = NoState;   // Nearest state on the fail chain that ends a pattern
+        qint32 pattern = -1;
+    };
+
+    struct Edge {
+        quint32 target;
+        char16_t label;
+        quint16 reserved;
+    };
+
+    quint32 transition(quint32 state, char16_t c) const;
+    void attachOwnedStorage();
+    // Checks every index in mapped arrays before the matcher trusts them
+    bool isConsistent(quint32 edgeCount, quint32 poolSize) const;
+
+    // Views used by the matcher; they point either into the owned vectors
+    // below or into the mapped file
+    const State *m_states = nullptr;
+    const Edge *m_edges = nullptr;
+    const char16_t *m_patternPool = nullptr;
+    const quint32 *m_patternOffsets = nullptr;  // Start of each pattern in the pool
+    const quint32 *m_patternLengths = nullptr;
+    quint32 m_stateCount = 0;
+    quint32 m_patternCount = 0;
+
+    std::vector<State> m_ownedStates;
+    std::vector<Edge> m_ownedEdges;
+    std::vector<char16_t> m_ownedPool;
+    std::vector<quint32> m_ownedOffsets;
+    std::vector<quint32> m_ownedLengths;
+
+    std::unique_ptr<QFile> m_mappedFile;
+};
+
+#endif // PATTERNMATCHER_H
@@ -0,0 +1,196 @@
+#include "urlscanner.h"
+
+namespace {
+
+// Matches PCRE's \s without Unicode properties, as used by the old regex
+inline bool isSpace(QChar c)
+{
+    const char16_t u = c.unicode();
+    return u == u' ' || (u >= u'\t' && u <= u'\r');
+}
+
+inline bool isDigit(QChar c)
+{
+    return c.unicode() >= u'0' && c.unicode() <= u'9';
+}
+
+// Number of ASCII digits starting at pos, stopping after max + 1
+qsizetype digitRun(QStringView text, qsizetype pos, qsizetype max)
+{
+    qsizetype n = 0;
+    while (pos + n < text.size() && n <= max && isDigit(text[pos + n])) {
+        ++n;
+    }
+    return n;
+}
+
+bool isIpv4Literal(QStringView host)
+{
+    int groups = 0;
+    qsizetype pos = 0;
+    while (pos <= host.size()) {
+        const qsizetype run = digitRun(host, pos, 3);
+        if (run < 1 || run > 3) {
+            return false;
+        }
+        ++groups;
+        pos += run;
+        if (pos == host.size()) {
+            break;
+        }
+        if (host[pos] != u'.') {
+            return false;
+        }
+        ++pos;
+    }
+    return groups == 4;
+}
+
+const char16_t *const ShortenerHosts[] = {
+    u"bit.ly", u"tinyurl.com", u"goo.gl", u"t.co", u"ow.ly",
+    u"is.gd", u"buff.ly", u"cutt.ly", u"rebrand.ly", u"shorturl.at"
+};
+
+} // namespace
+
+UrlSpanList UrlScanner::scan(QStringView text)
+{
+    UrlSpanList spans;
+    if (!mayContainUrl(text)) {
+        return spans;
+    }
+
+    // QStringView::indexOf is vectorised inside Qt, so runs of text without
+    // a ':' are skipped a register at a time
+    qsizetype pos = 0;
+    for (;;) {
+        const qsizetype colon = text.indexOf(u':', pos);
+        if (colon < 0) {
+            break;
+        }
+        pos = colon + 1;
+
+        if (colon + 3 > text.size() || text[colon + 1] != u'/' || text[colon + 2] != u'/') {
+            continue;
+        }
+
+        UrlSpan span;
+        if (colon >= 5 && text.mid(colon - 5, 5) == u"https") {
+            span.offset = colon - 5;
+            span.https = true;
+        } else if (colon >= 4 && text.mid(colon - 4, 4) == u"http") {
+            span.offset = colon - 4;
+        } else {
+            continue;
+        }
+
+        qsizetype end = colon + 3;
+        while (end < text.size() && !isSpace(text[end])) {
+            ++end;
+        }
+        if (end == colon + 3) {
+            continue;  // Scheme with nothing after it
+        }
+
+        span.length = end - span.offset;
+        describeHost(span.url(text), span);
+        spans.append(span);
+        pos = end;
+    }
+
+    return spans;
+}
+
+bool UrlScanner::mayContainUrl(QStringView text)
+{
+    // Shortest URL the old regex accepted is "http://x"
+    return text.size() >= 8 && text.contains(u':');
+}
+
+void UrlScanner::describeHost(QStringView url, UrlSpan &span)
+{
+    const qsizetype authorityStart = url.indexOf(u"://") + 3;
+    qsizetype authorityEnd = authorityStart;
+    while (authorityEnd < url.size()) {
+        const char16_t c = url[authorityEnd].unicode();
+        if (c == u'/' || c == u'?' || c == u'#') {
+            break;
+        }
+        ++authorityEnd;
+    }
+
+    QStringView authority = url.mid(authorityStart, authorityEnd - authorityStart);
+    qsizetype hostStart = authorityStart;
+    const qsizetype at = authority.lastIndexOf(u'@');
+    if (at >= 0) {
+        hostStart += at + 1;
+        authority = authority.mid(at + 1);
+    }
+
+    QStringView host;
+    if (authority.startsWith(u'[')) {
+        // IPv6 literal
+        const qsizetype close = authority.indexOf(u']');
+        host = close >= 0 ? authority.left(close + 1) : authority;
+        span.ipLiteralHost = true;
+    } else {
+        const qsizetype portColon = authority.indexOf(u':');
+        host = portColon >= 0 ? authority.left(portColon) : authority;
+        if (host.endsWith(u'.')) {
+            host.chop(1);
+        }
+        span.ipLiteralHost = isIpv4Literal(host);
+    }
+
+    span.hostOffset = hostStart;
+    span.hostLength = host.size();
+    span.labelCount = host.isEmpty() ? 0 : int(host.count(u'.')) + 1;
+    span.shortenerHost = !span.ipLiteralHost && isShortenerHost(host);
+}
+
+bool UrlScanner::containsIpv4(QStringView text)
+{
+    // Same language as \d{1,3}\.\d{1,3}\.\d{1,3}\.\d{1,3} anywhere in the
+    // text: the two middle groups are bounded by dots on both sides, the
+    // outer ones only need one digit next to their dot.
+    qsizetype pos = 0;
+    for (;;) {
+        const qsizetype dot1 = text.indexOf(u'.', pos);
+        if (dot1 < 0) {
+            return false;
+        }
+        pos = dot1 + 1;
+
+        if (dot1 == 0 || !isDigit(text[dot1 - 1])) {
+            continue;
+        }
+
+        const qsizetype run2 = digitRun(text, dot1 + 1, 3);
+        const qsizetype dot2 = dot1 + 1 + run2;
+        if (run2 < 1 || run2 > 3 || dot2 >= text.size() || text[dot2] != u'.') {
+            continue;
+        }
+
+        const qsizetype run3 = digitRun(text, dot2 + 1, 3);
+        const qsizetype dot3 = dot2 + 1 + run3;
+        if (run3 < 1 || run3 > 3 || dot3 >= text.size() || text[dot3] != u'.') {
+            continue;
+        }
+
+        if (dot3 + 1 < text.size() && isDigit(text[dot3 + 1])) {
+            return true;
+        }
+    }
+}
+
+bool UrlScanner::isShortenerHost(QStringView host)
+{
+    for (const char16_t *shortener : ShortenerHosts) {
+        const QStringView name(shortener);
+        if (host.endsWith(name, Qt::CaseInsensitive)
+            && (host.size() == name.size() || host[host.size() - name.size() - 1] == u'.')) {
+            return true;
+        }
+    }
+    return false;
+}
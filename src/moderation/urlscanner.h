@@ -0,0 +1,38 @@
+#ifndef URLSCANNER_H
+#define URLSCANNER_H
+
+#include <QStringView>
+#include <QVarLengthArray>
+
+// Single-pass, non-allocating replacement for the "https?://[^\s]+" and
+// IPv4 regular expressions used by the moderation code. Spans are views
+// into the scanned text, so nothing is copied unless the caller asks for it.
+struct UrlSpan {
+    qsizetype offset = 0;       // Start of the URL in the scanned text
+    qsizetype length = 0;
+    qsizetype hostOffset = 0;   // Relative to the start of the URL
+    qsizetype hostLength = 0;
+    bool https = false;
+    bool ipLiteralHost = false;
+    bool shortenerHost = false;
+    int labelCount = 0;
+
+    QStringView url(QStringView text) const { return text.mid(offset, length); }
+    QStringView host(QStringView text) const { return text.mid(offset + hostOffset, hostLength); }
+};
+
+using UrlSpanList = QVarLengthArray<UrlSpan, 8>;
+
+class UrlScanner
+{
+public:
+    static UrlSpanList scan(QStringView text);
+    static bool containsIpv4(QStringView text);
+    static bool isShortenerHost(QStringView host);
+
+private:
+    static bool mayContainUrl(QStringView text);
+    static void describeHost(QStringView url, UrlSpan &span);
+};
+
+#endif // URLSCANNER_H
@@ -0,0 +1,89 @@
+#include "verdictcache.h"
+#include <QMutexLocker>
+
+VerdictCache::VerdictCache(int capacity, int ttlMs)
+    : m_capacity(qMax(1, capacity))
+    , m_ttlMs(ttlMs)
+{
+    m_clock.start();
+}
+
+bool VerdictCache::lookup(const QString &key, quint64 generation, LinkVerdict *verdict)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_index.constFind(key);
+    if (it == m_index.constEnd()) {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto entry = it.value();
+    if (entry->generation != generation || entry->expiresAt <= m_clock.elapsed()) {
+        m_index.erase(it);
+        m_entries.erase(entry);
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, entry);
+    *verdict = entry->verdict;
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void VerdictCache::insert(const QString &key, quint64 generation, const LinkVerdict &verdict)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const qint64 expiresAt = m_clock.elapsed() + m_ttlMs;
+
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        auto entry = it.value();
+        entry->verdict = verdict;
+        entry->generation = generation;
+        entry->expiresAt = expiresAt;
+        m_entries.splice(m_entries.begin(), m_entries, entry);
+        return;
+    }
+
+    m_entries.push_front({key, verdict, generation, expiresAt});
+    m_index.insert(key, m_entries.begin());
+
+    while (m_index.size() > m_capacity) {
+        m_index.remove(m_entries.back().key);
+        m_entries.pop_back();
+    }
+}
+
+void VerdictCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_index.clear();
+    m_entries.clear();
+}
+
+int VerdictCache::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_index.size());
+}
+
+QString VerdictCache::canonicalKey(const QString &urlString)
+{
+    QUrl url(urlString.trimmed());
+    if (!url.isValid() || url.host().isEmpty()) {
+        return urlString.trimmed();
+    }
+
+    url.setHost(url.host().toLower());
+
+    const QString scheme = url.scheme().toLower();
+    if ((scheme == "http" && url.port() == 80) || (scheme == "https" && url.port() == 443)) {
+        url.setPort(-1);
+    }
+
+    url.setFragment(QString());
+    return url.toString();
+}
@@ -0,0 +1,61 @@
+#ifndef VERDICTCACHE_H
+#define VERDICTCACHE_H
+
+#include <QString>
+#include <QUrl>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <list>
+
+// Everything ModerationEngine decides about one link
+struct LinkVerdict {
+    bool malicious = false;
+    bool safe = false;
+    float trustScore = 0.0f;
+    float reputationScore = 0.0f;
+    QString matchedPattern;     // Blacklist pattern that hit, if any
+};
+
+// Bounded, thread-safe LRU cache of link verdicts keyed on a canonical URL.
+// Entries expire after a TTL and are also discarded when they were computed
+// against an older blacklist generation.
+class VerdictCache
+{
+public:
+    explicit VerdictCache(int capacity = 4096, int ttlMs = 10 * 60 * 1000);
+
+    bool lookup(const QString &key, quint64 generation, LinkVerdict *verdict);
+    void insert(const QString &key, quint64 generation, const LinkVerdict &verdict);
+    void clear();
+
+    int size() const;
+    int capacity() const { return m_capacity; }
+    quint64 hits() const { return m_hits.load(std::memory_order_relaxed); }
+    quint64 misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+    // Lowercased host, default port stripped, fragment removed
+    static QString canonicalKey(const QString &urlString);
+
+private:
+    struct Entry {
+        QString key;
+        LinkVerdict verdict;
+        quint64 generation = 0;
+        qint64 expiresAt = 0;
+    };
+
+    const int m_capacity;
+    const int m_ttlMs;
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_mutex;
+    std::list<Entry> m_entries;     // Most recently used first
+    QHash<QString, std::list<Entry>::iterator> m_index;
+
+    std::atomic<quint64> m_hits{0};
+    std::atomic<quint64> m_misses{0};
+};
+
+#endif // VERDICTCACHE_H
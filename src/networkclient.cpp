@@ -1,17 +1,92 @@
 #include "networkclient.h"
+#include "jsonframereader.h"
+#include "include/constants.h"
+#include "diagnostics/logger.h"
+#include "diagnostics/metrics.h"
 #include <QUrl>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QDebug>
 #include <QTimer>
 #include <QSslConfiguration>
+#include <QRandomGenerator>
+
+namespace {
+
+// Totals across every connection
+struct NetworkMetrics {
+    Counter *framesIn = MetricsRegistry::instance().counter("network.frames_in");
+    Counter *framesOut = MetricsRegistry::instance().counter("network.frames_out");
+    Counter *bytesIn = MetricsRegistry::instance().counter("network.bytes_in");
+    Counter *bytesOut = MetricsRegistry::instance().counter("network.bytes_out");
+    Counter *messagesIn = MetricsRegistry::instance().counter("network.messages_in");
+    Counter *messagesOut = MetricsRegistry::instance().counter("network.messages_out");
+    Counter *connects = MetricsRegistry::instance().counter("network.connects");
+    Counter *disconnects = MetricsRegistry::instance().counter("network.disconnects");
+    Counter *reconnects = MetricsRegistry::instance().counter("network.reconnects");
+    Gauge *queueDepth = MetricsRegistry::instance().gauge("network.send_queue_depth");
+    Gauge *bytesInFlight = MetricsRegistry::instance().gauge("network.bytes_in_flight");
+    Histogram *flushDelay = MetricsRegistry::instance().histogram("network.flush_delay_ms");
+};
+
+const NetworkMetrics &metrics()
+{
+    static const NetworkMetrics instance;
+    return instance;
+}
+
+// Bytes the text takes as UTF-8 on the wire, without encoding it
+quint64 utf8Length(const QString &text)
+{
+    quint64 bytes = 0;
+    for (const QChar c : text) {
+        const char16_t u = c.unicode();
+        // A surrogate pair is four bytes, two per half
+        bytes += u < 0x80 ? 1 : (u < 0x800 || c.isSurrogate()) ? 2 : 3;
+    }
+    return bytes;
+}
+
+} // namespace
 
 NetworkClient::NetworkClient(QObject *parent)
     : QObject(parent)
     , m_webSocket(std::make_unique<QWebSocket>())
     , m_networkManager(std::make_unique<QNetworkAccessManager>(this))
+    , m_imageTransfer(Constants::MEDIA_INCOMING_PATH)
 {
+    m_clock.start();
+    
+    m_flushTimer.setSingleShot(true);
+    connect(&m_flushTimer, &QTimer::timeout, this, &NetworkClient::flushSendQueue);
+    
+    m_drainTimer.setInterval(DrainIntervalMs);
+    connect(&m_drainTimer, &QTimer::timeout, this, &NetworkClient::drainOutbox);
+    
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, [this]() {
+        connectToServer(m_config.serverAddress, m_config.port);
+    });
+    
+    if (m_compressor.loadDictionary(Constants::COMPRESSION_DICTIONARY_PATH)) {
+        LOG_DEBUG(LogCategory::Network, "Loaded compression dictionary %1", Constants::COMPRESSION_DICTIONARY_PATH);
+    }
+    
+    connect(&m_imageTransfer, &ImageTransfer::imageReceived, this, &NetworkClient::imageReceived);
+    connect(&m_imageTransfer, &ImageTransfer::uploadProgress, this,
+            [this](const QString &, const QString &serverId, qint64 bytesAcked, qint64 totalBytes) {
+        emit imageUploadProgress(serverId, bytesAcked, totalBytes);
+    });
+    connect(&m_imageTransfer, &ImageTransfer::transferFailed, this,
+            [this](const QString &, const QString &serverId, const QString &error) {
+        emit imageTransferFailed(serverId, error);
+    });
+    
+    m_gapTimer.setInterval(GapCheckIntervalMs);
+    connect(&m_gapTimer, &QTimer::timeout, this, [this]() {
+        deliverInOrder(m_session.expireGaps());
+    });
+    
     setupWebSocket();
 }
 
@@ -20,16 +95,32 @@ NetworkClient::~NetworkClient()
     if (m_isConnected) {
         disconnect();
     }
+    
+    // Take this connection's share back out of the shared gauges
+    metrics().queueDepth->add(-m_reportedQueueDepth);
+    metrics().bytesInFlight->add(-m_reportedBytesInFlight);
 }
 
 bool NetworkClient::connectToServer(const QString &address, int port)
 {
     m_config.serverAddress = address;
     m_config.port = port;
+    m_closeRequested = false;
+    
+    // Offline messages are kept per endpoint in the shared outbox database
+    const QString endpoint = endpointKey(address, port);
+    if (!m_outbox || m_outboxEndpoint != endpoint) {
+        m_outbox = std::make_unique<Outbox>(Constants::OUTBOX_PATH, endpoint);
+        m_outboxEndpoint = endpoint;
+        m_outbox->setLimits(m_config.outboxMaxMessages, m_config.outboxMaxAgeHours * 3600 * 1000LL);
+        if (!m_outbox->open()) {
+            LOG_WARNING(LogCategory::Network, "Outbox unavailable, offline messages will be kept in memory only");
+        }
+    }
     
-    QString url = QString("wss://%1:%2").arg(address).arg(port);
+    QString url = QString("%1://%2:%3").arg(m_config.useSSL ? "wss" : "ws", address).arg(port);
     
-    qDebug() << "Connecting to:" << url;
+    LOG_INFO(LogCategory::Network, "Connecting to %1", url);
     m_webSocket->open(QUrl(url));
     
     return true;
@@ -37,53 +128,291 @@ bool NetworkClient::connectToServer(const QString &address, int port)
 
 void NetworkClient::disconnect()
 {
+    m_closeRequested = true;
+    m_reconnectTimer.stop();
     if (m_webSocket) {
         m_webSocket->close();
         m_isConnected = false;
     }
 }
 
+void NetworkClient::setConfig(const NetworkConfig &config)
+{
+    m_config = config;
+    m_maxReconnectAttempts = config.reconnectAttempts;
+    if (m_outbox) {
+        m_outbox->setLimits(m_config.outboxMaxMessages, m_config.outboxMaxAgeHours * 3600 * 1000LL);
+    }
+}
+
+QString NetworkClient::endpointKey(const QString &address, int port)
+{
+    return QStringLiteral("%1:%2").arg(address.toLower()).arg(port);
+}
+
+void NetworkClient::joinChannel(const QString &serverId)
+{
+    if (m_channels.contains(serverId)) {
+        return;
+    }
+    m_channels.append(serverId);
+    if (m_isConnected) {
+        sendControl(QStringLiteral("join"), serverId);
+        emit connected(serverId);
+    }
+}
+
+void NetworkClient::leaveChannel(const QString &serverId)
+{
+    if (!m_channels.removeOne(serverId)) {
+        return;
+    }
+    m_session.forget(serverId);
+    if (m_isConnected) {
+        sendControl(QStringLiteral("leave"), serverId);
+        emit disconnected(serverId);
+    }
+}
+
 void NetworkClient::sendMessage(const Message &message)
 {
+    Message outgoing = message;
+    if (outgoing.id.isEmpty()) {
+        // The server drops ids it has already seen, which makes replays safe
+        outgoing.id = Outbox::createMessageId();
+    }
+    
+    // While offline, and until an earlier backlog has drained, new messages
+    // go behind it in the outbox so they keep their order
+    if (hasOutbox() && (!m_isConnected || !m_outbox->isEmpty())) {
+        m_outbox->enqueue(outgoing);
+        return;
+    }
+    
+    if (m_messageQueue.isEmpty()) {
+        m_oldestQueuedAt = m_clock.elapsed();
+    }
+    m_messageQueue.enqueue(outgoing);
+    
     if (!m_isConnected) {
-        qWarning() << "Not connected to server, queueing message";
+        if (m_messageQueue.size() == 1) {
+            LOG_WARNING(LogCategory::Network, "Not connected to server, queueing messages");
+        }
+        reportQueueState();
+        return;
+    }
+    
+    scheduleFlush();
+}
+
+void NetworkClient::drainOutbox()
+{
+    if (!m_isConnected || !hasOutbox() || m_outbox->isEmpty()) {
+        m_drainTimer.stop();
+        return;
+    }
+    
+    // Wait for the previous slice to be written out, and for the socket to
+    // catch up, before pulling more; until then its rows are still stored
+    if (!m_replaying.isEmpty() || m_bytesInFlight >= m_config.sendHighWaterBytes / 2) {
+        return;
+    }
+    
+    const int slice = qMax(1, m_config.outboxDrainPerSecond * DrainIntervalMs / 1000);
+    const QVector<Message> messages = m_outbox->peek(slice);
+    if (messages.isEmpty()) {
+        return;
+    }
+    
+    if (m_messageQueue.isEmpty()) {
+        m_oldestQueuedAt = m_clock.elapsed();
+    }
+    for (const Message &message : messages) {
+        m_replaying.insert(message.id);
         m_messageQueue.enqueue(message);
+    }
+    scheduleFlush();
+}
+
+void NetworkClient::scheduleFlush()
+{
+    if (m_messageQueue.size() >= m_config.maxBatchMessages) {
+        flushSendQueue();
+    } else if (!m_flushTimer.isActive()) {
+        m_flushTimer.start(m_config.sendBatchWindowMs);
+    }
+    reportQueueState();
+}
+
+void NetworkClient::reportQueueState()
+{
+    // Gauges are shared by all connections, so each adds only its change
+    metrics().queueDepth->add(m_messageQueue.size() - m_reportedQueueDepth);
+    metrics().bytesInFlight->add(m_bytesInFlight - m_reportedBytesInFlight);
+    m_reportedQueueDepth = m_messageQueue.size();
+    m_reportedBytesInFlight = m_bytesInFlight;
+}
+
+qint64 NetworkClient::sendText(const QString &frame)
+{
+    metrics().framesOut->increment();
+    const qint64 sent = m_webSocket->sendTextMessage(frame);
+    m_bytesSent += sent;
+    return sent;
+}
+
+qint64 NetworkClient::sendBinary(const QByteArray &frame)
+{
+    metrics().framesOut->increment();
+    const qint64 sent = m_webSocket->sendBinaryMessage(frame);
+    m_bytesSent += sent;
+    return sent;
+}
+
+void NetworkClient::flushSendQueue()
+{
+    m_flushTimer.stop();
+    if (!m_isConnected || m_messageQueue.isEmpty()) {
         return;
     }
     
-    QJsonObject jsonMessage;
-    jsonMessage["type"] = "message";
-    jsonMessage["sender"] = message.sender;
-    jsonMessage["content"] = message.content;
-    jsonMessage["serverId"] = message.serverId;
-    jsonMessage["timestamp"] = message.timestamp.toString(Qt::ISODate);
+    m_lastFlushLatencyMs = m_clock.elapsed() - m_oldestQueuedAt;
+    metrics().flushDelay->record(m_lastFlushLatencyMs);
     
-    QJsonDocument doc(jsonMessage);
-    m_webSocket->sendTextMessage(QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+    // Stop at the high-water mark; onBytesWritten resumes once the socket drains
+    while (!m_messageQueue.isEmpty() && m_bytesInFlight < m_config.sendHighWaterBytes) {
+        QVector<Message> batch;
+        const int count = qMin(m_messageQueue.size(), m_config.maxBatchMessages);
+        batch.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            batch.append(m_messageQueue.dequeue());
+        }
+        m_bytesInFlight += sendBatch(batch);
+        metrics().messagesOut->increment(quint64(batch.size()));
+        m_unconfirmed.enqueue({m_bytesSent, batch});
+    }
     
-    qDebug() << "Message sent:" << message.content;
+    m_oldestQueuedAt = m_messageQueue.isEmpty() ? -1 : m_clock.elapsed();
+    emit sendQueueChanged(m_messageQueue.size(), m_bytesInFlight);
+    pumpImageChunks();
+    reportQueueState();
 }
 
-void NetworkClient::sendImage(const QString &serverId, const QByteArray &imageData)
+void NetworkClient::pumpImageChunks()
 {
-    if (!m_isConnected) {
-        qWarning() << "Not connected to server";
+    if (!m_isConnected || m_wireFormat != WireFormat::Binary || !m_messageQueue.isEmpty()) {
         return;
     }
     
-    // TODO: Implement image sending with proper encoding and validation
-    qDebug() << "Sending image to server:" << serverId;
+    // Keep at most a couple of chunks unwritten so the next chat frame
+    // waits milliseconds, not the length of an image
+    const qint64 limit = qMin<qint64>(m_config.sendHighWaterBytes / 2, 2 * ImageTransfer::ChunkSize);
+    WireProtocol::ImageChunk chunk;
+    while (m_bytesInFlight < limit && m_imageTransfer.nextChunk(&chunk)) {
+        // Image data is already compressed; deflating it again only costs CPU
+        m_bytesInFlight += sendBinary(m_wireEncoder.encodeImageChunk(chunk));
+    }
+}
+
+qint64 NetworkClient::sendBatch(const QVector<Message> &batch)
+{
+    if (m_wireFormat == WireFormat::Binary) {
+        // Binary frames carry any number of records
+        QByteArray frame = m_wireEncoder.encodeMessages(batch);
+        if (m_compressor.isActive()) {
+            frame = m_compressor.compressFrame(frame);
+        }
+        return sendBinary(frame);
+    }
+    
+    if (batch.size() > 1 && m_serverAcceptsBatch) {
+        QJsonArray messages;
+        for (const Message &message : batch) {
+            messages.append(messageToJson(message));
+        }
+        QJsonObject frame;
+        frame["type"] = "batch";
+        frame["messages"] = messages;
+        return sendText(QString::fromUtf8(QJsonDocument(frame).toJson(QJsonDocument::Compact)));
+    }
+    
+    // Older servers get one frame per message; the socket still writes them in one go
+    qint64 written = 0;
+    for (const Message &message : batch) {
+        written += sendText(QString::fromUtf8(serializeMessage(message)));
+    }
+    return written;
+}
+
+void NetworkClient::confirmWritten()
+{
+    // Replayed rows are deleted only once their whole frame is written
+    QStringList written;
+    while (!m_unconfirmed.isEmpty() && m_unconfirmed.head().endOffset <= m_bytesConfirmed) {
+        const SentBatch batch = m_unconfirmed.dequeue();
+        if (m_replaying.isEmpty()) {
+            continue;
+        }
+        for (const Message &message : batch.messages) {
+            if (m_replaying.remove(message.id)) {
+                written.append(message.id);
+            }
+        }
+    }
+    if (hasOutbox()) {
+        m_outbox->remove(written);
+    }
+}
+
+void NetworkClient::onBytesWritten(qint64 bytes)
+{
+    metrics().bytesOut->increment(quint64(bytes));
+    m_bytesInFlight = qMax<qint64>(0, m_bytesInFlight - bytes);
+    m_bytesConfirmed += bytes;
+    confirmWritten();
+    
+    // Resume at half the high-water mark so we don't flap around it
+    if (!m_messageQueue.isEmpty() && m_bytesInFlight < m_config.sendHighWaterBytes / 2) {
+        flushSendQueue();
+    } else {
+        pumpImageChunks();
+    }
+    reportQueueState();
+}
+
+QString NetworkClient::sendImage(const QString &serverId, const QString &sender, const QString &filePath,
+                                 QString *error)
+{
+    // Only refuse once the welcome has settled the protocol
+    if (m_welcomeReceived && m_wireFormat != WireFormat::Binary) {
+        if (error) {
+            *error = tr("This server does not support image transfer");
+        }
+        return QString();
+    }
+    
+    // Uploads started offline, or before the welcome, are announced once
+    // the binary protocol is up
+    const QString transferId = m_imageTransfer.startUpload(serverId, sender, filePath, error);
+    if (!transferId.isEmpty() && m_welcomeReceived) {
+        for (const WireProtocol::ImageBegin &begin : m_imageTransfer.pendingBegins()) {
+            if (begin.transferId == transferId) {
+                m_bytesInFlight += sendBinary(m_wireEncoder.encodeImageBegin(begin));
+            }
+        }
+    }
+    return transferId;
 }
 
 void NetworkClient::sendLink(const QString &serverId, const QString &url)
 {
     if (!m_isConnected) {
-        qWarning() << "Not connected to server";
+        LOG_WARNING(LogCategory::Network, "Not connected to server");
         return;
     }
     
     // TODO: Validate link before sending
-    qDebug() << "Sending link to server:" << serverId << url;
+    LOG_DEBUG(LogCategory::Network, "Sending link to server %1: %2", serverId, url);
 }
 
 bool NetworkClient::isConnected() const
@@ -101,52 +430,155 @@ void NetworkClient::setupWebSocket()
             this, &NetworkClient::onBinaryMessageReceived);
     connect(m_webSocket.get(), QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error),
             this, &NetworkClient::onError);
+    connect(m_webSocket.get(), &QWebSocket::bytesWritten, this, &NetworkClient::onBytesWritten);
 }
 
 void NetworkClient::onConnected()
 {
+    metrics().connects->increment();
     m_isConnected = true;
     m_reconnectAttempts = 0;
     
-    qDebug() << "Connected to WebSocket server";
+    LOG_INFO(LogCategory::Network, "Connected to %1", endpointKey(m_config.serverAddress, m_config.port));
+    
+    // Offer the binary protocol; JSON is used until the server accepts it
+    m_wireFormat = WireFormat::Json;
+    m_welcomeReceived = false;
+    m_serverAcceptsBatch = false;
+    m_wireEncoder.reset();
+    m_wireDecoder.reset();
+    m_compressor.stop();
+    m_bytesInFlight = 0;
+    m_bytesSent = 0;
+    m_bytesConfirmed = 0;
+    sendHello();
+    
+    // Drain whatever queued up while offline, batched and paced by the
+    // high-water mark rather than one frame per message
+    if (!m_messageQueue.isEmpty()) {
+        scheduleFlush();
+    }
+    if (hasOutbox() && !m_outbox->isEmpty()) {
+        LOG_INFO(LogCategory::Network, "Replaying %1 messages from the outbox", m_outbox->size());
+        m_drainTimer.start();
+        drainOutbox();
+    }
     
-    // Send any queued messages
-    while (!m_messageQueue.isEmpty()) {
-        sendMessage(m_messageQueue.dequeue());
+    for (const QString &channel : std::as_const(m_channels)) {
+        emit connected(channel);
     }
 }
 
 void NetworkClient::onDisconnected()
 {
+    metrics().disconnects->increment();
     m_isConnected = false;
-    qDebug() << "Disconnected from WebSocket server";
-    reconnect();
+    m_wireFormat = WireFormat::Json;
+    m_welcomeReceived = false;
+    m_drainTimer.stop();
+    m_flushTimer.stop();
+    
+    // Anything not confirmed written goes back to disk, oldest first; rows
+    // that were being replayed are still there and the duplicate inserts
+    // are ignored. The server drops ids it already received.
+    if (hasOutbox()) {
+        while (!m_unconfirmed.isEmpty()) {
+            SentBatch batch = m_unconfirmed.dequeue();
+            for (Message &message : batch.messages) {
+                m_outbox->enqueue(message);
+            }
+        }
+        while (!m_messageQueue.isEmpty()) {
+            Message message = m_messageQueue.dequeue();
+            m_outbox->enqueue(message);
+        }
+        m_outbox->commit();
+    }
+    m_unconfirmed.clear();
+    m_replaying.clear();
+    m_imageTransfer.onDisconnected();
+    reportQueueState();
+    
+    LOG_INFO(LogCategory::Network, "Disconnected from %1", endpointKey(m_config.serverAddress, m_config.port));
+    for (const QString &channel : std::as_const(m_channels)) {
+        emit disconnected(channel);
+    }
+    
+    if (!m_closeRequested) {
+        reconnect();
+    }
 }
 
 void NetworkClient::onTextMessageReceived(const QString &message)
 {
-    qDebug() << "Message received:" << message;
+    // No per-message logging here: this runs for every inbound frame
+    metrics().framesIn->increment();
+    metrics().bytesIn->increment(utf8Length(message));
     parseMessage(message);
 }
 
 void NetworkClient::onBinaryMessageReceived(const QByteArray &data)
 {
-    qDebug() << "Binary message received, size:" << data.size();
+    metrics().framesIn->increment();
+    metrics().bytesIn->increment(quint64(data.size()));
+    QByteArray payload;
+    if (!m_compressor.decompressFrame(data, &payload)) {
+        // The inflate stream is now out of step with the server's; start over
+        LOG_WARNING(LogCategory::Network, "Undecodable compressed frame, reconnecting");
+        m_webSocket->close(QWebSocketProtocol::CloseCodeProtocolError);
+        return;
+    }
+    
+    WireDecoder::Frame frame;
+    if (!m_wireDecoder.decode(payload, &frame)) {
+        // The intern tables may be half-updated; reconnect so both sides reset them
+        LOG_WARNING(LogCategory::Network, "Invalid binary frame received, size %1, reconnecting", data.size());
+        m_webSocket->close(QWebSocketProtocol::CloseCodeProtocolError);
+        return;
+    }
     
-    // TODO: Handle image and link data
+    for (const Message &msg : frame.messages) {
+        deliver(msg);
+    }
+    for (const WireDecoder::LinkValidation &result : frame.linkValidations) {
+        emit linkValidationResult(result.url, result.isMalicious);
+    }
+    handleImageRecords(frame);
+}
+
+void NetworkClient::handleImageRecords(const WireDecoder::Frame &frame)
+{
+    WireProtocol::ImageAck ack;
+    for (const WireProtocol::ImageBegin &begin : frame.imageBegins) {
+        ack = WireProtocol::ImageAck();
+        if (m_imageTransfer.onBegin(begin, &ack)) {
+            m_bytesInFlight += sendBinary(m_wireEncoder.encodeImageAck(ack));
+        }
+    }
+    for (const WireProtocol::ImageChunk &chunk : frame.imageChunks) {
+        ack = WireProtocol::ImageAck();
+        if (m_imageTransfer.onChunk(chunk, &ack)) {
+            m_bytesInFlight += sendBinary(m_wireEncoder.encodeImageAck(ack));
+        }
+    }
+    for (const WireProtocol::ImageAck &received : frame.imageAcks) {
+        m_imageTransfer.onAck(received);
+    }
+    if (!frame.imageAcks.isEmpty()) {
+        pumpImageChunks();
+    }
 }
 
 void NetworkClient::onError(QAbstractSocket::SocketError error)
 {
-    qWarning() << "WebSocket error:" << error << m_webSocket->errorString();
+    LOG_WARNING(LogCategory::Network, "WebSocket error %1: %2", error, m_webSocket->errorString());
     emit connectionError(m_webSocket->errorString());
 }
 
 void NetworkClient::onSslErrors(const QList<QSslError> &errors)
 {
-    qWarning() << "SSL Errors:";
     for (const auto &error : errors) {
-        qWarning() << error.errorString();
+        LOG_WARNING(LogCategory::Network, "SSL error: %1", error.errorString());
     }
     
     // In development, ignore SSL errors (NOT for production)
@@ -155,48 +587,152 @@ void NetworkClient::onSslErrors(const QList<QSslError> &errors)
 
 void NetworkClient::parseMessage(const QString &data)
 {
-    QJsonDocument doc = QJsonDocument::fromJson(data.toUtf8());
-    if (!doc.isObject()) {
-        qWarning() << "Invalid JSON received";
+    // Streams over the frame text once; unknown fields are skipped in place
+    JsonFrameReader::Frame frame;
+    if (!JsonFrameReader::read(data, &frame)) {
+        LOG_WARNING(LogCategory::Network, "Invalid JSON received");
         return;
     }
     
-    QJsonObject obj = doc.object();
-    QString messageType = obj["type"].toString();
+    switch (frame.type) {
+    case JsonFrameReader::FrameType::Message:
+        deliver(frame.message);
+        break;
+    case JsonFrameReader::FrameType::LinkValidation:
+        emit linkValidationResult(frame.url, frame.isMalicious);
+        break;
+    case JsonFrameReader::FrameType::Welcome:
+        m_welcomeReceived = true;
+        if (frame.protocol == WireProtocol::Name) {
+            m_wireFormat = WireFormat::Binary;
+            LOG_DEBUG(LogCategory::Network, "Server accepted binary protocol %1", WireProtocol::Name);
+            sendImageBegins();
+        } else if (m_imageTransfer.hasUploads()) {
+            m_imageTransfer.failUploads(tr("This server does not support image transfer"));
+        }
+        m_serverAcceptsBatch = frame.batch;
+        if (frame.compression == QLatin1String(FrameCompressor::Name) && m_compressor.start()) {
+            LOG_DEBUG(LogCategory::Network, "Server accepted frame compression, dictionary %1",
+                      QString::number(m_compressor.dictionaryId(), 16));
+        }
+        break;
+    case JsonFrameReader::FrameType::Unknown:
+        break;
+    }
+}
+
+QByteArray NetworkClient::serializeMessage(const Message &message) const
+{
+    return QJsonDocument(messageToJson(message)).toJson(QJsonDocument::Compact);
+}
+
+QJsonObject NetworkClient::messageToJson(const Message &message) const
+{
+    QJsonObject jsonMessage;
+    jsonMessage["type"] = "message";
+    if (!message.id.isEmpty()) {
+        jsonMessage["id"] = message.id;
+    }
+    jsonMessage["sender"] = message.sender;
+    jsonMessage["content"] = message.content;
+    jsonMessage["serverId"] = message.serverId;
+    jsonMessage["timestamp"] = message.timestamp.toString(Qt::ISODate);
+    
+    return jsonMessage;
+}
+
+void NetworkClient::sendHello()
+{
+    QJsonArray protocols;
+    if (m_config.preferBinaryProtocol) {
+        protocols.append(WireProtocol::Name);
+    }
+    protocols.append("json");
+    
+    QJsonObject hello;
+    hello["type"] = "hello";
+    hello["protocols"] = protocols;
+    hello["batch"] = true;
+    hello["channels"] = QJsonArray::fromStringList(m_channels);
+    if (m_config.preferBinaryProtocol && m_config.enableCompression && FrameCompressor::isAvailable()) {
+        // The server must hold the same dictionary, identified by its Adler-32
+        QJsonObject compression;
+        compression["name"] = FrameCompressor::Name;
+        compression["dictionary"] = QString::number(m_compressor.dictionaryId(), 16);
+        hello["compression"] = compression;
+    }
     
-    if (messageType == "message") {
-        Message msg;
-        msg.id = obj["id"].toString();
-        msg.sender = obj["sender"].toString();
-        msg.content = obj["content"].toString();
-        msg.serverId = obj["serverId"].toString();
-        msg.timestamp = QDateTime::fromString(obj["timestamp"].toString(), Qt::ISODate);
-        
-        emit messageReceived(msg);
-    } else if (messageType == "linkValidation") {
-        QString url = obj["url"].toString();
-        bool isMalicious = obj["isMalicious"].toBool();
-        emit linkValidationResult(url, isMalicious);
+    // Ask for only what was missed since the last delivered message
+    const QHash<QString, quint64> resume = m_session.lastDelivered();
+    if (!resume.isEmpty()) {
+        QJsonObject lastSequences;
+        for (auto it = resume.constBegin(); it != resume.constEnd(); ++it) {
+            lastSequences[it.key()] = qint64(it.value());
+        }
+        hello["resume"] = lastSequences;
     }
+    
+    sendText(QString::fromUtf8(QJsonDocument(hello).toJson(QJsonDocument::Compact)));
 }
 
-void NetworkClient::serializeMessage(const Message &message)
+void NetworkClient::sendControl(const QString &type, const QString &serverId)
 {
-    // Implementation handled in sendMessage()
+    QJsonObject control;
+    control["type"] = type;
+    control["serverId"] = serverId;
+    sendText(QString::fromUtf8(QJsonDocument(control).toJson(QJsonDocument::Compact)));
 }
 
-void NetworkClient::reconnect()
+void NetworkClient::sendImageBegins()
+{
+    // Uploads started offline, or cut off by a disconnect; the acks tell
+    // each one where to resume
+    for (const WireProtocol::ImageBegin &begin : m_imageTransfer.pendingBegins()) {
+        m_bytesInFlight += sendBinary(m_wireEncoder.encodeImageBegin(begin));
+    }
+}
+
+void NetworkClient::deliver(const Message &message)
 {
-    if (m_reconnectAttempts < m_maxReconnectAttempts) {
-        m_reconnectAttempts++;
-        
-        int delayMs = m_config.reconnectDelayMs * m_reconnectAttempts;
-        qDebug() << "Reconnecting in" << delayMs << "ms (attempt" << m_reconnectAttempts << ")";
-        
-        QTimer::singleShot(delayMs, this, [this]() {
-            connectToServer(m_config.serverAddress, m_config.port);
-        });
+    deliverInOrder(m_session.accept(message));
+}
+
+void NetworkClient::deliverInOrder(const QVector<Message> &messages)
+{
+    metrics().messagesIn->increment(quint64(messages.size()));
+    for (const Message &message : messages) {
+        emit messageReceived(message);
+    }
+    
+    if (m_session.hasBuffered()) {
+        if (!m_gapTimer.isActive()) {
+            m_gapTimer.start();
+        }
     } else {
-        qWarning() << "Max reconnect attempts reached";
+        m_gapTimer.stop();
     }
 }
+
+void NetworkClient::reconnect()
+{
+    if (m_maxReconnectAttempts > 0 && m_reconnectAttempts >= m_maxReconnectAttempts) {
+        LOG_WARNING(LogCategory::Network, "Max reconnect attempts reached");
+        return;
+    }
+    if (m_reconnectTimer.isActive()) {
+        return;
+    }
+    
+    m_reconnectAttempts++;
+    metrics().reconnects->increment();
+    
+    // Exponential backoff with full jitter: a uniformly random delay up to
+    // the capped exponential, so clients dropped together don't return together
+    const int exponent = qMin(m_reconnectAttempts - 1, 20);
+    const qint64 ceiling = qMin<qint64>(qint64(m_config.reconnectDelayMs) << exponent,
+                                        m_config.reconnectMaxDelayMs);
+    const int delayMs = int(QRandomGenerator::global()->bounded(ceiling + 1));
+    LOG_INFO(LogCategory::Network, "Reconnecting in %1 ms (attempt %2)", delayMs, m_reconnectAttempts);
+    
+    m_reconnectTimer.start(delayMs);
+}
@@ -5,8 +5,18 @@
 #include <QWebSocket>
 #include <QNetworkAccessManager>
 #include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSet>
 #include <memory>
 #include "include/types.h"
+#include "wireprotocol.h"
+#include "storage/outbox.h"
+#include "sessiontracker.h"
+#include "framecompressor.h"
+#include "media/imagetransfer.h"
+
+class QJsonObject;
 
 class NetworkClient : public QObject
 {
@@ -18,11 +28,34 @@ public:
 
     bool connectToServer(const QString &address, int port);
     void disconnect();
+    void setConfig(const NetworkConfig &config);
+    
+    // Channels multiplexed over this connection; announced in the hello and
+    // joined or left live while connected
+    void joinChannel(const QString &serverId);
+    void leaveChannel(const QString &serverId);
+    const QStringList &channels() const { return m_channels; }
+    
+    static QString endpointKey(const QString &address, int port);
     void sendMessage(const Message &message);
-    void sendImage(const QString &serverId, const QByteArray &imageData);
+    // Streams the file in chunks between chat frames; needs the binary
+    // protocol. Returns the transfer id, or empty with *error set.
+    QString sendImage(const QString &serverId, const QString &sender, const QString &filePath,
+                      QString *error = nullptr);
     void sendLink(const QString &serverId, const QString &url);
+    void setMediaCache(MediaCache *cache) { m_imageTransfer.setMediaCache(cache); }
     
     bool isConnected() const;
+    bool isUsingBinaryProtocol() const { return m_wireFormat == WireFormat::Binary; }
+    bool isUsingCompression() const { return m_compressor.isActive(); }
+    const FrameCompressor &compressor() const { return m_compressor; }
+    
+    // Outbound pipeline state
+    int sendQueueDepth() const { return m_messageQueue.size(); }
+    int outboxSize() const { return m_outbox ? m_outbox->size() : 0; }
+    qint64 bytesInFlight() const { return m_bytesInFlight; }
+    qint64 lastFlushLatencyMs() const { return m_lastFlushLatencyMs; }
+    const SessionTracker &session() const { return m_session; }
     const NetworkConfig &getConfig() const { return m_config; }
 
 signals:
@@ -30,8 +63,11 @@ signals:
     void disconnected(const QString &serverId);
     void messageReceived(const Message &message);
     void connectionError(const QString &error);
-    void imageReceived(const QString &serverId, const QByteArray &imageData);
+    void imageReceived(const QString &serverId, const QString &sender, const QString &mediaKey);
+    void imageUploadProgress(const QString &serverId, qint64 bytesAcked, qint64 totalBytes);
+    void imageTransferFailed(const QString &serverId, const QString &error);
     void linkValidationResult(const QString &url, bool isMalicious);
+    void sendQueueChanged(int depth, qint64 bytesInFlight);
 
 private slots:
     void onConnected();
@@ -40,10 +76,36 @@ private slots:
     void onBinaryMessageReceived(const QByteArray &data);
     void onError(QAbstractSocket::SocketError error);
     void onSslErrors(const QList<QSslError> &errors);
+    void onBytesWritten(qint64 bytes);
+    void flushSendQueue();
+    void drainOutbox();
+    void pumpImageChunks();
 
 private:
+    static constexpr int DrainIntervalMs = 100;
+    static constexpr int GapCheckIntervalMs = 250;
+    
+    enum class WireFormat {
+        Json,
+        Binary
+    };
+
     void parseMessage(const QString &data);
-    void serializeMessage(const Message &message);
+    QByteArray serializeMessage(const Message &message) const;
+    qint64 sendText(const QString &frame);
+    qint64 sendBinary(const QByteArray &frame);
+    QJsonObject messageToJson(const Message &message) const;
+    qint64 sendBatch(const QVector<Message> &batch);
+    void scheduleFlush();
+    void reportQueueState();
+    void confirmWritten();
+    bool hasOutbox() const { return m_outbox && m_outbox->isOpen(); }
+    void sendHello();
+    void sendControl(const QString &type, const QString &serverId);
+    void sendImageBegins();
+    void handleImageRecords(const WireDecoder::Frame &frame);
+    void deliver(const Message &message);
+    void deliverInOrder(const QVector<Message> &messages);
     void setupWebSocket();
     void reconnect();
 
@@ -53,9 +115,57 @@ private:
     NetworkConfig m_config;
     QQueue<Message> m_messageQueue;
     
+    // Outbound messages wait up to sendBatchWindowMs to share a frame, and
+    // flushing pauses while more than sendHighWaterBytes are unwritten
+    QTimer m_flushTimer;
+    QElapsedTimer m_clock;
+    qint64 m_oldestQueuedAt = -1;
+    qint64 m_bytesInFlight = 0;
+    qint64 m_lastFlushLatencyMs = 0;
+    qint64 m_reportedQueueDepth = 0;    // Last values added to the shared gauges
+    qint64 m_reportedBytesInFlight = 0;
+    bool m_serverAcceptsBatch = false;
+    
+    // Messages written while offline, replayed at outboxDrainPerSecond after
+    // reconnecting. Rows leave the outbox only once the socket reports their
+    // frame written; m_replaying holds the ids queued or not yet written.
+    std::unique_ptr<Outbox> m_outbox;
+    QString m_outboxEndpoint;
+    QTimer m_drainTimer;
+    QSet<QString> m_replaying;
+    
+    // Batches handed to the socket but not yet covered by bytesWritten,
+    // by their end offset in the connection's outbound byte stream. They go
+    // back to the outbox if the connection drops first.
+    struct SentBatch {
+        qint64 endOffset;
+        QVector<Message> messages;
+    };
+    QQueue<SentBatch> m_unconfirmed;
+    qint64 m_bytesSent = 0;
+    qint64 m_bytesConfirmed = 0;
+    
+    // JSON until the server accepts the binary protocol in its welcome
+    WireFormat m_wireFormat = WireFormat::Json;
+    bool m_welcomeReceived = false;
+    WireEncoder m_wireEncoder;
+    FrameCompressor m_compressor;
+    WireDecoder m_wireDecoder;
+    
+    // Image chunks only go out while no chat messages are waiting and the
+    // socket is nearly drained, so a message never queues behind an image
+    ImageTransfer m_imageTransfer;
+    
     bool m_isConnected = false;
+    bool m_closeRequested = false;
+    QStringList m_channels;
     int m_reconnectAttempts = 0;
-    int m_maxReconnectAttempts = 5;
+    QTimer m_reconnectTimer;
+    
+    // Inbound ordering and the resume point sent in the hello
+    SessionTracker m_session;
+    QTimer m_gapTimer;
+    int m_maxReconnectAttempts = 0;     // 0 retries indefinitely
 };
 
 #endif // NETWORKCLIENT_H
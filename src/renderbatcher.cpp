@@ -0,0 +1,46 @@
+#include "renderbatcher.h"
+#include "include/constants.h"
+
+RenderBatcher::RenderBatcher(QObject *parent)
+    : QObject(parent)
+{
+    // Started by the first message after a commit, so an idle tab costs nothing
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(Constants::CHAT_REFRESH_RATE_MS);
+    connect(&m_timer, &QTimer::timeout, this, &RenderBatcher::flush);
+}
+
+void RenderBatcher::enqueue(const Message &message)
+{
+    m_pending.append(message);
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void RenderBatcher::flush()
+{
+    m_timer.stop();
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    QVector<Message> batch;
+    batch.swap(m_pending);
+
+    ++m_commitCount;
+    m_committedMessages += batch.size();
+    m_lastCommitSize = batch.size();
+
+    emit commitReady(batch);
+}
+
+void RenderBatcher::setInterval(int intervalMs)
+{
+    m_timer.setInterval(qMax(0, intervalMs));
+}
+
+double RenderBatcher::averageMessagesPerCommit() const
+{
+    return m_commitCount == 0 ? 0.0 : double(m_committedMessages) / double(m_commitCount);
+}
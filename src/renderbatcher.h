@@ -0,0 +1,44 @@
+#ifndef RENDERBATCHER_H
+#define RENDERBATCHER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include "include/types.h"
+
+// Collects messages for one chat tab and hands them to the view in a
+// single commit per refresh tick, so a burst of messages costs one model
+// update, one relayout and one scroll instead of one per message.
+class RenderBatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenderBatcher(QObject *parent = nullptr);
+
+    void enqueue(const Message &message);
+    void flush();
+
+    int interval() const { return m_timer.interval(); }
+    void setInterval(int intervalMs);
+    int pendingCount() const { return m_pending.size(); }
+
+    // Messages-per-commit metric
+    quint64 commitCount() const { return m_commitCount; }
+    quint64 committedMessages() const { return m_committedMessages; }
+    int lastCommitSize() const { return m_lastCommitSize; }
+    double averageMessagesPerCommit() const;
+
+signals:
+    void commitReady(const QVector<Message> &messages);
+
+private:
+    QVector<Message> m_pending;
+    QTimer m_timer;
+
+    quint64 m_commitCount = 0;
+    quint64 m_committedMessages = 0;
+    int m_lastCommitSize = 0;
+};
+
+#endif // RENDERBATCHER_H
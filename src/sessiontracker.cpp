@@ -0,0 +1,111 @@
+#include "sessiontracker.h"
+#include <QDebug>
+
+SessionTracker::SessionTracker()
+{
+    m_clock.start();
+}
+
+QVector<Message> SessionTracker::accept(const Message &message)
+{
+    QVector<Message> out;
+    if (message.sequence == 0) {
+        out.append(message);
+        return out;
+    }
+
+    Channel &channel = m_channels[message.serverId];
+
+    // The first message seen on a channel sets the baseline
+    if (channel.lastDelivered == 0 && channel.early.empty()) {
+        channel.lastDelivered = message.sequence;
+        out.append(message);
+        return out;
+    }
+
+    if (message.sequence <= channel.lastDelivered || channel.early.count(message.sequence)) {
+        ++m_duplicates;
+        return out;
+    }
+
+    if (message.sequence == channel.lastDelivered + 1) {
+        channel.lastDelivered = message.sequence;
+        out.append(message);
+        releaseContiguous(channel, out);
+        return out;
+    }
+
+    // Ahead of a gap: hold it until the gap fills
+    if (channel.early.empty()) {
+        channel.gapSince = m_clock.elapsed();
+    }
+    channel.early.emplace(message.sequence, message);
+    ++m_buffered;
+
+    if (static_cast<int>(channel.early.size()) > MaxBufferedPerChannel) {
+        skipGap(channel, out);
+    }
+    return out;
+}
+
+QVector<Message> SessionTracker::expireGaps()
+{
+    QVector<Message> out;
+    if (m_buffered == 0) {
+        return out;
+    }
+
+    const qint64 now = m_clock.elapsed();
+    for (Channel &channel : m_channels) {
+        while (!channel.early.empty() && now - channel.gapSince >= GapTimeoutMs) {
+            skipGap(channel, out);
+        }
+    }
+    return out;
+}
+
+QHash<QString, quint64> SessionTracker::lastDelivered() const
+{
+    QHash<QString, quint64> result;
+    for (auto it = m_channels.constBegin(); it != m_channels.constEnd(); ++it) {
+        if (it->lastDelivered != 0) {
+            result.insert(it.key(), it->lastDelivered);
+        }
+    }
+    return result;
+}
+
+void SessionTracker::forget(const QString &channel)
+{
+    auto it = m_channels.find(channel);
+    if (it != m_channels.end()) {
+        m_buffered -= static_cast<int>(it->early.size());
+        m_channels.erase(it);
+    }
+}
+
+void SessionTracker::releaseContiguous(Channel &channel, QVector<Message> &out)
+{
+    auto it = channel.early.begin();
+    while (it != channel.early.end() && it->first == channel.lastDelivered + 1) {
+        channel.lastDelivered = it->first;
+        out.append(std::move(it->second));
+        it = channel.early.erase(it);
+        --m_buffered;
+        ++m_reordered;
+    }
+    if (!channel.early.empty()) {
+        channel.gapSince = m_clock.elapsed();
+    }
+}
+
+void SessionTracker::skipGap(Channel &channel, QVector<Message> &out)
+{
+    auto first = channel.early.begin();
+    qWarning() << "Skipping missing messages" << channel.lastDelivered + 1 << "to" << first->first - 1
+               << "on channel" << first->second.serverId;
+    ++m_gapsSkipped;
+
+    channel.lastDelivered = first->first - 1;
+    releaseContiguous(channel, out);
+}
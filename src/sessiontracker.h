@@ -0,0 +1,58 @@
+#ifndef SESSIONTRACKER_H
+#define SESSIONTRACKER_H
+
+#include <QHash>
+#include <QElapsedTimer>
+#include <QVector>
+#include <map>
+#include "include/types.h"
+
+// Per-channel delivery state for one connection. Remembers the last
+// sequence number delivered on each channel so a reconnect can ask the
+// server for just the gap, and puts inbound messages back in order:
+// duplicates are dropped and early arrivals wait until the gap before them
+// fills or times out.
+class SessionTracker
+{
+public:
+    static constexpr int GapTimeoutMs = 2000;
+    static constexpr int MaxBufferedPerChannel = 512;
+
+    SessionTracker();
+
+    // Returns the messages that can be delivered now, in order
+    QVector<Message> accept(const Message &message);
+
+    // Gives up on gaps older than GapTimeoutMs and returns what was waiting
+    // behind them
+    QVector<Message> expireGaps();
+    bool hasBuffered() const { return m_buffered > 0; }
+
+    // Last delivered sequence per channel, for the resume request
+    QHash<QString, quint64> lastDelivered() const;
+    void forget(const QString &channel);
+
+    quint64 duplicatesDropped() const { return m_duplicates; }
+    quint64 reordered() const { return m_reordered; }
+    quint64 gapsSkipped() const { return m_gapsSkipped; }
+
+private:
+    struct Channel {
+        quint64 lastDelivered = 0;          // 0 until the first sequenced message
+        std::map<quint64, Message> early;   // Arrived ahead of a gap
+        qint64 gapSince = 0;
+    };
+
+    void releaseContiguous(Channel &channel, QVector<Message> &out);
+    void skipGap(Channel &channel, QVector<Message> &out);
+
+    QHash<QString, Channel> m_channels;
+    QElapsedTimer m_clock;
+    int m_buffered = 0;
+
+    quint64 m_duplicates = 0;
+    quint64 m_reordered = 0;
+    quint64 m_gapsSkipped = 0;
+};
+
+#endif // SESSIONTRACKER_H
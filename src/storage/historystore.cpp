@@ -0,0 +1,313 @@
+#include "historystore.h"
+#include "outbox.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+
+// Owns the connection; lives on, and is only touched from, m_thread
+class HistoryStore::Worker : public QObject
+{
+public:
+    explicit Worker(const QString &databasePath)
+        : m_path(databasePath)
+    {
+    }
+
+    ~Worker() override
+    {
+        if (m_database.isValid()) {
+            m_database.close();
+            m_database = QSqlDatabase();
+            QSqlDatabase::removeDatabase(QString::fromLatin1(ConnectionName));
+        }
+    }
+
+    bool open();
+    void write(const QVector<Message> &messages);
+    QVector<Message> page(const QString &serverId, const HistoryCursor &cursor, int limit, bool older);
+    QVector<Message> search(const QString &serverId, const QString &text, int limit);
+
+private:
+    static constexpr const char *ConnectionName = "history";
+
+    bool exec(const QString &statement);
+    static Message readMessage(const QSqlQuery &query);
+
+    QString m_path;
+    QSqlDatabase m_database;
+    bool m_fullTextSearch = false;
+};
+
+bool HistoryStore::Worker::open()
+{
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    m_database = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QString::fromLatin1(ConnectionName));
+    m_database.setDatabaseName(m_path);
+    if (!m_database.open()) {
+        qWarning() << "Failed to open history store:" << m_database.lastError().text();
+        return false;
+    }
+
+    exec(QStringLiteral("PRAGMA journal_mode=WAL"));
+    exec(QStringLiteral("PRAGMA synchronous=NORMAL"));
+
+    // (server_id, timestamp, id) serves both paging directions without a sort
+    if (!exec(QStringLiteral(
+            "CREATE TABLE IF NOT EXISTS messages ("
+            " rowid INTEGER PRIMARY KEY,"
+            " id TEXT NOT NULL UNIQUE,"
+            " server_id TEXT NOT NULL,"
+            " sender TEXT NOT NULL,"
+            " content TEXT NOT NULL,"
+            " timestamp INTEGER NOT NULL)"))
+        || !exec(QStringLiteral(
+            "CREATE INDEX IF NOT EXISTS messages_channel_time ON messages(server_id, timestamp, id)"))) {
+        m_database.close();
+        return false;
+    }
+
+    // External-content FTS table kept in step by triggers, so the text is
+    // stored once
+    m_fullTextSearch = exec(QStringLiteral(
+            "CREATE VIRTUAL TABLE IF NOT EXISTS messages_fts USING fts5("
+            " content, content='messages', content_rowid='rowid')"))
+        && exec(QStringLiteral(
+            "CREATE TRIGGER IF NOT EXISTS messages_ai AFTER INSERT ON messages BEGIN"
+            " INSERT INTO messages_fts(rowid, content) VALUES (new.rowid, new.content); END"))
+        && exec(QStringLiteral(
+            "CREATE TRIGGER IF NOT EXISTS messages_ad AFTER DELETE ON messages BEGIN"
+            " INSERT INTO messages_fts(messages_fts, rowid, content)"
+            " VALUES ('delete', old.rowid, old.content); END"));
+    if (!m_fullTextSearch) {
+        qWarning() << "SQLite FTS5 unavailable, history search disabled";
+    }
+
+    return true;
+}
+
+void HistoryStore::Worker::write(const QVector<Message> &messages)
+{
+    if (!m_database.isOpen()) {
+        return;
+    }
+
+    m_database.transaction();
+    QSqlQuery insert(m_database);
+    insert.prepare(QStringLiteral(
+        "INSERT OR IGNORE INTO messages (id, server_id, sender, content, timestamp)"
+        " VALUES (?, ?, ?, ?, ?)"));
+    for (const Message &message : messages) {
+        insert.addBindValue(message.id);
+        insert.addBindValue(message.serverId);
+        insert.addBindValue(message.sender);
+        insert.addBindValue(message.content);
+        insert.addBindValue(message.timestamp.toMSecsSinceEpoch());
+        if (!insert.exec()) {
+            qWarning() << "History insert failed:" << insert.lastError().text();
+        }
+    }
+    if (!m_database.commit()) {
+        qWarning() << "History commit failed:" << m_database.lastError().text();
+        m_database.rollback();
+    }
+}
+
+QVector<Message> HistoryStore::Worker::page(const QString &serverId, const HistoryCursor &cursor,
+                                            int limit, bool older)
+{
+    QVector<Message> messages;
+    if (!m_database.isOpen()) {
+        return messages;
+    }
+
+    QSqlQuery query(m_database);
+    query.prepare(older
+        ? QStringLiteral(
+            "SELECT id, server_id, sender, content, timestamp FROM messages"
+            " WHERE server_id = ? AND (timestamp < ? OR (timestamp = ? AND id < ?))"
+            " ORDER BY timestamp DESC, id DESC LIMIT ?")
+        : QStringLiteral(
+            "SELECT id, server_id, sender, content, timestamp FROM messages"
+            " WHERE server_id = ? AND (timestamp > ? OR (timestamp = ? AND id > ?))"
+            " ORDER BY timestamp ASC, id ASC LIMIT ?"));
+    query.addBindValue(serverId);
+    query.addBindValue(cursor.timestampMs);
+    query.addBindValue(cursor.timestampMs);
+    query.addBindValue(cursor.id);
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        qWarning() << "History page query failed:" << query.lastError().text();
+        return messages;
+    }
+
+    messages.reserve(limit);
+    while (query.next()) {
+        messages.append(readMessage(query));
+    }
+    if (older) {
+        std::reverse(messages.begin(), messages.end());
+    }
+    return messages;
+}
+
+QVector<Message> HistoryStore::Worker::search(const QString &serverId, const QString &text, int limit)
+{
+    QVector<Message> results;
+    if (!m_fullTextSearch || text.trimmed().isEmpty()) {
+        return results;
+    }
+
+    // Search for the text as one phrase rather than as FTS query syntax
+    const QString phrase = QLatin1Char('"') + QString(text).replace(QLatin1Char('"'), QStringLiteral("\"\"")) + QLatin1Char('"');
+
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral(
+        "SELECT m.id, m.server_id, m.sender, m.content, m.timestamp"
+        " FROM messages_fts JOIN messages m ON m.rowid = messages_fts.rowid"
+        " WHERE messages_fts MATCH ? AND m.server_id = ?"
+        " ORDER BY m.timestamp DESC LIMIT ?"));
+    query.addBindValue(phrase);
+    query.addBindValue(serverId);
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        qWarning() << "History search failed:" << query.lastError().text();
+        return results;
+    }
+
+    while (query.next()) {
+        results.append(readMessage(query));
+    }
+    return results;
+}
+
+Message HistoryStore::Worker::readMessage(const QSqlQuery &query)
+{
+    Message message;
+    message.id = query.value(0).toString();
+    message.serverId = query.value(1).toString();
+    message.sender = query.value(2).toString();
+    message.content = query.value(3).toString();
+    message.timestamp = QDateTime::fromMSecsSinceEpoch(query.value(4).toLongLong());
+    return message;
+}
+
+bool HistoryStore::Worker::exec(const QString &statement)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec(statement)) {
+        qWarning() << "History statement failed:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+HistoryStore::HistoryStore(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+    , m_worker(new Worker(databasePath))
+{
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.setObjectName(QStringLiteral("HistoryStore"));
+    m_thread.start();
+
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [worker]() { worker->open(); }, Qt::QueuedConnection);
+
+    m_writeTimer.setSingleShot(true);
+    m_writeTimer.setInterval(WriteBatchMs);
+    connect(&m_writeTimer, &QTimer::timeout, this, &HistoryStore::flush);
+}
+
+HistoryStore::~HistoryStore()
+{
+    // Wait for the final batch; quit() alone would drop queued work
+    flush();
+    QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void HistoryStore::append(const Message &message)
+{
+    Message stored = message;
+    if (stored.id.isEmpty()) {
+        stored.id = Outbox::createMessageId();
+    }
+    if (!stored.timestamp.isValid()) {
+        stored.timestamp = QDateTime::currentDateTime();
+    }
+
+    m_pendingWrites.append(std::move(stored));
+    if (m_pendingWrites.size() >= MaxWriteBatch) {
+        flush();
+    } else if (!m_writeTimer.isActive()) {
+        m_writeTimer.start();
+    }
+}
+
+void HistoryStore::flush()
+{
+    m_writeTimer.stop();
+    if (m_pendingWrites.isEmpty()) {
+        return;
+    }
+
+    Worker *worker = m_worker;
+    QVector<Message> batch;
+    batch.swap(m_pendingWrites);
+    QMetaObject::invokeMethod(m_worker, [worker, batch = std::move(batch)]() {
+        worker->write(batch);
+    }, Qt::QueuedConnection);
+}
+
+quint64 HistoryStore::requestOlder(const QString &serverId, const HistoryCursor &before, int limit)
+{
+    return requestPage(serverId, before, limit, true);
+}
+
+quint64 HistoryStore::requestNewer(const QString &serverId, const HistoryCursor &after, int limit)
+{
+    return requestPage(serverId, after, limit, false);
+}
+
+quint64 HistoryStore::requestPage(const QString &serverId, const HistoryCursor &cursor, int limit, bool older)
+{
+    // Queued behind any buffered writes, so the page sees them
+    flush();
+
+    HistoryPage request;
+    request.requestId = m_nextRequestId++;
+    request.serverId = serverId;
+    request.older = older;
+
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [this, worker, request, cursor, limit]() mutable {
+        request.messages = worker->page(request.serverId, cursor, limit, request.older);
+        request.complete = request.messages.size() < limit;
+        QMetaObject::invokeMethod(this, [this, page = std::move(request)]() {
+            emit pageLoaded(page);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+
+    return request.requestId;
+}
+
+quint64 HistoryStore::search(const QString &serverId, const QString &text, int limit)
+{
+    flush();
+
+    const quint64 requestId = m_nextRequestId++;
+    Worker *worker = m_worker;
+    QMetaObject::invokeMethod(m_worker, [this, worker, requestId, serverId, text, limit]() {
+        QVector<Message> results = worker->search(serverId, text, limit);
+        QMetaObject::invokeMethod(this, [this, requestId, results = std::move(results)]() {
+            emit searchFinished(requestId, results);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+
+    return requestId;
+}
@@ -0,0 +1,73 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <limits>
+#include "include/types.h"
+
+// Position in a channel's history. Messages are ordered by (timestamp, id),
+// so a cursor taken from any displayed message is enough to page from it.
+struct HistoryCursor {
+    qint64 timestampMs = std::numeric_limits<qint64>::max();
+    QString id;
+
+    static HistoryCursor of(const Message &message)
+    {
+        return {message.timestamp.toMSecsSinceEpoch(), message.id};
+    }
+};
+
+struct HistoryPage {
+    quint64 requestId = 0;
+    QString serverId;
+    bool older = true;              // Direction relative to the cursor
+    QVector<Message> messages;      // Oldest first
+    bool complete = false;          // Nothing further in this direction
+};
+
+// Persistent chat history in SQLite, with an FTS5 index over message
+// content. All database work runs on a dedicated thread: writes are
+// buffered here and handed over in batches, and page loads and searches
+// answer asynchronously through signals.
+class HistoryStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryStore(const QString &databasePath, QObject *parent = nullptr);
+    ~HistoryStore();
+
+    void append(const Message &message);
+    void flush();
+
+    // Pages strictly before or after the cursor; a default cursor asks
+    // for the newest messages in the channel
+    quint64 requestOlder(const QString &serverId, const HistoryCursor &before, int limit);
+    quint64 requestNewer(const QString &serverId, const HistoryCursor &after, int limit);
+
+    // Full-text search within one channel, newest matches first
+    quint64 search(const QString &serverId, const QString &text, int limit);
+
+signals:
+    void pageLoaded(const HistoryPage &page);
+    void searchFinished(quint64 requestId, const QVector<Message> &results);
+
+private:
+    class Worker;
+
+    static constexpr int WriteBatchMs = 200;
+    static constexpr int MaxWriteBatch = 500;
+
+    quint64 requestPage(const QString &serverId, const HistoryCursor &cursor, int limit, bool older);
+
+    QThread m_thread;
+    Worker *m_worker;
+    QTimer m_writeTimer;
+    QVector<Message> m_pendingWrites;
+    quint64 m_nextRequestId = 1;
+};
+
+#endif // HISTORYSTORE_H
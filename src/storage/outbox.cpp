@@ -0,0 +1,248 @@
+#include "outbox.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QUuid>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+Outbox::Outbox(const QString &databasePath, const QString &endpoint, QObject *parent)
+    : QObject(parent)
+    , m_endpoint(endpoint)
+    , m_connectionName(QStringLiteral("outbox-%1").arg(createMessageId()))
+{
+    m_database = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionName);
+    m_database.setDatabaseName(databasePath);
+
+    m_commitTimer.setSingleShot(true);
+    m_commitTimer.setInterval(GroupCommitMs);
+    connect(&m_commitTimer, &QTimer::timeout, this, &Outbox::commit);
+}
+
+Outbox::~Outbox()
+{
+    commit();
+    m_database.close();
+    m_database = QSqlDatabase();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool Outbox::open()
+{
+    if (m_database.isOpen()) {
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(m_database.databaseName()).absolutePath());
+    if (!m_database.open()) {
+        qWarning() << "Failed to open outbox:" << m_database.lastError().text();
+        return false;
+    }
+
+    // WAL lets the group commit append without rewriting pages, and NORMAL
+    // sync is still durable across an application crash
+    exec(QStringLiteral("PRAGMA journal_mode=WAL"));
+    exec(QStringLiteral("PRAGMA synchronous=NORMAL"));
+
+    if (!exec(QStringLiteral(
+            "CREATE TABLE IF NOT EXISTS outbox ("
+            " seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+            " id TEXT NOT NULL UNIQUE,"
+            " endpoint TEXT NOT NULL,"
+            " server_id TEXT NOT NULL,"
+            " sender TEXT NOT NULL,"
+            " content TEXT NOT NULL,"
+            " timestamp INTEGER NOT NULL,"
+            " queued_at INTEGER NOT NULL)"))
+        || !exec(QStringLiteral("CREATE INDEX IF NOT EXISTS outbox_endpoint ON outbox(endpoint, seq)"))) {
+        m_database.close();
+        return false;
+    }
+
+    m_storedCount = countRows();
+    prune();
+
+    if (m_storedCount > 0) {
+        qDebug() << "Outbox restored" << m_storedCount << "unsent messages";
+    }
+    return true;
+}
+
+void Outbox::setLimits(int maxMessages, qint64 maxAgeMs)
+{
+    m_maxMessages = qMax(1, maxMessages);
+    m_maxAgeMs = maxAgeMs;
+}
+
+QString Outbox::createMessageId()
+{
+    return QUuid::createUuid().toString(QUuid::WithoutBraces);
+}
+
+void Outbox::enqueue(Message &message)
+{
+    if (message.id.isEmpty()) {
+        message.id = createMessageId();
+    }
+
+    m_pending.append(message);
+    if (m_pending.size() >= MaxPendingRows) {
+        commit();
+    } else if (!m_commitTimer.isActive()) {
+        m_commitTimer.start();
+    }
+}
+
+void Outbox::commit()
+{
+    m_commitTimer.stop();
+    if (m_pending.isEmpty() || !open()) {
+        return;
+    }
+
+    // One transaction for everything buffered since the last commit
+    m_database.transaction();
+    QSqlQuery insert(m_database);
+    insert.prepare(QStringLiteral(
+        "INSERT OR IGNORE INTO outbox (id, endpoint, server_id, sender, content, timestamp, queued_at)"
+        " VALUES (?, ?, ?, ?, ?, ?, ?)"));
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int inserted = 0;
+    QVector<Message> failed;
+    for (const Message &message : std::as_const(m_pending)) {
+        insert.addBindValue(message.id);
+        insert.addBindValue(m_endpoint);
+        insert.addBindValue(message.serverId);
+        insert.addBindValue(message.sender);
+        insert.addBindValue(message.content);
+        insert.addBindValue(message.timestamp.isValid() ? message.timestamp.toMSecsSinceEpoch() : now);
+        insert.addBindValue(now);
+        if (!insert.exec()) {
+            qWarning() << "Outbox insert failed:" << insert.lastError().text();
+            failed.append(message);
+            continue;
+        }
+        inserted += insert.numRowsAffected();
+    }
+
+    if (!m_database.commit()) {
+        qWarning() << "Outbox commit failed:" << m_database.lastError().text();
+        m_database.rollback();
+        return;
+    }
+
+    // Rows that failed to insert wait for the next commit
+    m_pending = std::move(failed);
+    m_storedCount += inserted;
+    prune();
+}
+
+QVector<Message> Outbox::peek(int limit)
+{
+    commit();
+
+    QVector<Message> messages;
+    if (!m_database.isOpen() || m_storedCount == 0 || limit <= 0) {
+        return messages;
+    }
+
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral(
+        "SELECT id, server_id, sender, content, timestamp FROM outbox"
+        " WHERE endpoint = ? ORDER BY seq LIMIT ?"));
+    query.addBindValue(m_endpoint);
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        qWarning() << "Outbox read failed:" << query.lastError().text();
+        return messages;
+    }
+
+    messages.reserve(qMin(limit, m_storedCount));
+    while (query.next()) {
+        Message message;
+        message.id = query.value(0).toString();
+        message.serverId = query.value(1).toString();
+        message.sender = query.value(2).toString();
+        message.content = query.value(3).toString();
+        message.timestamp = QDateTime::fromMSecsSinceEpoch(query.value(4).toLongLong());
+        messages.append(std::move(message));
+    }
+    return messages;
+}
+
+void Outbox::remove(const QStringList &ids)
+{
+    if (ids.isEmpty() || !m_database.isOpen()) {
+        return;
+    }
+
+    m_database.transaction();
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral("DELETE FROM outbox WHERE id = ?"));
+    int removed = 0;
+    for (const QString &id : ids) {
+        query.addBindValue(id);
+        if (query.exec()) {
+            removed += query.numRowsAffected();
+        }
+    }
+    m_database.commit();
+
+    m_storedCount = qMax(0, m_storedCount - removed);
+}
+
+void Outbox::prune()
+{
+    if (m_storedCount == 0) {
+        return;
+    }
+
+    bool pruned = false;
+    if (m_maxAgeMs > 0) {
+        QSqlQuery query(m_database);
+        query.prepare(QStringLiteral("DELETE FROM outbox WHERE endpoint = ? AND queued_at < ?"));
+        query.addBindValue(m_endpoint);
+        query.addBindValue(QDateTime::currentMSecsSinceEpoch() - m_maxAgeMs);
+        pruned |= query.exec() && query.numRowsAffected() > 0;
+    }
+
+    if (m_storedCount > m_maxMessages) {
+        // Keep the newest m_maxMessages rows
+        QSqlQuery query(m_database);
+        query.prepare(QStringLiteral(
+            "DELETE FROM outbox WHERE endpoint = ? AND seq <= "
+            "(SELECT seq FROM outbox WHERE endpoint = ? ORDER BY seq DESC LIMIT 1 OFFSET ?)"));
+        query.addBindValue(m_endpoint);
+        query.addBindValue(m_endpoint);
+        query.addBindValue(m_maxMessages);
+        pruned |= query.exec() && query.numRowsAffected() > 0;
+    }
+
+    if (pruned) {
+        const int before = m_storedCount;
+        m_storedCount = countRows();
+        qWarning() << "Outbox dropped" << before - m_storedCount << "messages past its size or age limit";
+    }
+}
+
+int Outbox::countRows()
+{
+    QSqlQuery query(m_database);
+    query.prepare(QStringLiteral("SELECT COUNT(*) FROM outbox WHERE endpoint = ?"));
+    query.addBindValue(m_endpoint);
+    if (query.exec() && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+bool Outbox::exec(const QString &statement)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec(statement)) {
+        qWarning() << "Outbox statement failed:" << statement << query.lastError().text();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QTimer>
+#include <QVector>
+#include "include/types.h"
+
+// Durable store for messages that could not be sent yet. Rows live in a
+// WAL-mode SQLite database so they survive a crash or restart. Inserts are
+// buffered and committed together, and each row is keyed on the client
+// message id so replaying the same message twice is harmless. Several
+// connections can share one database; each only sees its own endpoint's rows.
+class Outbox : public QObject
+{
+    Q_OBJECT
+
+public:
+    Outbox(const QString &databasePath, const QString &endpoint, QObject *parent = nullptr);
+    ~Outbox();
+
+    bool open();
+    bool isOpen() const { return m_database.isOpen(); }
+
+    // Oldest messages are dropped past either limit
+    void setLimits(int maxMessages, qint64 maxAgeMs);
+
+    // Assigns a client id when the message has none
+    void enqueue(Message &message);
+
+    // Oldest first; pending inserts are committed before reading
+    QVector<Message> peek(int limit);
+    void remove(const QStringList &ids);
+
+    int size() const { return m_storedCount + m_pending.size(); }
+    bool isEmpty() const { return size() == 0; }
+
+    static QString createMessageId();
+
+public slots:
+    void commit();
+
+private:
+    static constexpr int GroupCommitMs = 25;
+    static constexpr int MaxPendingRows = 256;
+
+    bool exec(const QString &statement);
+    void prune();
+    int countRows();
+
+    QString m_endpoint;
+    QString m_connectionName;
+    QSqlDatabase m_database;
+    QTimer m_commitTimer;
+    QVector<Message> m_pending;
+    int m_storedCount = 0;
+    int m_maxMessages = 10000;
+    qint64 m_maxAgeMs = 24 * 60 * 60 * 1000LL;
+};
+
+#endif // OUTBOX_H
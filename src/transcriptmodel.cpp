@@ -0,0 +1,194 @@
+#include "transcriptmodel.h"
+
+TranscriptModel::TranscriptModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_capacity(qMax(1, capacity))
+{
+    m_ring.resize(m_capacity);
+    m_serials.resize(m_capacity);
+}
+
+TranscriptModel::~TranscriptModel() = default;
+
+int TranscriptModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_count;
+}
+
+QVariant TranscriptModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_count) {
+        return QVariant();
+    }
+
+    const int row = index.row();
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString("%1: %2").arg(senderAt(row), contentAt(row));
+    case SenderRole:
+        return senderAt(row);
+    case ContentRole:
+        return contentAt(row).toString();
+    case TimestampRole:
+        return timestampAt(row);
+    default:
+        return QVariant();
+    }
+}
+
+void TranscriptModel::append(const Message &message)
+{
+    if (m_count == m_capacity) {
+        beginRemoveRows(QModelIndex(), 0, 0);
+        drop(m_head);
+        m_head = (m_head + 1) % m_capacity;
+        --m_count;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count);
+    const int index = slot(m_count);
+    store(index, message);
+    m_serials[index] = m_nextSerial++;
+    ++m_count;
+    endInsertRows();
+}
+
+void TranscriptModel::append(const QVector<Message> &messages)
+{
+    // Only the newest messages that fit can ever be shown
+    const int incoming = qMin<int>(messages.size(), m_capacity);
+    if (incoming == 0) {
+        return;
+    }
+    const int skipped = messages.size() - incoming;
+
+    const int overflow = m_count + incoming - m_capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        for (int i = 0; i < overflow; ++i) {
+            drop(m_head);
+            m_head = (m_head + 1) % m_capacity;
+        }
+        m_count -= overflow;
+        endRemoveRows();
+    }
+
+    // One insert notification for the whole batch
+    beginInsertRows(QModelIndex(), m_count, m_count + incoming - 1);
+    for (int i = 0; i < incoming; ++i) {
+        const int index = slot(m_count);
+        store(index, messages.at(skipped + i));
+        m_serials[index] = m_nextSerial++;
+        ++m_count;
+    }
+    endInsertRows();
+}
+
+int TranscriptModel::prepend(const QVector<Message> &messages)
+{
+    // The newest of the older messages sit next to the current first row
+    const int incoming = qMin<int>(messages.size(), m_capacity);
+    if (incoming == 0) {
+        return 0;
+    }
+    const int skipped = messages.size() - incoming;
+
+    const int overflow = qMax(0, m_count + incoming - m_capacity);
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), m_count - overflow, m_count - 1);
+        for (int i = 0; i < overflow; ++i) {
+            drop(slot(m_count - 1 - i));
+        }
+        m_count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), 0, incoming - 1);
+    for (int i = messages.size() - 1; i >= skipped; --i) {
+        m_head = (m_head + m_capacity - 1) % m_capacity;
+        store(m_head, messages.at(i));
+        m_serials[m_head] = m_nextSerial++;
+        ++m_count;
+    }
+    endInsertRows();
+
+    return overflow;
+}
+
+void TranscriptModel::clear()
+{
+    beginResetModel();
+    m_ring.fill(CompactMessage());
+    m_arena.clear();
+    m_head = 0;
+    m_count = 0;
+    endResetModel();
+}
+
+void TranscriptModel::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if (capacity == m_capacity) {
+        return;
+    }
+
+    beginResetModel();
+
+    // Keep the newest messages that still fit
+    const int keep = qMin(m_count, capacity);
+    QVector<CompactMessage> ring(capacity);
+    QVector<quint64> serials(capacity);
+    for (int row = 0; row < m_count - keep; ++row) {
+        drop(slot(row));
+    }
+    for (int row = 0; row < keep; ++row) {
+        const int from = slot(m_count - keep + row);
+        ring[row] = m_ring[from];
+        serials[row] = m_serials[from];
+    }
+
+    m_ring = std::move(ring);
+    m_serials = std::move(serials);
+    m_capacity = capacity;
+    m_head = 0;
+    m_count = keep;
+
+    endResetModel();
+}
+
+Message TranscriptModel::messageAt(int row) const
+{
+    return m_arena.unpack(m_ring[slot(row)]);
+}
+
+QString TranscriptModel::idAt(int row) const
+{
+    return m_arena.id(m_ring[slot(row)]);
+}
+
+QDateTime TranscriptModel::timestampAt(int row) const
+{
+    const CompactMessage &message = m_ring[slot(row)];
+    if (!(message.flags & CompactMessage::HasTimestamp)) {
+        return QDateTime();
+    }
+    return QDateTime::fromMSecsSinceEpoch(message.timestampMs);
+}
+
+quint64 TranscriptModel::serialAt(int row) const
+{
+    return m_serials[slot(row)];
+}
+
+void TranscriptModel::store(int index, const Message &message)
+{
+    m_arena.release(m_ring[index]);
+    m_ring[index] = m_arena.pack(message);
+}
+
+void TranscriptModel::drop(int index)
+{
+    m_arena.release(m_ring[index]);
+    m_ring[index] = CompactMessage();
+}
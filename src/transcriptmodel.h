@@ -0,0 +1,70 @@
+#ifndef TRANSCRIPTMODEL_H
+#define TRANSCRIPTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "compactmessage.h"
+#include "include/types.h"
+
+// Chat history for one tab, held in a fixed-capacity ring buffer. Appending
+// is O(1) regardless of how much history is retained; once the buffer is
+// full the oldest message is dropped, so memory is bounded by the
+// configured history size. Rows are kept as CompactMessages with their text
+// and names in this tab's arena. Painting reads single fields in place;
+// messageAt() expands a whole row back into a Message.
+class TranscriptModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        SenderRole = Qt::UserRole + 1,
+        ContentRole,
+        TimestampRole
+    };
+
+    explicit TranscriptModel(int capacity, QObject *parent = nullptr);
+    ~TranscriptModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void append(const Message &message);
+    void append(const QVector<Message> &messages);
+
+    // Inserts older messages (oldest first) above row 0. When the buffer is
+    // full the newest rows make way; returns how many were dropped.
+    int prepend(const QVector<Message> &messages);
+    void clear();
+
+    int capacity() const { return m_capacity; }
+    void setCapacity(int capacity);
+
+    // Valid for 0 <= row < rowCount(). Views stay valid until the row is
+    // removed; senderAt() copies, since the interner may reallocate.
+    Message messageAt(int row) const;
+    QString idAt(int row) const;
+    quint64 serialAt(int row) const;
+    QString senderAt(int row) const { return m_arena.sender(m_ring[slot(row)]); }
+    QStringView contentAt(int row) const { return m_arena.content(m_ring[slot(row)]); }
+    QDateTime timestampAt(int row) const;
+    bool containsImageAt(int row) const { return m_ring[slot(row)].flags & CompactMessage::ContainsImage; }
+    QString imageKeyAt(int row) const { return m_arena.imageKey(m_ring[slot(row)]).toString(); }
+
+    qint64 arenaBytes() const { return m_arena.bytesReserved(); }
+
+private:
+    int slot(int row) const { return (m_head + row) % m_capacity; }
+    void store(int index, const Message &message);
+    void drop(int index);
+
+    MessageArena m_arena;
+    QVector<CompactMessage> m_ring;
+    QVector<quint64> m_serials;     // Stable per-message keys for view-side caches
+    int m_capacity;
+    int m_head = 0;
+    int m_count = 0;
+    quint64 m_nextSerial = 1;
+};
+
+#endif // TRANSCRIPTMODEL_H
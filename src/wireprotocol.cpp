@@ -0,0 +1,305 @@
+#include "wireprotocol.h"
+
+namespace {
+
+void writeVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+void writeBytes(QByteArray &out, const QByteArray &bytes)
+{
+    writeVarint(out, quint64(bytes.size()));
+    out.append(bytes);
+}
+
+void writeString(QByteArray &out, const QString &value)
+{
+    writeBytes(out, value.toUtf8());
+}
+
+// Bounds-checked cursor over a received frame
+struct Reader {
+    const uchar *p;
+    const uchar *end;
+    bool ok = true;
+
+    quint8 byte()
+    {
+        if (p >= end) {
+            ok = false;
+            return 0;
+        }
+        return *p++;
+    }
+
+    quint64 varint()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const quint8 b = byte();
+            if (!ok) {
+                return 0;
+            }
+            value |= quint64(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    QByteArray bytes()
+    {
+        const quint64 length = varint();
+        if (!ok || length > quint64(end - p)) {
+            ok = false;
+            return QByteArray();
+        }
+        QByteArray value(reinterpret_cast<const char *>(p), qsizetype(length));
+        p += length;
+        return value;
+    }
+
+    QString string()
+    {
+        const quint64 length = varint();
+        if (!ok || length > quint64(end - p)) {
+            ok = false;
+            return QString();
+        }
+        QString value = QString::fromUtf8(reinterpret_cast<const char *>(p), qsizetype(length));
+        p += length;
+        return value;
+    }
+};
+
+} // namespace
+
+void WireEncoder::reset()
+{
+    m_interned.clear();
+}
+
+void WireEncoder::beginFrame(QByteArray &out) const
+{
+    out.append(char(WireProtocol::Version));
+    out.append(char(0));  // Flags
+}
+
+QByteArray WireEncoder::encodeMessages(const QVector<Message> &messages)
+{
+    QByteArray out;
+    out.reserve(16 + messages.size() * 64);
+    beginFrame(out);
+    for (const Message &message : messages) {
+        writeMessage(out, message);
+    }
+    return out;
+}
+
+QByteArray WireEncoder::encodeMessage(const Message &message)
+{
+    QByteArray out;
+    out.reserve(16 + message.content.size());
+    beginFrame(out);
+    writeMessage(out, message);
+    return out;
+}
+
+QByteArray WireEncoder::encodeLinkValidation(const QString &url, bool isMalicious)
+{
+    QByteArray out;
+    beginFrame(out);
+    out.append(char(WireProtocol::LinkValidationRecord));
+    writeString(out, url);
+    out.append(char(isMalicious ? 1 : 0));
+    return out;
+}
+
+QByteArray WireEncoder::encodeImageBegin(const WireProtocol::ImageBegin &begin)
+{
+    QByteArray out;
+    beginFrame(out);
+    out.append(char(WireProtocol::ImageBeginRecord));
+    writeString(out, begin.transferId);
+    writeInterned(out, begin.serverId);
+    writeInterned(out, begin.sender);
+    writeString(out, begin.fileName);
+    writeVarint(out, begin.totalSize);
+    writeVarint(out, begin.chunkSize);
+    writeVarint(out, begin.chunkCount);
+    writeBytes(out, begin.sha256);
+    return out;
+}
+
+QByteArray WireEncoder::encodeImageChunk(const WireProtocol::ImageChunk &chunk)
+{
+    QByteArray out;
+    out.reserve(64 + chunk.data.size());
+    beginFrame(out);
+    out.append(char(WireProtocol::ImageChunkRecord));
+    writeString(out, chunk.transferId);
+    writeVarint(out, chunk.index);
+    writeBytes(out, chunk.sha256);
+    writeBytes(out, chunk.data);
+    return out;
+}
+
+QByteArray WireEncoder::encodeImageAck(const WireProtocol::ImageAck &ack)
+{
+    QByteArray out;
+    beginFrame(out);
+    out.append(char(WireProtocol::ImageAckRecord));
+    writeString(out, ack.transferId);
+    writeVarint(out, ack.nextIndex);
+    out.append(char(ack.status));
+    return out;
+}
+
+void WireEncoder::writeMessage(QByteArray &out, const Message &message)
+{
+    out.append(char(WireProtocol::MessageRecord));
+    writeString(out, message.id);
+    writeInterned(out, message.serverId);
+    writeInterned(out, message.sender);
+    writeVarint(out, message.timestamp.isValid() ? quint64(message.timestamp.toMSecsSinceEpoch()) : 0);
+    writeVarint(out, message.sequence);
+    writeString(out, message.content);
+}
+
+void WireEncoder::writeInterned(QByteArray &out, const QString &value)
+{
+    auto it = m_interned.constFind(value);
+    if (it != m_interned.constEnd()) {
+        writeVarint(out, quint64(*it) + 2);
+        return;
+    }
+
+    if (m_interned.size() < WireProtocol::MaxInternedStrings) {
+        m_interned.insert(value, quint32(m_interned.size()));
+        writeVarint(out, 1);
+    } else {
+        writeVarint(out, 0);
+    }
+    writeString(out, value);
+}
+
+void WireDecoder::reset()
+{
+    m_interned.clear();
+}
+
+bool WireDecoder::isBinaryFrame(const QByteArray &data)
+{
+    return data.size() >= 2 && quint8(data.at(0)) == WireProtocol::Version;
+}
+
+bool WireDecoder::decode(const QByteArray &data, Frame *frame)
+{
+    if (!isBinaryFrame(data)) {
+        return false;
+    }
+
+    Reader reader{reinterpret_cast<const uchar *>(data.constData()) + 2,
+                  reinterpret_cast<const uchar *>(data.constData()) + data.size()};
+
+    auto readInterned = [this, &reader]() -> QString {
+        const quint64 ref = reader.varint();
+        if (!reader.ok) {
+            return QString();
+        }
+        if (ref == 0) {
+            return reader.string();
+        }
+        if (ref == 1) {
+            QString value = reader.string();
+            if (reader.ok && m_interned.size() < WireProtocol::MaxInternedStrings) {
+                m_interned.append(value);
+            }
+            return value;
+        }
+        if (ref - 2 >= quint64(m_interned.size())) {
+            reader.ok = false;
+            return QString();
+        }
+        return m_interned.at(int(ref - 2));
+    };
+
+    while (reader.ok && reader.p < reader.end) {
+        const quint8 kind = reader.byte();
+        switch (kind) {
+        case WireProtocol::MessageRecord: {
+            Message message;
+            message.id = reader.string();
+            message.serverId = readInterned();
+            message.sender = readInterned();
+            const quint64 timestampMs = reader.varint();
+            if (timestampMs != 0) {
+                message.timestamp = QDateTime::fromMSecsSinceEpoch(qint64(timestampMs));
+            }
+            message.sequence = reader.varint();
+            message.content = reader.string();
+            if (reader.ok) {
+                frame->messages.append(std::move(message));
+            }
+            break;
+        }
+        case WireProtocol::LinkValidationRecord: {
+            LinkValidation result;
+            result.url = reader.string();
+            result.isMalicious = reader.byte() != 0;
+            if (reader.ok) {
+                frame->linkValidations.append(std::move(result));
+            }
+            break;
+        }
+        case WireProtocol::ImageBeginRecord: {
+            WireProtocol::ImageBegin begin;
+            begin.transferId = reader.string();
+            begin.serverId = readInterned();
+            begin.sender = readInterned();
+            begin.fileName = reader.string();
+            begin.totalSize = reader.varint();
+            begin.chunkSize = quint32(reader.varint());
+            begin.chunkCount = quint32(reader.varint());
+            begin.sha256 = reader.bytes();
+            if (reader.ok) {
+                frame->imageBegins.append(std::move(begin));
+            }
+            break;
+        }
+        case WireProtocol::ImageChunkRecord: {
+            WireProtocol::ImageChunk chunk;
+            chunk.transferId = reader.string();
+            chunk.index = quint32(reader.varint());
+            chunk.sha256 = reader.bytes();
+            chunk.data = reader.bytes();
+            if (reader.ok) {
+                frame->imageChunks.append(std::move(chunk));
+            }
+            break;
+        }
+        case WireProtocol::ImageAckRecord: {
+            WireProtocol::ImageAck ack;
+            ack.transferId = reader.string();
+            ack.nextIndex = quint32(reader.varint());
+            ack.status = WireProtocol::AckStatus(reader.byte());
+            if (reader.ok && ack.status <= WireProtocol::AckStatus::Rejected) {
+                frame->imageAcks.append(std::move(ack));
+            }
+            break;
+        }
+        default:
+            // Unknown records have no length prefix, so the rest of the frame is unreadable
+            return false;
+        }
+    }
+
+    return reader.ok;
+}
@@ -0,0 +1,118 @@
+#ifndef WIREPROTOCOL_H
+#define WIREPROTOCOL_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "include/types.h"
+
+// Compact binary framing carried in binary WebSocket frames, negotiated at
+// connect time as an alternative to the JSON text protocol.
+//
+// Frame:   [version u8][flags u8] record*   (flags bit 0: records deflated)
+// Record:  [kind u8] fields...
+//   Message         id:str channel:ref sender:ref timestampMs:varint seq:varint content:str
+//   LinkValidation  url:str isMalicious:u8
+//   ImageBegin      transfer:str channel:ref sender:ref name:str size:varint
+//                   chunkSize:varint chunkCount:varint sha256:bytes
+//   ImageChunk      transfer:str index:varint sha256:bytes data:bytes
+//   ImageAck        transfer:str nextIndex:varint status:u8
+//
+// str is a varint byte length followed by UTF-8. ref is an interned string:
+// 0 = literal str follows, 1 = str follows and is assigned the next table
+// slot, n >= 2 = table slot n - 2. bytes is a varint length and raw data.
+// Tables live for one connection.
+namespace WireProtocol {
+    constexpr quint8 Version = 2;          // 2 added per-channel sequence numbers
+    constexpr const char *Name = "rcb2";
+    constexpr int MaxInternedStrings = 4096;
+
+    enum RecordKind : quint8 {
+        MessageRecord = 1,
+        LinkValidationRecord = 2,
+        ImageBeginRecord = 3,
+        ImageChunkRecord = 4,
+        ImageAckRecord = 5
+    };
+
+    struct ImageBegin {
+        QString transferId;
+        QString serverId;
+        QString sender;
+        QString fileName;
+        quint64 totalSize = 0;
+        quint32 chunkSize = 0;
+        quint32 chunkCount = 0;
+        QByteArray sha256;          // Of the whole file
+    };
+
+    struct ImageChunk {
+        QString transferId;
+        quint32 index = 0;
+        QByteArray sha256;          // Of this chunk
+        QByteArray data;
+    };
+
+    enum class AckStatus : quint8 {
+        Progress = 0,       // Chunks below nextIndex are safely on disk
+        Resend = 1,         // Chunk nextIndex failed its hash; send again from there
+        Rejected = 2        // Receiver gave up on the transfer
+    };
+
+    struct ImageAck {
+        QString transferId;
+        quint32 nextIndex = 0;
+        AckStatus status = AckStatus::Progress;
+    };
+}
+
+class WireEncoder
+{
+public:
+    void reset();
+
+    QByteArray encodeMessages(const QVector<Message> &messages);
+    QByteArray encodeMessage(const Message &message);
+    QByteArray encodeLinkValidation(const QString &url, bool isMalicious);
+    QByteArray encodeImageBegin(const WireProtocol::ImageBegin &begin);
+    QByteArray encodeImageChunk(const WireProtocol::ImageChunk &chunk);
+    QByteArray encodeImageAck(const WireProtocol::ImageAck &ack);
+
+private:
+    void beginFrame(QByteArray &out) const;
+    void writeMessage(QByteArray &out, const Message &message);
+    void writeInterned(QByteArray &out, const QString &value);
+
+    QHash<QString, quint32> m_interned;
+};
+
+class WireDecoder
+{
+public:
+    struct LinkValidation {
+        QString url;
+        bool isMalicious = false;
+    };
+
+    struct Frame {
+        QVector<Message> messages;
+        QVector<LinkValidation> linkValidations;
+        QVector<WireProtocol::ImageBegin> imageBegins;
+        QVector<WireProtocol::ImageChunk> imageChunks;
+        QVector<WireProtocol::ImageAck> imageAcks;
+    };
+
+    void reset();
+
+    // Returns false if the frame is malformed; the interning tables are
+    // then out of sync and the connection should fall back or reconnect
+    bool decode(const QByteArray &data, Frame *frame);
+
+    static bool isBinaryFrame(const QByteArray &data);
+
+private:
+    QVector<QString> m_interned;
+};
+
+#endif // WIREPROTOCOL_H
@@ -0,0 +1,450 @@
+// Micro-benchmarks for the per-message hot paths: link checks, content
+// filtering, frame encoding and parsing in both wire formats, and
+// transcript painting. Every corpus is
+// generated from a fixed seed so numbers are comparable between builds.
+//
+// Run headless: QT_QPA_PLATFORM=offscreen hotpathbench [-o file,csv]
+
+#include <QtTest>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QStyleOptionViewItem>
+#include <QTemporaryDir>
+#include <iterator>
+#include "jsonframereader.h"
+#include "messagedelegate.h"
+#include "wireprotocol.h"
+#include "transcriptmodel.h"
+#include "moderation/linkvalidator.h"
+#include "moderation/moderationengine.h"
+
+namespace {
+
+constexpr int CorpusSize = 1000;
+
+const char *const Words[] = {"anyone", "want", "to", "trade", "gg", "lol", "brb", "join", "my", "game",
+                             "can", "someone", "help", "with", "the", "obby", "golden", "sword", "meet",
+                             "at", "spawn", "idk", "tbh", "omg", "that", "was", "close", "wait", "for", "me"};
+
+const char *const SafeUrls[] = {"https://www.roblox.com/games/1818/Classic-Crossroads",
+                                "https://www.roblox.com/catalog/48474313/Red-Roblox-Cap",
+                                "https://www.youtube.com/watch?v=dQw4w9WgXcQ",
+                                "https://github.com/rochat/rochat-plus/issues/12"};
+
+const char *const SpamUrls[] = {"http://free-robux-generator.tk/claim?user=",
+                                "http://roblox.com.account-verify.ml/login?session=",
+                                "http://192.168.4.20/r0blox/login.php?id=",
+                                "http://bit.ly/fr33r0bux",
+                                "https://a.b.c.d.e.robux-giveaway.xyz/?ref="};
+
+QString sentence(QRandomGenerator &random, int words)
+{
+    QString text;
+    for (int i = 0; i < words; ++i) {
+        if (i > 0) {
+            text += QLatin1Char(' ');
+        }
+        text += QLatin1String(Words[random.bounded(int(std::size(Words)))]);
+    }
+    return text;
+}
+
+// Spam urls get a unique suffix so the verdict cache sees realistic churn
+QString spamUrl(QRandomGenerator &random)
+{
+    return QLatin1String(SpamUrls[random.bounded(int(std::size(SpamUrls)))])
+           + QString::number(random.generate(), 36);
+}
+
+enum class Corpus {
+    Clean,
+    Mixed,
+    Spam
+};
+
+QStringList contentCorpus(Corpus kind)
+{
+    QRandomGenerator random(0x5eed);
+    QStringList corpus;
+    corpus.reserve(CorpusSize);
+    for (int i = 0; i < CorpusSize; ++i) {
+        QString text = sentence(random, 3 + random.bounded(12));
+        switch (kind) {
+        case Corpus::Clean:
+            break;
+        case Corpus::Mixed:
+            if (random.bounded(5) == 0) {
+                text += QLatin1Char(' ') + QLatin1String(SafeUrls[random.bounded(int(std::size(SafeUrls)))]);
+            }
+            break;
+        case Corpus::Spam:
+            for (int link = 0; link < 4; ++link) {
+                text += QStringLiteral(" FREE ROBUX ") + spamUrl(random);
+            }
+            break;
+        }
+        corpus.append(text);
+    }
+    return corpus;
+}
+
+QStringList urlCorpus(bool spam)
+{
+    QRandomGenerator random(0xc0ffee);
+    QStringList urls;
+    urls.reserve(CorpusSize);
+    for (int i = 0; i < CorpusSize; ++i) {
+        urls.append(spam ? spamUrl(random) : QLatin1String(SafeUrls[random.bounded(int(std::size(SafeUrls)))]));
+    }
+    return urls;
+}
+
+// Writes a pattern file of the given size, as loaded from data/blacklist.txt
+QString writeBlacklist(const QTemporaryDir &dir, int patterns)
+{
+    const QString path = dir.filePath(QStringLiteral("blacklist-%1.txt").arg(patterns));
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return QString();
+    }
+    QRandomGenerator random(0xb1ac);
+    for (int i = 0; i < patterns; ++i) {
+        file.write(QStringLiteral("%1-%2.%3\n")
+                       .arg(QString::number(random.generate(), 36), QString::number(i, 36),
+                            i % 2 ? QStringLiteral("tk") : QStringLiteral("xyz"))
+                       .toUtf8());
+    }
+    return path;
+}
+
+QStringList frameCorpus(bool withUnknownFields)
+{
+    QRandomGenerator random(0xf4a3e);
+    QStringList frames;
+    frames.reserve(CorpusSize);
+    for (int i = 0; i < CorpusSize; ++i) {
+        QString frame = QStringLiteral("{\"type\":\"message\",\"id\":\"%1\",\"seq\":%2,\"sender\":\"player_%3\","
+                                       "\"serverId\":\"channel-%4\",\"timestamp\":\"2026-03-14T12:%5:%6.123Z\","
+                                       "\"content\":\"%7\"")
+                            .arg(QString::number(random.generate64(), 36))
+                            .arg(i + 1)
+                            .arg(random.bounded(3000))
+                            .arg(random.bounded(4))
+                            .arg(random.bounded(60), 2, 10, QLatin1Char('0'))
+                            .arg(random.bounded(60), 2, 10, QLatin1Char('0'))
+                            .arg(sentence(random, 3 + random.bounded(12)));
+        if (withUnknownFields) {
+            // Newer servers send metadata we skip without decoding
+            frame += QStringLiteral(",\"badges\":[\"vip\",\"builder\"],\"meta\":{\"place\":%1,\"region\":\"eu\","
+                                    "\"tags\":[1,2,3]},\"note\":\"%2\"")
+                         .arg(random.bounded(100000))
+                         .arg(sentence(random, 20));
+        }
+        frame += QLatin1Char('}');
+        frames.append(frame);
+    }
+    return frames;
+}
+
+// The messages in frameCorpus(false), so both wire formats carry the same data
+QVector<Message> messageCorpus()
+{
+    QVector<Message> messages;
+    messages.reserve(CorpusSize);
+    for (const QString &text : frameCorpus(false)) {
+        JsonFrameReader::Frame frame;
+        if (JsonFrameReader::read(text, &frame)) {
+            messages.append(frame.message);
+        }
+    }
+    return messages;
+}
+
+// What NetworkClient sends for one message on the JSON protocol
+QByteArray jsonFrame(const Message &message)
+{
+    QJsonObject json;
+    json["type"] = "message";
+    json["id"] = message.id;
+    json["sender"] = message.sender;
+    json["content"] = message.content;
+    json["serverId"] = message.serverId;
+    json["timestamp"] = message.timestamp.toString(Qt::ISODate);
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+enum class Encoding {
+    Json,
+    Binary,         // One message per frame, as sent when not batching
+    BinaryBatch     // Up to 64 messages per frame
+};
+
+constexpr int BatchMessages = 64;
+
+QVector<QByteArray> encodeCorpus(const QVector<Message> &messages, Encoding encoding)
+{
+    QVector<QByteArray> frames;
+    WireEncoder encoder;
+    for (int i = 0; i < messages.size(); i += encoding == Encoding::BinaryBatch ? BatchMessages : 1) {
+        switch (encoding) {
+        case Encoding::Json:
+            frames.append(jsonFrame(messages.at(i)));
+            break;
+        case Encoding::Binary:
+            frames.append(encoder.encodeMessage(messages.at(i)));
+            break;
+        case Encoding::BinaryBatch:
+            frames.append(encoder.encodeMessages(messages.mid(i, BatchMessages)));
+            break;
+        }
+    }
+    return frames;
+}
+
+} // namespace
+
+class HotPathBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void isSafeUrl_data();
+    void isSafeUrl();
+    void extractLinks_data();
+    void extractLinks();
+    void filterContent_data();
+    void filterContent();
+    void parseMessage_data();
+    void parseMessage();
+    void encodeMessage_data();
+    void encodeMessage();
+    void decodeMessage_data();
+    void decodeMessage();
+    void bytesPerMessage_data();
+    void bytesPerMessage();
+    void formatMessageDisplay_data();
+    void formatMessageDisplay();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void HotPathBench::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+void HotPathBench::isSafeUrl_data()
+{
+    QTest::addColumn<QStringList>("urls");
+    QTest::newRow("safe") << urlCorpus(false);
+    QTest::newRow("spam") << urlCorpus(true);
+}
+
+void HotPathBench::isSafeUrl()
+{
+    QFETCH(QStringList, urls);
+    LinkValidator validator;
+    int safe = 0;
+    QBENCHMARK {
+        safe = 0;
+        for (const QString &url : urls) {
+            safe += validator.isSafeUrl(url) ? 1 : 0;
+        }
+    }
+    QVERIFY(safe <= urls.size());
+}
+
+void HotPathBench::extractLinks_data()
+{
+    QTest::addColumn<QStringList>("corpus");
+    QTest::newRow("clean") << contentCorpus(Corpus::Clean);
+    QTest::newRow("mixed") << contentCorpus(Corpus::Mixed);
+    QTest::newRow("spam") << contentCorpus(Corpus::Spam);
+}
+
+void HotPathBench::extractLinks()
+{
+    QFETCH(QStringList, corpus);
+    ModerationEngine engine;
+    int links = 0;
+    QBENCHMARK {
+        links = 0;
+        for (const QString &text : corpus) {
+            links += int(engine.extractLinks(text).size());
+        }
+    }
+    QVERIFY(links >= 0);
+}
+
+void HotPathBench::filterContent_data()
+{
+    QTest::addColumn<QStringList>("corpus");
+    QTest::addColumn<int>("blacklistSize");
+    QTest::newRow("clean") << contentCorpus(Corpus::Clean) << 0;
+    QTest::newRow("mixed") << contentCorpus(Corpus::Mixed) << 0;
+    QTest::newRow("spam") << contentCorpus(Corpus::Spam) << 0;
+    QTest::newRow("mixed/blacklist-100k") << contentCorpus(Corpus::Mixed) << 100000;
+    QTest::newRow("spam/blacklist-100k") << contentCorpus(Corpus::Spam) << 100000;
+}
+
+void HotPathBench::filterContent()
+{
+    QFETCH(QStringList, corpus);
+    QFETCH(int, blacklistSize);
+    ModerationEngine engine;
+    if (blacklistSize > 0) {
+        const QString path = writeBlacklist(m_dir, blacklistSize);
+        QVERIFY(!path.isEmpty());
+        engine.loadBlacklist(path);
+    }
+    // Verdicts are cached after the first pass, as they are in a live
+    // session where the same links are posted repeatedly
+    qsizetype total = 0;
+    QBENCHMARK {
+        total = 0;
+        for (const QString &text : corpus) {
+            total += engine.filterContent(text).size();
+        }
+    }
+    QVERIFY(total > 0);
+}
+
+void HotPathBench::parseMessage_data()
+{
+    QTest::addColumn<QStringList>("frames");
+    QTest::newRow("message") << frameCorpus(false);
+    QTest::newRow("message+unknown-fields") << frameCorpus(true);
+}
+
+void HotPathBench::parseMessage()
+{
+    // NetworkClient::parseMessage is a dispatch around this reader
+    QFETCH(QStringList, frames);
+    int parsed = 0;
+    QBENCHMARK {
+        parsed = 0;
+        for (const QString &text : frames) {
+            JsonFrameReader::Frame frame;
+            parsed += JsonFrameReader::read(text, &frame) ? 1 : 0;
+        }
+    }
+    QCOMPARE(parsed, frames.size());
+}
+
+void HotPathBench::encodeMessage_data()
+{
+    QTest::addColumn<int>("encoding");
+    QTest::newRow("json") << int(Encoding::Json);
+    QTest::newRow("rcb2") << int(Encoding::Binary);
+    QTest::newRow("rcb2-batch") << int(Encoding::BinaryBatch);
+}
+
+void HotPathBench::encodeMessage()
+{
+    QFETCH(int, encoding);
+    const QVector<Message> messages = messageCorpus();
+    QCOMPARE(messages.size(), CorpusSize);
+    qsizetype bytes = 0;
+    QBENCHMARK {
+        // A fresh encoder each pass, so names are interned as on a new connection
+        bytes = 0;
+        for (const QByteArray &frame : encodeCorpus(messages, Encoding(encoding))) {
+            bytes += frame.size();
+        }
+    }
+    QVERIFY(bytes > 0);
+}
+
+void HotPathBench::decodeMessage_data()
+{
+    // JSON decoding is parseMessage/message above, over the same messages
+    QTest::addColumn<QVector<QByteArray>>("frames");
+    QTest::newRow("rcb2") << encodeCorpus(messageCorpus(), Encoding::Binary);
+    QTest::newRow("rcb2-batch") << encodeCorpus(messageCorpus(), Encoding::BinaryBatch);
+}
+
+void HotPathBench::decodeMessage()
+{
+    QFETCH(QVector<QByteArray>, frames);
+    int decoded = 0;
+    QBENCHMARK {
+        decoded = 0;
+        WireDecoder decoder;
+        for (const QByteArray &data : frames) {
+            WireDecoder::Frame frame;
+            QVERIFY(decoder.decode(data, &frame));
+            decoded += frame.messages.size();
+        }
+    }
+    QCOMPARE(decoded, CorpusSize);
+}
+
+void HotPathBench::bytesPerMessage_data()
+{
+    encodeMessage_data();
+}
+
+void HotPathBench::bytesPerMessage()
+{
+    // Not a timing: reports the average frame bytes per message through the
+    // byte-valued metric, so the formats line up in the same CSV
+    QFETCH(int, encoding);
+    const QVector<Message> messages = messageCorpus();
+    qint64 bytes = 0;
+    for (const QByteArray &frame : encodeCorpus(messages, Encoding(encoding))) {
+        bytes += frame.size();
+    }
+    QTest::setBenchmarkResult(qreal(bytes) / messages.size(), QTest::BytesAllocated);
+}
+
+void HotPathBench::formatMessageDisplay_data()
+{
+    QTest::addColumn<QStringList>("corpus");
+    QTest::newRow("clean") << contentCorpus(Corpus::Clean);
+    QTest::newRow("spam") << contentCorpus(Corpus::Spam);
+}
+
+void HotPathBench::formatMessageDisplay()
+{
+    // Messages are displayed by MessageDelegate: measuring a row's height
+    // once and painting it. One iteration lays out and paints a screenful.
+    constexpr int VisibleRows = 40;
+    QFETCH(QStringList, corpus);
+
+    TranscriptModel model(corpus.size());
+    const QDateTime start = QDateTime::currentDateTime();
+    for (int i = 0; i < corpus.size(); ++i) {
+        Message message(QStringLiteral("player_%1").arg(i % 97), corpus.at(i));
+        message.timestamp = start.addSecs(i);
+        model.append(message);
+    }
+
+    QImage surface(600, 800, QImage::Format_ARGB32_Premultiplied);
+    QStyleOptionViewItem option;
+    option.rect = QRect(0, 0, surface.width(), 0);
+
+    int first = 0;
+    QBENCHMARK {
+        // A fresh delegate has an empty height cache, as after a resize
+        MessageDelegate delegate;
+        QPainter painter(&surface);
+        int y = 0;
+        for (int row = first; row < first + VisibleRows; ++row) {
+            const QModelIndex index = model.index(row % model.rowCount());
+            option.rect = QRect(0, y, surface.width(), 0);
+            option.rect.setHeight(delegate.sizeHint(option, index).height());
+            delegate.paint(&painter, option, index);
+            y += option.rect.height();
+        }
+        first = (first + VisibleRows) % model.rowCount();
+    }
+}
+
+QTEST_MAIN(HotPathBench)
+#include "hotpathbench.moc"
@@ -0,0 +1,46 @@
+// Offline compiler for the moderation blacklist.
+//
+// Reads a plain-text pattern list (one pattern per line, '#' comments) and
+// writes the compiled automaton that ModerationEngine maps at startup.
+//
+// Usage: blacklistc [input] [output]
+//   input   defaults to data/blacklist.txt
+//   output  defaults to data/blacklist.bin
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include "moderation/patternmatcher.h"
+#include "include/constants.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QStringList args = app.arguments();
+    const QString input = args.size() > 1 ? args.at(1) : Constants::BLACKLIST_PATH;
+    const QString output = args.size() > 2 ? args.at(2) : Constants::BLACKLIST_INDEX_PATH;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = false;
+    const QStringList patterns = PatternMatcher::loadPatterns(input, &ok);
+    if (!ok) {
+        err << "Could not read " << input << Qt::endl;
+        return 1;
+    }
+
+    PatternMatcher matcher;
+    matcher.build(patterns);
+    if (!matcher.save(output)) {
+        err << "Could not write " << output << Qt::endl;
+        return 1;
+    }
+
+    out << "Compiled " << matcher.patternCount() << " patterns from " << input
+        << " to " << output << " in " << timer.elapsed() << " ms" << Qt::endl;
+    return 0;
+}
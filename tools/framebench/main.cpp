@@ -0,0 +1,218 @@
+// Replays a chat corpus through the wire encoder and FrameCompressor and
+// reports compression ratio and CPU cost per message.
+//
+// Usage: framebench [corpus.jsonl] [--train dictionary]
+//   corpus.jsonl  one {"sender", "content", "serverId"} object per line;
+//                 a synthetic corpus is generated when omitted
+//   --train       also writes a dictionary trained on the corpus, for
+//                 installing as data/chat.dict
+//
+// Each message is sent as its own frame, the worst case for compression.
+// Dictionaries are trained on the first half of the corpus and measured on
+// the second half so the numbers are not flattered by memorisation.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <iterator>
+#include <numeric>
+#include "wireprotocol.h"
+#include "framecompressor.h"
+
+namespace {
+
+QVector<Message> loadCorpus(const QString &path)
+{
+    QVector<Message> messages;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return messages;
+    }
+    while (!file.atEnd()) {
+        const QJsonObject object = QJsonDocument::fromJson(file.readLine()).object();
+        if (object.isEmpty()) {
+            continue;
+        }
+        Message message(object.value("sender").toString(), object.value("content").toString());
+        message.serverId = object.value("serverId").toString();
+        message.id = object.value("id").toString();
+        messages.append(message);
+    }
+    return messages;
+}
+
+QVector<Message> syntheticCorpus(int count)
+{
+    static const char *senders[] = {"Builder_42", "xXNoobSlayerXx", "CoolKid2010", "Moderator", "PizzaGuy",
+                                    "anna_b", "Zed", "robloxfan99"};
+    static const char *phrases[] = {"anyone want to trade?", "gg", "lol", "brb", "who wants to join my game",
+                                    "check this out https://www.roblox.com/games/1818/Classic-Crossroads",
+                                    "can someone help me with the obby", "how do i get the golden sword",
+                                    "thx for the trade!", "meet at spawn", "idk tbh", "omg that was close",
+                                    "join https://discord.gg/abc123 for updates", "wait for me", "ok"};
+    QRandomGenerator random(1234);
+    QVector<Message> messages;
+    messages.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QString content = QString::fromLatin1(phrases[random.bounded(int(std::size(phrases)))]);
+        if (random.bounded(3) == 0) {
+            content += QLatin1Char(' ') + QString::fromLatin1(phrases[random.bounded(int(std::size(phrases)))]);
+        }
+        Message message(QString::fromLatin1(senders[random.bounded(int(std::size(senders)))]), content);
+        message.serverId = QStringLiteral("channel-%1").arg(random.bounded(4));
+        message.id = QStringLiteral("%1").arg(quint64(i) * 2654435761u % 1000000007u, 10, 36, QLatin1Char('0'));
+        message.sequence = quint64(i + 1);
+        messages.append(message);
+    }
+    return messages;
+}
+
+QVector<QByteArray> encodeFrames(const QVector<Message> &messages)
+{
+    // One encoder for the whole replay, as on a live connection
+    WireEncoder encoder;
+    QVector<QByteArray> frames;
+    frames.reserve(messages.size());
+    for (const Message &message : messages) {
+        frames.append(encoder.encodeMessage(message));
+    }
+    return frames;
+}
+
+struct Result {
+    qint64 rawBytes = 0;
+    qint64 compressedBytes = 0;
+    double compressNsPerMessage = 0;
+    double decompressNsPerMessage = 0;
+    bool roundTripped = true;
+};
+
+Result measure(const QVector<QByteArray> &frames, const QByteArray &dictionary)
+{
+    Result result;
+    FrameCompressor sender;
+    FrameCompressor receiver;
+    sender.setDictionary(dictionary);
+    receiver.setDictionary(dictionary);
+    sender.start();
+    receiver.start();
+
+    QVector<QByteArray> compressed;
+    compressed.reserve(frames.size());
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const QByteArray &frame : frames) {
+        compressed.append(sender.compressFrame(frame));
+    }
+    result.compressNsPerMessage = double(timer.nsecsElapsed()) / qMax(1, int(frames.size()));
+
+    timer.restart();
+    QByteArray inflated;
+    for (int i = 0; i < compressed.size(); ++i) {
+        if (!receiver.decompressFrame(compressed.at(i), &inflated) || inflated != frames.at(i)) {
+            result.roundTripped = false;
+        }
+    }
+    result.decompressNsPerMessage = double(timer.nsecsElapsed()) / qMax(1, int(frames.size()));
+
+    for (int i = 0; i < frames.size(); ++i) {
+        result.rawBytes += frames.at(i).size();
+        result.compressedBytes += compressed.at(i).size();
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (!FrameCompressor::isAvailable()) {
+        err << "Built without zlib; frame compression is unavailable" << Qt::endl;
+        return 1;
+    }
+
+    QStringList args = app.arguments().mid(1);
+    QString dictionaryOutput;
+    const int trainIndex = args.indexOf(QStringLiteral("--train"));
+    if (trainIndex >= 0 && trainIndex + 1 < args.size()) {
+        dictionaryOutput = args.at(trainIndex + 1);
+        args.remove(trainIndex, 2);
+    }
+
+    const QVector<Message> messages = args.isEmpty() ? syntheticCorpus(20000) : loadCorpus(args.first());
+    if (messages.size() < 2) {
+        err << "Corpus is empty" << Qt::endl;
+        return 1;
+    }
+
+    qint64 jsonBytes = 0;
+    for (const Message &message : messages) {
+        QJsonObject object;
+        object["type"] = "message";
+        object["id"] = message.id;
+        object["sender"] = message.sender;
+        object["content"] = message.content;
+        object["serverId"] = message.serverId;
+        object["timestamp"] = message.timestamp.toString(Qt::ISODate);
+        jsonBytes += QJsonDocument(object).toJson(QJsonDocument::Compact).size();
+    }
+
+    const QVector<QByteArray> frames = encodeFrames(messages);
+    const qsizetype half = frames.size() / 2;
+    const QVector<QByteArray> training = frames.mid(0, half);
+    const QVector<QByteArray> replay = frames.mid(half);
+
+    QElapsedTimer trainTimer;
+    trainTimer.start();
+    const QByteArray trained = FrameCompressor::trainDictionary(training);
+    const qint64 trainMs = trainTimer.elapsed();
+
+    out << "Corpus: " << messages.size() << " messages, " << jsonBytes << " bytes as JSON, "
+        << (std::accumulate(frames.cbegin(), frames.cend(), qint64(0),
+                            [](qint64 sum, const QByteArray &f) { return sum + f.size(); }))
+        << " bytes as binary frames" << Qt::endl;
+    out << "Trained " << trained.size() << " byte dictionary in " << trainMs << " ms" << Qt::endl << Qt::endl;
+
+    const struct {
+        const char *name;
+        QByteArray dictionary;
+    } variants[] = {
+        {"deflate, no dictionary", QByteArray()},
+        {"deflate, built-in dictionary", FrameCompressor::defaultDictionary()},
+        {"deflate, trained dictionary", trained},
+    };
+
+    out << qSetFieldWidth(32) << Qt::left << "variant" << qSetFieldWidth(10) << Qt::right
+        << "ratio" << "bytes/msg" << "comp ns" << "decomp ns" << qSetFieldWidth(0) << Qt::endl;
+    for (const auto &variant : variants) {
+        const Result result = measure(replay, variant.dictionary);
+        out << qSetFieldWidth(32) << Qt::left << variant.name << qSetFieldWidth(10) << Qt::right
+            << QString::number(double(result.rawBytes) / qMax<qint64>(1, result.compressedBytes), 'f', 2)
+            << QString::number(double(result.compressedBytes) / replay.size(), 'f', 1)
+            << QString::number(result.compressNsPerMessage, 'f', 0)
+            << QString::number(result.decompressNsPerMessage, 'f', 0)
+            << qSetFieldWidth(0) << (result.roundTripped ? "" : "  ROUND TRIP FAILED") << Qt::endl;
+        if (!result.roundTripped) {
+            return 1;
+        }
+    }
+
+    if (!dictionaryOutput.isEmpty()) {
+        QFile file(dictionaryOutput);
+        if (!file.open(QIODevice::WriteOnly) || file.write(FrameCompressor::trainDictionary(frames)) < 0) {
+            err << "Could not write " << dictionaryOutput << Qt::endl;
+            return 1;
+        }
+        out << Qt::endl << "Wrote dictionary trained on the full corpus to " << dictionaryOutput << Qt::endl;
+    }
+    return 0;
+}
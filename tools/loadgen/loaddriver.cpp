@@ -0,0 +1,146 @@
+#include "loaddriver.h"
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QWebSocket>
+#include <QDebug>
+#include <iterator>
+
+namespace {
+
+constexpr int TickIntervalMs = 1;
+
+const char *const Phrases[] = {"gg", "anyone want to trade?", "join my game", "lol that was close",
+                               "who has the golden sword", "meet at spawn", "brb", "ok ok ok",
+                               "can someone help me with the obby", "raid raid raid"};
+
+} // namespace
+
+LoadDriver::LoadDriver(const QElapsedTimer *clock, QObject *parent)
+    : QObject(parent)
+    , m_clock(clock)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setInterval(TickIntervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &LoadDriver::tick);
+}
+
+LoadDriver::~LoadDriver()
+{
+    close();
+}
+
+QString LoadDriver::contentPrefix(qint64 scheduledNs)
+{
+    return QLatin1Char('@') + QString::number(scheduledNs) + QLatin1Char(' ');
+}
+
+qint64 LoadDriver::scheduledNs(const QString &content)
+{
+    if (!content.startsWith(QLatin1Char('@'))) {
+        return -1;
+    }
+    const qsizetype end = content.indexOf(QLatin1Char(' '));
+    bool ok = false;
+    const qint64 ns = QStringView(content).mid(1, end - 1).toLongLong(&ok);
+    return ok ? ns : -1;
+}
+
+int LoadDriver::runOf(const QString &id)
+{
+    // Ids are "lg<run>-<index>"
+    if (!id.startsWith(QLatin1String("lg"))) {
+        return -1;
+    }
+    bool ok = false;
+    const int run = QStringView(id).mid(2, id.indexOf(QLatin1Char('-')) - 2).toInt(&ok);
+    return ok ? run : -1;
+}
+
+void LoadDriver::open(const QUrl &endpoint, int senders, int channels)
+{
+    m_channels = qMax(1, channels);
+    for (int i = 0; i < senders; ++i) {
+        auto *socket = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+        connect(socket, &QWebSocket::connected, this, [this, socket, senders]() {
+            // Senders only publish, so they join no channels
+            QJsonObject hello;
+            hello["type"] = "hello";
+            hello["protocols"] = QJsonArray{QStringLiteral("json")};
+            hello["channels"] = QJsonArray();
+            socket->sendTextMessage(QString::fromUtf8(QJsonDocument(hello).toJson(QJsonDocument::Compact)));
+            if (++m_connected == senders) {
+                emit ready(m_connected);
+            }
+        });
+        connect(socket, &QWebSocket::bytesWritten, this, [this](qint64 bytes) {
+            m_bytesInFlight = qMax<qint64>(0, m_bytesInFlight - bytes);
+        });
+        connect(socket, &QWebSocket::disconnected, this, [socket]() {
+            qWarning() << "Sender disconnected:" << socket->closeReason();
+        });
+        m_sockets.append(socket);
+        socket->open(endpoint);
+    }
+}
+
+void LoadDriver::startRun(int run, int rate, int durationMs)
+{
+    m_run = run;
+    m_rate = qMax(1, rate);
+    m_sent = 0;
+    m_scheduleLag.reset();
+    m_maxBacklog = 0;
+    m_startNs = m_clock->nsecsElapsed();
+    m_endNs = m_startNs + qint64(durationMs) * 1000000;
+    m_timer.start();
+}
+
+void LoadDriver::close()
+{
+    m_timer.stop();
+    for (QWebSocket *socket : std::as_const(m_sockets)) {
+        socket->close();
+    }
+    qDeleteAll(m_sockets);
+    m_sockets.clear();
+    m_connected = 0;
+    m_bytesInFlight = 0;
+}
+
+void LoadDriver::tick()
+{
+    if (m_sockets.isEmpty()) {
+        return;
+    }
+
+    const qint64 now = m_clock->nsecsElapsed();
+    const quint64 total = quint64(m_endNs - m_startNs) * quint64(m_rate) / 1000000000u;
+    const quint64 due = qMin(total, quint64(now - m_startNs) * quint64(m_rate) / 1000000000u + 1);
+
+    const QString timestamp = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    for (; m_sent < due; ++m_sent) {
+        const qint64 scheduled = m_startNs + qint64(m_sent * 1000000000u / quint64(m_rate));
+        const int index = int(m_sent % quint64(m_sockets.size()));
+
+        // Built by hand; this loop runs up to 50k times a second
+        const QString frame = QStringLiteral("{\"type\":\"message\",\"id\":\"lg%1-%2\",\"sender\":\"loadgen-%3\","
+                                             "\"serverId\":\"channel-%4\",\"timestamp\":\"%5\",\"content\":\"%6%7\"}")
+                                  .arg(m_run)
+                                  .arg(m_sent)
+                                  .arg(index)
+                                  .arg(m_sent % quint64(m_channels))
+                                  .arg(timestamp, contentPrefix(scheduled),
+                                       QLatin1String(Phrases[m_sent % std::size(Phrases)]));
+        m_bytesInFlight += m_sockets[index]->sendTextMessage(frame);
+        m_scheduleLag.record((now - scheduled) / 1000);
+    }
+
+    m_maxBacklog = qMax(m_maxBacklog, m_bytesInFlight);
+
+    if (m_sent >= total) {
+        m_timer.stop();
+        emit runFinished(m_run, m_sent, m_scheduleLag, m_maxBacklog);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef LOADDRIVER_H
+#define LOADDRIVER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+#include "latencyhistogram.h"
+
+class QWebSocket;
+
+// Simulated senders. Opens N connections to the endpoint and, during a
+// run, sends messages round-robin across them at a fixed total rate.
+//
+// Each message carries the time it was *scheduled* to be sent (not when
+// the timer got round to it) as "@<ns>" at the start of its content, on
+// the clock passed to the constructor. If sending falls behind, receivers
+// still measure from the schedule, so a stall shows up as latency instead
+// of silently lowering the offered rate (coordinated omission).
+class LoadDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+    LoadDriver(const QElapsedTimer *clock, QObject *parent = nullptr);
+    ~LoadDriver() override;
+
+    // Invoked queued from the controlling thread
+    Q_INVOKABLE void open(const QUrl &endpoint, int senders, int channels);
+    Q_INVOKABLE void startRun(int run, int rate, int durationMs);
+    Q_INVOKABLE void close();
+
+    static QString contentPrefix(qint64 scheduledNs);
+    static qint64 scheduledNs(const QString &content);
+    static int runOf(const QString &id);
+
+signals:
+    void ready(int connected);
+    // scheduleLagUs: how late sends were against their schedule
+    void runFinished(int run, quint64 sent, const LatencyHistogram &scheduleLagUs, qint64 maxBacklogBytes);
+
+private:
+    void tick();
+
+    const QElapsedTimer *m_clock;
+    QVector<QWebSocket *> m_sockets;
+    int m_connected = 0;
+    int m_channels = 1;
+    QTimer m_timer;
+    qint64 m_bytesInFlight = 0;         // Handed to the sockets, not yet written
+
+    int m_run = -1;
+    int m_rate = 0;
+    qint64 m_startNs = 0;
+    qint64 m_endNs = 0;
+    quint64 m_sent = 0;
+    LatencyHistogram m_scheduleLag;
+    qint64 m_maxBacklog = 0;
+};
+
+Q_DECLARE_METATYPE(LatencyHistogram)
+
+#endif // LOADDRIVER_H
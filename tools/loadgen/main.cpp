@@ -0,0 +1,429 @@
+// End-to-end latency under load. Simulated senders push chat messages at a
+// fixed rate through a server to a real NetworkClient, and the receiving
+// side runs the same stages as a chat tab: moderation, render batching and
+// layout of the transcript. Latency is measured from each message's
+// scheduled send time to each stage.
+//
+// Usage: loadgen [options]
+//   --endpoint host:port   server to load (default: a built-in local relay)
+//   --senders N            sender connections (default 50)
+//   --rates list           offered msg/s per run (default 1000,10000,50000)
+//   --duration s           seconds per run (default 10)
+//   --drain s              wait for stragglers after each run (default 3)
+//   --channels N           channels the load is spread over (default 4)
+//   --slo-ms ms            rendered later than this counts as delayed (default 250)
+//   --refresh-ms ms        render batch interval (default: the app's)
+//   --json-protocol        do not offer the binary protocol
+//   --no-moderation        skip the moderation stage
+//   --tls                  use wss:// for --endpoint
+//   --json                 print the report as JSON
+//
+// Senders, the relay and the receiver share one clock, so the relay is run
+// in-process; with --endpoint the server may be anywhere but the senders
+// and receiver stay here.
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QStyleOptionViewItem>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+#include <functional>
+#include "loaddriver.h"
+#include "relayserver.h"
+#include "latencyhistogram.h"
+#include "messagedelegate.h"
+#include "networkclient.h"
+#include "renderbatcher.h"
+#include "transcriptmodel.h"
+#include "moderation/moderationpipeline.h"
+
+namespace {
+
+struct Options {
+    QString host = QStringLiteral("127.0.0.1");
+    int port = 0;
+    bool localRelay = true;
+    bool tls = false;
+    int senders = 50;
+    QVector<int> rates = {1000, 10000, 50000};
+    int durationMs = 10000;
+    int drainMs = 3000;
+    int channels = 4;
+    qint64 sloUs = 250000;
+    int refreshMs = qRound(ChatConfig().messageRefreshRate * 1000.0f);
+    bool binary = true;
+    bool moderation = true;
+    bool json = false;
+};
+
+enum Stage {
+    Received,
+    Moderated,
+    Rendered,
+    StageCount
+};
+
+const char *const StageNames[StageCount] = {"received", "moderated", "rendered"};
+
+struct RunResult {
+    int rate = 0;
+    quint64 sent = 0;
+    quint64 counts[StageCount] = {};
+    LatencyHistogram latency[StageCount];   // Microseconds from scheduled send
+    LatencyHistogram scheduleLag;
+    qint64 maxBacklogBytes = 0;
+    quint64 delayed = 0;
+};
+
+bool parseOptions(const QCoreApplication &app, Options *options)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Multi-client load generator"));
+    parser.addHelpOption();
+    parser.addOptions({
+        {"endpoint", "Server to load instead of the local relay.", "host:port"},
+        {"senders", "Sender connections.", "N"},
+        {"rates", "Comma-separated msg/s per run.", "list"},
+        {"duration", "Seconds per run.", "s"},
+        {"drain", "Seconds to wait for stragglers after a run.", "s"},
+        {"channels", "Channels to spread the load over.", "N"},
+        {"slo-ms", "Render latency above which a message counts as delayed.", "ms"},
+        {"refresh-ms", "Render batch interval.", "ms"},
+        {"json-protocol", "Do not offer the binary protocol."},
+        {"no-moderation", "Skip the moderation stage."},
+        {"tls", "Connect to --endpoint with wss://."},
+        {"json", "Print the report as JSON."},
+    });
+    parser.process(app);
+
+    if (parser.isSet("endpoint")) {
+        const QString endpoint = parser.value("endpoint");
+        const qsizetype colon = endpoint.lastIndexOf(QLatin1Char(':'));
+        bool ok = false;
+        options->host = endpoint.left(colon);
+        options->port = endpoint.mid(colon + 1).toInt(&ok);
+        if (colon <= 0 || !ok) {
+            qWarning() << "Invalid endpoint:" << endpoint;
+            return false;
+        }
+        options->localRelay = false;
+    }
+    if (parser.isSet("rates")) {
+        options->rates.clear();
+        for (const QString &rate : parser.value("rates").split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+            options->rates.append(qMax(1, rate.trimmed().toInt()));
+        }
+    }
+    auto intValue = [&parser](const QString &name, int fallback) {
+        return parser.isSet(name) ? parser.value(name).toInt() : fallback;
+    };
+    options->senders = qMax(1, intValue("senders", options->senders));
+    options->durationMs = qMax(1, intValue("duration", options->durationMs / 1000)) * 1000;
+    options->drainMs = qMax(0, intValue("drain", options->drainMs / 1000)) * 1000;
+    options->channels = qMax(1, intValue("channels", options->channels));
+    options->sloUs = qint64(qMax(1, intValue("slo-ms", int(options->sloUs / 1000)))) * 1000;
+    options->refreshMs = qMax(0, intValue("refresh-ms", options->refreshMs));
+    options->tls = parser.isSet("tls");
+    options->binary = !parser.isSet("json-protocol");
+    options->moderation = !parser.isSet("no-moderation");
+    options->json = parser.isSet("json");
+    return !options->rates.isEmpty();
+}
+
+double ms(qint64 us)
+{
+    return double(us) / 1000.0;
+}
+
+QJsonObject histogramJson(const LatencyHistogram &histogram)
+{
+    QJsonObject object;
+    object["count"] = qint64(histogram.count());
+    object["mean_ms"] = histogram.mean() / 1000.0;
+    object["p50_ms"] = ms(histogram.valueAtPercentile(50));
+    object["p90_ms"] = ms(histogram.valueAtPercentile(90));
+    object["p99_ms"] = ms(histogram.valueAtPercentile(99));
+    object["p999_ms"] = ms(histogram.valueAtPercentile(99.9));
+    object["p9999_ms"] = ms(histogram.valueAtPercentile(99.99));
+    object["max_ms"] = ms(histogram.max());
+    return object;
+}
+
+void printReport(const Options &options, const QVector<RunResult> &results)
+{
+    QTextStream out(stdout);
+    if (options.json) {
+        QJsonArray runs;
+        for (const RunResult &result : results) {
+            QJsonObject run;
+            run["rate"] = result.rate;
+            run["sent"] = qint64(result.sent);
+            run["dropped"] = qint64(result.sent - qMin(result.sent, result.counts[Rendered]));
+            run["delayed"] = qint64(result.delayed);
+            run["max_sender_backlog_bytes"] = result.maxBacklogBytes;
+            run["schedule_lag"] = histogramJson(result.scheduleLag);
+            for (int stage = 0; stage < StageCount; ++stage) {
+                run[QLatin1String(StageNames[stage])] = histogramJson(result.latency[stage]);
+            }
+            runs.append(run);
+        }
+        QJsonObject report;
+        report["senders"] = options.senders;
+        report["channels"] = options.channels;
+        report["duration_s"] = options.durationMs / 1000;
+        report["slo_ms"] = ms(options.sloUs);
+        report["refresh_ms"] = options.refreshMs;
+        report["protocol"] = options.binary ? QString::fromLatin1(WireProtocol::Name) : QStringLiteral("json");
+        report["runs"] = runs;
+        out << QJsonDocument(report).toJson(QJsonDocument::Indented);
+        return;
+    }
+
+    out << QString("%1 senders, %2 channels, %3 s per run, render every %4 ms, SLO %5 ms\n")
+               .arg(options.senders).arg(options.channels).arg(options.durationMs / 1000)
+               .arg(options.refreshMs).arg(ms(options.sloUs));
+    for (const RunResult &result : results) {
+        const quint64 dropped = result.sent - qMin(result.sent, result.counts[Rendered]);
+        out << QString("\n== %1 msg/s: sent %2, dropped %3, delayed %4, sender lag p99 %5 ms, "
+                       "max sender backlog %6 KB\n")
+                   .arg(result.rate).arg(result.sent).arg(dropped).arg(result.delayed)
+                   .arg(ms(result.scheduleLag.valueAtPercentile(99)), 0, 'f', 2)
+                   .arg(result.maxBacklogBytes / 1024);
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                   .arg("stage", -10).arg("count", 9).arg("p50", 9).arg("p90", 9)
+                   .arg("p99", 9).arg("p99.9", 9).arg("p99.99", 9).arg("max (ms)", 9);
+        for (int stage = 0; stage < StageCount; ++stage) {
+            const LatencyHistogram &histogram = result.latency[stage];
+            out << QString("%1 %2").arg(StageNames[stage], -10).arg(histogram.count(), 9);
+            for (double percentile : {50.0, 90.0, 99.0, 99.9, 99.99, 100.0}) {
+                out << QString(" %1").arg(ms(histogram.valueAtPercentile(percentile)), 9, 'f', 2);
+            }
+            out << "\n";
+        }
+    }
+}
+
+} // namespace
+
+// Receiving side: a NetworkClient feeding the same stages as a chat tab
+class Receiver : public QObject
+{
+public:
+    Receiver(const Options &options, const QElapsedTimer *clock)
+        : m_options(options)
+        , m_clock(clock)
+        , m_model(ChatConfig().maxHistorySize)
+        , m_surface(600, 800, QImage::Format_ARGB32_Premultiplied)
+    {
+        NetworkConfig config;
+        config.useSSL = options.tls;
+        config.preferBinaryProtocol = options.binary;
+        config.enableCompression = false;
+        config.reconnectAttempts = 1;
+        m_client.setConfig(config);
+        for (int channel = 0; channel < options.channels; ++channel) {
+            m_client.joinChannel(QStringLiteral("channel-%1").arg(channel));
+        }
+
+        m_batcher.setInterval(options.refreshMs);
+        connect(&m_client, &NetworkClient::messageReceived, this, [this](const Message &message) {
+            if (!record(Received, message)) {
+                return;
+            }
+            if (m_options.moderation) {
+                m_pipeline.submit(message);
+            } else {
+                m_batcher.enqueue(message);
+            }
+        });
+        connect(&m_pipeline, &ModerationPipeline::messageReady, this, [this](const Message &message) {
+            record(Moderated, message);
+            m_batcher.enqueue(message);
+        });
+        connect(&m_batcher, &RenderBatcher::commitReady, this, [this](const QVector<Message> &messages) {
+            commit(messages);
+        });
+    }
+
+    NetworkClient &client() { return m_client; }
+
+    void beginRun(int run, int rate)
+    {
+        m_run = run;
+        m_result = RunResult();
+        m_result.rate = rate;
+    }
+
+    RunResult &result() { return m_result; }
+
+private:
+    // Returns false for stragglers from an earlier run
+    bool record(Stage stage, const Message &message)
+    {
+        if (LoadDriver::runOf(message.id) != m_run) {
+            return false;
+        }
+        const qint64 scheduled = LoadDriver::scheduledNs(message.content);
+        if (scheduled < 0) {
+            return false;
+        }
+        const qint64 latencyUs = (m_clock->nsecsElapsed() - scheduled) / 1000;
+        m_result.latency[stage].record(latencyUs);
+        ++m_result.counts[stage];
+        if (stage == Rendered && latencyUs > m_options.sloUs) {
+            ++m_result.delayed;
+        }
+        return true;
+    }
+
+    // What a render commit costs a chat tab: append to the model, measure
+    // the new rows and paint the visible end of the transcript
+    void commit(const QVector<Message> &messages)
+    {
+        m_model.append(messages);
+        QPainter painter(&m_surface);
+        QStyleOptionViewItem option;
+        int y = m_surface.height();
+        for (int row = m_model.rowCount() - 1; row >= 0 && y > 0; --row) {
+            const QModelIndex index = m_model.index(row);
+            option.rect = QRect(0, 0, m_surface.width(), 0);
+            const int height = m_delegate.sizeHint(option, index).height();
+            y -= height;
+            option.rect = QRect(0, y, m_surface.width(), height);
+            m_delegate.paint(&painter, option, index);
+        }
+        for (const Message &message : messages) {
+            record(Rendered, message);
+        }
+    }
+
+    const Options &m_options;
+    const QElapsedTimer *m_clock;
+    NetworkClient m_client;
+    ModerationPipeline m_pipeline;
+    RenderBatcher m_batcher;
+    TranscriptModel m_model;
+    MessageDelegate m_delegate;
+    QImage m_surface;
+
+    int m_run = -1;
+    RunResult m_result;
+};
+
+int main(int argc, char *argv[])
+{
+    // Headless unless a platform was chosen explicitly
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    qRegisterMetaType<LatencyHistogram>();
+
+    Options options;
+    if (!parseOptions(app, &options)) {
+        return 2;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+
+    // Relay and senders get their own thread, like a separate process,
+    // so only the receiving side runs on this (GUI) thread
+    QThread loadThread;
+    loadThread.start();
+    RelayServer *relay = nullptr;
+    if (options.localRelay) {
+        relay = new RelayServer;
+        relay->moveToThread(&loadThread);
+        bool listening = false;
+        QMetaObject::invokeMethod(relay, [relay, &listening]() { listening = relay->listen(); },
+                                  Qt::BlockingQueuedConnection);
+        if (!listening) {
+            return 1;
+        }
+        options.port = relay->port();
+    }
+    auto *driver = new LoadDriver(&clock);
+    driver->moveToThread(&loadThread);
+
+    Receiver receiver(options, &clock);
+    QVector<RunResult> results;
+    int run = 0;
+
+    const QUrl endpoint(QStringLiteral("%1://%2:%3")
+                            .arg(options.tls ? "wss" : "ws", options.host).arg(options.port));
+
+    auto finish = [&]() {
+        QMetaObject::invokeMethod(driver, &LoadDriver::close, Qt::BlockingQueuedConnection);
+        receiver.client().disconnect();
+        app.quit();
+    };
+
+    std::function<void()> startNext = [&]() {
+        if (run >= options.rates.size()) {
+            finish();
+            return;
+        }
+        const int rate = options.rates.at(run);
+        receiver.beginRun(run, rate);
+        qInfo() << "Offering" << rate << "msg/s for" << options.durationMs / 1000 << "s";
+        QMetaObject::invokeMethod(driver, "startRun", Qt::QueuedConnection,
+                                  Q_ARG(int, run), Q_ARG(int, rate), Q_ARG(int, options.durationMs));
+    };
+
+    QObject::connect(driver, &LoadDriver::runFinished, &app,
+                     [&](int finishedRun, quint64 sent, const LatencyHistogram &lag, qint64 backlog) {
+        if (finishedRun != run) {
+            return;
+        }
+        // Leave time for the tail to arrive before reading the stages
+        QTimer::singleShot(options.drainMs + options.refreshMs, &app, [&, sent, lag, backlog]() {
+            RunResult result = receiver.result();
+            result.sent = sent;
+            result.scheduleLag = lag;
+            result.maxBacklogBytes = backlog;
+            results.append(result);
+            ++run;
+            startNext();
+        });
+    });
+
+    QObject::connect(driver, &LoadDriver::ready, &app, [&](int connected) {
+        qInfo() << connected << "senders connected to" << endpoint.toString();
+        startNext();
+    });
+
+    QObject::connect(&receiver.client(), &NetworkClient::connected, &app, [&]() {
+        // The welcome is still in flight; give it a moment so the first run
+        // is measured on the negotiated protocol
+        QTimer::singleShot(200, &app, [&]() {
+            QMetaObject::invokeMethod(driver, "open", Qt::QueuedConnection, Q_ARG(QUrl, endpoint),
+                                      Q_ARG(int, options.senders), Q_ARG(int, options.channels));
+        });
+    });
+    QObject::connect(&receiver.client(), &NetworkClient::connectionError, &app, [&](const QString &error) {
+        qWarning() << "Receiver connection failed:" << error;
+        finish();
+    });
+
+    receiver.client().connectToServer(options.host, options.port);
+    const int status = app.exec();
+
+    // Both live on the load thread, so they are deleted there
+    QObject::connect(&loadThread, &QThread::finished, driver, &QObject::deleteLater);
+    if (relay) {
+        QObject::connect(&loadThread, &QThread::finished, relay, &QObject::deleteLater);
+    }
+    loadThread.quit();
+    loadThread.wait();
+
+    printReport(options, results);
+    return status;
+}
@@ -0,0 +1,171 @@
+#include "relayserver.h"
+#include "jsonframereader.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <QWebSocket>
+#include <QDebug>
+
+namespace {
+
+QString messageFrame(const Message &message)
+{
+    QJsonObject frame;
+    frame["type"] = "message";
+    frame["id"] = message.id;
+    frame["seq"] = qint64(message.sequence);
+    frame["sender"] = message.sender;
+    frame["serverId"] = message.serverId;
+    frame["content"] = message.content;
+    frame["timestamp"] = message.timestamp.toString(Qt::ISODateWithMs);
+    return QString::fromUtf8(QJsonDocument(frame).toJson(QJsonDocument::Compact));
+}
+
+} // namespace
+
+RelayServer::RelayServer(QObject *parent)
+    : QObject(parent)
+    , m_server(QStringLiteral("rochat-relay"), QWebSocketServer::NonSecureMode)
+{
+    connect(&m_server, &QWebSocketServer::newConnection, this, &RelayServer::onNewConnection);
+}
+
+RelayServer::~RelayServer()
+{
+    m_server.close();
+    qDeleteAll(m_server.findChildren<QWebSocket *>());
+}
+
+bool RelayServer::listen(quint16 port)
+{
+    if (!m_server.listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Relay could not listen:" << m_server.errorString();
+        return false;
+    }
+    return true;
+}
+
+void RelayServer::onNewConnection()
+{
+    while (QWebSocket *socket = m_server.nextPendingConnection()) {
+        socket->setParent(&m_server);
+        auto peer = std::make_shared<Peer>();
+        peer->socket = socket;
+        m_peers.insert(socket, peer);
+
+        connect(socket, &QWebSocket::textMessageReceived, this, [this, socket](const QString &text) {
+            onTextMessage(socket, text);
+        });
+        connect(socket, &QWebSocket::disconnected, this, [this, socket]() {
+            m_peers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void RelayServer::onTextMessage(QWebSocket *socket, const QString &text)
+{
+    auto it = m_peers.find(socket);
+    if (it == m_peers.end()) {
+        return;
+    }
+
+    // Message frames are the hot path; everything else is rare
+    JsonFrameReader::Frame frame;
+    if (JsonFrameReader::read(text, &frame) && frame.type == JsonFrameReader::FrameType::Message) {
+        relay(socket, frame.message);
+        return;
+    }
+
+    const QJsonObject control = QJsonDocument::fromJson(text.toUtf8()).object();
+    const QString type = control.value("type").toString();
+    Peer &peer = **it;
+    if (type == QLatin1String("hello")) {
+        onHello(peer, text);
+    } else if (type == QLatin1String("join")) {
+        peer.channels.insert(control.value("serverId").toString());
+    } else if (type == QLatin1String("leave")) {
+        peer.channels.remove(control.value("serverId").toString());
+    }
+}
+
+void RelayServer::onHello(Peer &peer, const QString &text)
+{
+    const QJsonObject hello = QJsonDocument::fromJson(text.toUtf8()).object();
+    peer.binary = hello.value("protocols").toArray().contains(QLatin1String(WireProtocol::Name));
+    peer.encoder.reset();
+    peer.channels.clear();
+    for (const QJsonValue &channel : hello.value("channels").toArray()) {
+        peer.channels.insert(channel.toString());
+    }
+
+    // No batch or compression: the relay only needs to carry messages
+    QJsonObject welcome;
+    welcome["type"] = "welcome";
+    welcome["protocol"] = peer.binary ? QString::fromLatin1(WireProtocol::Name) : QStringLiteral("json");
+    welcome["batch"] = false;
+    peer.socket->sendTextMessage(QString::fromUtf8(QJsonDocument(welcome).toJson(QJsonDocument::Compact)));
+
+    const QJsonObject resume = hello.value("resume").toObject();
+    for (auto it = resume.constBegin(); it != resume.constEnd(); ++it) {
+        auto channel = m_channels.constFind(it.key());
+        if (channel == m_channels.constEnd()) {
+            continue;
+        }
+        const quint64 last = quint64(it.value().toInteger());
+        for (const Message &message : channel->backlog) {
+            if (message.sequence > last) {
+                queue(peer, message);
+                ++m_resumed;
+            }
+        }
+    }
+}
+
+void RelayServer::relay(QWebSocket *origin, Message message)
+{
+    Channel &channel = m_channels[message.serverId];
+    message.sequence = channel.nextSequence++;
+    channel.backlog.push_back(message);
+    if (channel.backlog.size() > size_t(BacklogPerChannel)) {
+        channel.backlog.pop_front();
+    }
+
+    for (const std::shared_ptr<Peer> &peer : std::as_const(m_peers)) {
+        if (peer->socket != origin && peer->channels.contains(message.serverId)) {
+            queue(*peer, message);
+            ++m_relayed;
+        }
+    }
+}
+
+void RelayServer::queue(Peer &peer, const Message &message)
+{
+    peer.pending.append(message);
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        QTimer::singleShot(0, this, &RelayServer::flush);
+    }
+}
+
+void RelayServer::flush()
+{
+    m_flushScheduled = false;
+    for (const std::shared_ptr<Peer> &peer : std::as_const(m_peers)) {
+        if (peer->pending.isEmpty()) {
+            continue;
+        }
+        if (peer->binary) {
+            for (int start = 0; start < peer->pending.size(); start += MaxFrameMessages) {
+                peer->socket->sendBinaryMessage(
+                    peer->encoder.encodeMessages(peer->pending.mid(start, MaxFrameMessages)));
+            }
+        } else {
+            for (const Message &message : std::as_const(peer->pending)) {
+                peer->socket->sendTextMessage(messageFrame(message));
+            }
+        }
+        peer->pending.clear();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef RELAYSERVER_H
+#define RELAYSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QWebSocketServer>
+#include <deque>
+#include <memory>
+#include "include/types.h"
+#include "wireprotocol.h"
+
+class QWebSocket;
+
+// Minimal chat server for load tests. It speaks the subset of the client
+// protocol that NetworkClient needs:
+//  - hello/welcome, accepting the binary protocol when offered;
+//  - join/leave of channels;
+//  - message frames, stamped with a per-channel sequence number and fanned
+//    out to every other peer on that channel;
+//  - resume: a hello carrying last-seen sequences is answered by replaying
+//    the newer messages still in the channel's backlog.
+// Outbound messages are batched per peer and flushed once per event loop
+// pass, as a real server would under load.
+class RelayServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int BacklogPerChannel = 20000;
+    static constexpr int MaxFrameMessages = 256;   // Per binary frame
+
+    explicit RelayServer(QObject *parent = nullptr);
+    ~RelayServer() override;
+
+    bool listen(quint16 port = 0);
+    quint16 port() const { return m_server.serverPort(); }
+
+    quint64 relayed() const { return m_relayed; }
+    quint64 resumed() const { return m_resumed; }
+
+private:
+    struct Peer {
+        QWebSocket *socket = nullptr;
+        bool binary = false;
+        QSet<QString> channels;
+        WireEncoder encoder;
+        QVector<Message> pending;
+    };
+
+    struct Channel {
+        quint64 nextSequence = 1;
+        std::deque<Message> backlog;
+    };
+
+    void onNewConnection();
+    void onTextMessage(QWebSocket *socket, const QString &text);
+    void onHello(Peer &peer, const QString &text);
+    void relay(QWebSocket *origin, Message message);
+    void queue(Peer &peer, const Message &message);
+    void flush();
+
+    QWebSocketServer m_server;
+    QHash<QWebSocket *, std::shared_ptr<Peer>> m_peers;
+    QHash<QString, Channel> m_channels;
+    bool m_flushScheduled = false;
+
+    quint64 m_relayed = 0;
+    quint64 m_resumed = 0;
+};
+
+#endif // RELAYSERVER_H
@@ -0,0 +1,173 @@
+// Measures the heap cost of retained chat history: the same synthetic
+// messages held as QVector<Message> and as CompactMessages in a
+// MessageArena, as TranscriptModel keeps them.
+//
+// Usage: membench [count]
+//   count  number of messages to retain (default 100000)
+//
+// Live heap bytes are counted by replacing global operator new/delete, so
+// the figures include every allocation a QString or QStringList makes,
+// but not allocator slack.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <atomic>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include "compactmessage.h"
+
+namespace {
+
+std::atomic<qint64> g_liveBytes{0};
+
+// Each block carries its size in front so delete can subtract it
+constexpr size_t HeaderSize = alignof(std::max_align_t);
+
+void *countedAlloc(size_t size)
+{
+    void *block = std::malloc(size + HeaderSize);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t *>(block) = size;
+    g_liveBytes.fetch_add(qint64(size), std::memory_order_relaxed);
+    return static_cast<char *>(block) + HeaderSize;
+}
+
+void countedFree(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    void *block = static_cast<char *>(ptr) - HeaderSize;
+    g_liveBytes.fetch_sub(qint64(*static_cast<size_t *>(block)), std::memory_order_relaxed);
+    std::free(block);
+}
+
+} // namespace
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *ptr) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { countedFree(ptr); }
+
+namespace {
+
+QVector<Message> syntheticHistory(int count)
+{
+    static const char *phrases[] = {"anyone want to trade?", "gg", "lol", "brb", "who wants to join my game",
+                                    "can someone help me with the obby", "how do i get the golden sword",
+                                    "thx for the trade!", "meet at spawn", "idk tbh", "omg that was close",
+                                    "wait for me", "ok", "that boss took forever"};
+    static const char *links[] = {"https://www.roblox.com/games/1818/Classic-Crossroads",
+                                  "https://discord.gg/abc123", "https://www.roblox.com/catalog/48474313"};
+    QRandomGenerator random(4321);
+    QVector<Message> messages;
+    messages.reserve(count);
+    const QDateTime start = QDateTime::currentDateTime();
+    for (int i = 0; i < count; ++i) {
+        // A few thousand distinct senders, as on a busy public server
+        Message message(QStringLiteral("player_%1").arg(random.bounded(3000)),
+                        QString::fromLatin1(phrases[random.bounded(int(std::size(phrases)))]));
+        if (random.bounded(4) == 0) {
+            message.content += QLatin1Char(' ')
+                               + QString::fromLatin1(phrases[random.bounded(int(std::size(phrases)))]);
+        }
+        if (random.bounded(10) == 0) {
+            const QString url = QString::fromLatin1(links[random.bounded(int(std::size(links)))]);
+            message.content += QStringLiteral(" check ") + url;
+            message.linkUrls.append(url);
+            message.containsLink = true;
+        }
+        message.serverId = QStringLiteral("channel-%1").arg(random.bounded(4));
+        message.id = QStringLiteral("%1").arg(quint64(i) * 2654435761u % 1000000007u, 12, 36, QLatin1Char('0'));
+        message.sequence = quint64(i + 1);
+        message.timestamp = start.addMSecs(qint64(i) * 250);
+        messages.append(message);
+    }
+    return messages;
+}
+
+QString megabytes(qint64 bytes)
+{
+    return QString::number(double(bytes) / (1024.0 * 1024.0), 'f', 2) + QStringLiteral(" MB");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const int count = argc > 1 ? qMax(1, QString::fromLocal8Bit(argv[1]).toInt()) : 100000;
+
+    // The source strings are built once and then copied so both layouts are
+    // measured from the same baseline. Deep copies keep QString sharing
+    // from hiding the cost of the plain vector.
+    const QVector<Message> source = syntheticHistory(count);
+
+    qint64 before = g_liveBytes.load();
+    QVector<Message> plain;
+    plain.reserve(count);
+    for (const Message &message : source) {
+        Message copy = message;
+        copy.id = QString(message.id.constData(), message.id.size());
+        copy.sender = QString(message.sender.constData(), message.sender.size());
+        copy.serverId = QString(message.serverId.constData(), message.serverId.size());
+        copy.content = QString(message.content.constData(), message.content.size());
+        QStringList urls;
+        for (const QString &url : message.linkUrls) {
+            urls.append(QString(url.constData(), url.size()));
+        }
+        copy.linkUrls = urls;
+        plain.append(copy);
+    }
+    const qint64 plainBytes = g_liveBytes.load() - before;
+
+    before = g_liveBytes.load();
+    QElapsedTimer timer;
+    timer.start();
+    MessageArena arena;
+    QVector<CompactMessage> compact;
+    compact.reserve(count);
+    for (const Message &message : source) {
+        compact.append(arena.pack(message));
+    }
+    const qint64 packNs = timer.nsecsElapsed();
+    const qint64 compactBytes = g_liveBytes.load() - before;
+
+    // Unpacking is what painting a row costs; check it round-trips too
+    timer.restart();
+    int mismatches = 0;
+    for (int i = 0; i < count; ++i) {
+        const Message message = arena.unpack(compact.at(i));
+        if (message.id != source[i].id || message.content != source[i].content
+            || message.sender != source[i].sender || message.linkUrls != source[i].linkUrls
+            || message.timestamp != source[i].timestamp) {
+            ++mismatches;
+        }
+    }
+    const qint64 unpackNs = timer.nsecsElapsed();
+
+    out << "messages:        " << count << "\n";
+    out << "QVector<Message>: " << megabytes(plainBytes) << " (" << plainBytes / count << " B/message)\n";
+    out << "compact:          " << megabytes(compactBytes) << " (" << compactBytes / count << " B/message)\n";
+    out << "  records:        " << megabytes(qint64(compact.capacity()) * qint64(sizeof(CompactMessage))) << "\n";
+    out << "  arena:          " << megabytes(arena.bytesReserved()) << " in " << arena.slabCount() << " slabs\n";
+    out << "  interned:       " << arena.internedCount() << " strings\n";
+    out << "reduction:        " << QString::number(double(plainBytes) / double(qMax<qint64>(1, compactBytes)), 'f', 2)
+        << "x\n";
+    out << "pack:             " << QString::number(double(packNs) / count, 'f', 1) << " ns/message\n";
+    out << "unpack:           " << QString::number(double(unpackNs) / count, 'f', 1) << " ns/message\n";
+    if (mismatches > 0) {
+        out << "round-trip mismatches: " << mismatches << "\n";
+        return 1;
+    }
+    return 0;
+}